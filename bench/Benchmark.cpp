@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Benchmark.h"
+#include <cinttypes>
+#include <cstdio>
+
+namespace bench
+{
+	uint64_t elapsed_ns(uint32_t start, uint32_t end) noexcept
+	{
+		static const uint32_t freq = osKernelGetSysTimerFreq();
+		return (static_cast<uint64_t>(end - start) * 1000000000ULL) / freq;
+	}
+
+	histogram::histogram() noexcept :
+		m_buckets(),
+		m_count(0),
+		m_min(UINT32_MAX),
+		m_max(0)
+	{}
+
+	void histogram::add(uint64_t ns) noexcept
+	{
+		uint32_t value = (ns > UINT32_MAX) ? UINT32_MAX : static_cast<uint32_t>(ns);
+		size_t bucket = 0;
+		while (bucket + 1 < bucket_count && value >= (1U << bucket))
+			++bucket;
+
+		++m_buckets[bucket];
+		++m_count;
+		if (value < m_min)
+			m_min = value;
+		if (value > m_max)
+			m_max = value;
+	}
+
+	void histogram::merge(const histogram& other) noexcept
+	{
+		for (size_t i = 0; i < bucket_count; ++i)
+			m_buckets[i] += other.m_buckets[i];
+
+		m_count += other.m_count;
+		if (other.m_min < m_min)
+			m_min = other.m_min;
+		if (other.m_max > m_max)
+			m_max = other.m_max;
+	}
+
+	uint32_t histogram::percentile(unsigned int pct) const noexcept
+	{
+		uint64_t rank = (m_count * pct + 99) / 100;
+		uint64_t seen = 0;
+		for (size_t i = 0; i < bucket_count; ++i)
+		{
+			seen += m_buckets[i];
+			if (seen >= rank && seen != 0)
+				return (i + 1 < bucket_count) ? (1U << i) : UINT32_MAX;
+		}
+
+		return m_max;
+	}
+
+	void histogram::print() const
+	{
+		static const unsigned int bar_width = 40;
+
+		uint32_t highest = 0;
+		for (size_t i = 0; i < bucket_count; ++i)
+		{
+			if (m_buckets[i] > highest)
+				highest = m_buckets[i];
+		}
+
+		for (size_t i = 0; i < bucket_count; ++i)
+		{
+			if (m_buckets[i] == 0)
+				continue;
+
+			char bar[bar_width + 1];
+			unsigned int len =
+				static_cast<unsigned int>((static_cast<uint64_t>(m_buckets[i]) * bar_width + highest - 1) / highest);
+			for (unsigned int c = 0; c < len; ++c)
+				bar[c] = '#';
+			bar[len] = '\0';
+
+			uint32_t low = i ? (1U << (i - 1)) : 0;
+			uint32_t high = (i + 1 < bucket_count) ? (1U << i) : UINT32_MAX;
+			std::printf("    %10" PRIu32 " .. %10" PRIu32 " ns | %-40s %" PRIu32 "\n", low, high, bar, m_buckets[i]);
+		}
+	}
+
+	void report(const char* name, uint64_t ops, uint64_t total_ns, const histogram& hist)
+	{
+		double ns_per_op = ops ? static_cast<double>(total_ns) / static_cast<double>(ops) : 0.0;
+		std::printf(
+			"  %-52s %10.1f ns/op  (min %" PRIu32 ", p50 < %" PRIu32 ", p99 < %" PRIu32 ", max %" PRIu32 " ns)\n",
+			name,
+			ns_per_op,
+			hist.min(),
+			hist.percentile(50),
+			hist.percentile(99),
+			hist.max());
+		hist.print();
+	}
+
+	void section(const char* title)
+	{
+		std::printf("\n== %s ==\n", title);
+	}
+
+	cmsis::thread::attributes thread_attributes(const char* name)
+	{
+		cmsis::thread::attributes attr = {};
+		attr.stack_size = BENCH_STACK_SIZE;
+		attr.priority = osPriorityNormal;
+		attr.name = name;
+		return attr;
+	}
+} // namespace bench
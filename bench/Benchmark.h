@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CMSIS_BENCHMARK_H_
+#define CMSIS_BENCHMARK_H_
+
+#include "Thread.h"
+#include "cmsis_os2.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Number of measured samples of each benchmark.
+#ifndef BENCH_SAMPLES
+#define BENCH_SAMPLES 2000U
+#endif
+
+/// Number of operations timed together in one sample of a throughput benchmark.
+#ifndef BENCH_BATCH
+#define BENCH_BATCH 16U
+#endif
+
+/// Stack size of the benchmark threads.
+#ifndef BENCH_STACK_SIZE
+#define BENCH_STACK_SIZE 4096U
+#endif
+
+namespace bench
+{
+	/// Read the system timer. Differences of two readings are immune to the counter wrap.
+	inline uint32_t now() noexcept
+	{
+		return osKernelGetSysTimerCount();
+	}
+
+	/// Convert a system timer interval to nanoseconds.
+	uint64_t elapsed_ns(uint32_t start, uint32_t end) noexcept;
+
+	/// Latency histogram with power of two buckets: [0, 1), [1, 2), [2, 4), ... [2^30, 2^32) ns.
+	class histogram
+	{
+	public:
+		static constexpr size_t bucket_count = 32;
+
+		histogram() noexcept;
+
+		void add(uint64_t ns) noexcept;
+		void merge(const histogram& other) noexcept;
+
+		uint64_t count() const noexcept { return m_count; }
+		uint32_t min() const noexcept { return m_count ? m_min : 0; }
+		uint32_t max() const noexcept { return m_max; }
+
+		/// Upper bound of the bucket holding the given percentile.
+		uint32_t percentile(unsigned int pct) const noexcept;
+
+		void print() const;
+
+	private:
+		uint32_t m_buckets[bucket_count];
+		uint64_t m_count;
+		uint32_t m_min;
+		uint32_t m_max;
+	};
+
+	/// Print a benchmark result: average cost of one operation, then the histogram of the samples.
+	void report(const char* name, uint64_t ops, uint64_t total_ns, const histogram& hist);
+
+	/// Print a section title.
+	void section(const char* title);
+
+	/// Thread attributes of the benchmark threads.
+	cmsis::thread::attributes thread_attributes(const char* name);
+
+	/// Time `samples` batches of `batch` calls of op. Each sample adds the cost of one call to the histogram.
+	template <class Op> void run(const char* name, size_t samples, size_t batch, Op&& op)
+	{
+		histogram hist;
+		uint64_t total_ns = 0;
+		for (size_t s = 0; s < samples; ++s)
+		{
+			uint32_t start = now();
+			for (size_t b = 0; b < batch; ++b)
+				op();
+			uint64_t ns = elapsed_ns(start, now());
+
+			total_ns += ns;
+			hist.add(ns / batch);
+		}
+
+		report(name, static_cast<uint64_t>(samples) * batch, total_ns, hist);
+	}
+
+	template <class Op> void run(const char* name, Op&& op)
+	{
+		run(name, BENCH_SAMPLES, BENCH_BATCH, std::forward<Op>(op));
+	}
+
+	/// Time `samples` calls of op, each call moving `per_call` elements: the cost is given per element.
+	template <class Op> void run_amortized(const char* name, size_t samples, size_t per_call, Op&& op)
+	{
+		histogram hist;
+		uint64_t total_ns = 0;
+		for (size_t s = 0; s < samples; ++s)
+		{
+			uint32_t start = now();
+			op();
+			uint64_t ns = elapsed_ns(start, now());
+
+			total_ns += ns;
+			hist.add(ns / per_call);
+		}
+
+		report(name, static_cast<uint64_t>(samples) * per_call, total_ns, hist);
+	}
+
+	/// Run the same loop in several threads at once. The result is the throughput of all the threads together,
+	/// the histogram merges the samples of every thread. Each thread builds its own State(arg), given to op.
+	template <class State, class Arg, class Op>
+	void run_threads_local(const char* name, size_t thread_count, size_t samples, size_t batch, Arg& arg, Op op)
+	{
+		std::vector<histogram> hists(thread_count);
+		std::vector<cmsis::thread> threads;
+		threads.reserve(thread_count);
+
+		osEventFlagsId_t start_flag = osEventFlagsNew(nullptr);
+		for (size_t i = 0; i < thread_count; ++i)
+		{
+			threads.emplace_back(thread_attributes(name), [&, i]() {
+				State state(arg);
+				osEventFlagsWait(start_flag, 1, osFlagsWaitAny | osFlagsNoClear, osWaitForever);
+				for (size_t s = 0; s < samples; ++s)
+				{
+					uint32_t start = now();
+					for (size_t b = 0; b < batch; ++b)
+						op(state);
+					hists[i].add(elapsed_ns(start, now()) / batch);
+				}
+			});
+		}
+
+		uint32_t start = now();
+		osEventFlagsSet(start_flag, 1);
+		for (auto& t : threads)
+			t.join();
+		uint64_t total_ns = elapsed_ns(start, now());
+		osEventFlagsDelete(start_flag);
+
+		histogram hist;
+		for (const auto& h : hists)
+			hist.merge(h);
+
+		report(name, static_cast<uint64_t>(thread_count) * samples * batch, total_ns, hist);
+	}
+
+	/// Run the same loop in several threads at once, see run_threads_local.
+	template <class Op> void run_threads(const char* name, size_t thread_count, size_t samples, size_t batch, Op op)
+	{
+		int unused = 0;
+		run_threads_local<int>(name, thread_count, samples, batch, unused, [&op](int&) { op(); });
+	}
+
+	// Benchmark groups
+	void mutex_benchmarks();
+	void semaphore_benchmarks();
+	void message_queue_benchmarks();
+	void flags_benchmarks();
+	void memory_pool_benchmarks();
+	void heap_benchmarks();
+	void condition_variable_benchmarks();
+	void thread_benchmarks();
+	void future_benchmarks();
+	void timer_benchmarks();
+} // namespace bench
+
+#endif // CMSIS_BENCHMARK_H_
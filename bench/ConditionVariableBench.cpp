@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Barrier.h"
+#include "Benchmark.h"
+#include "ConditionVariable.h"
+#include <cstdio>
+
+namespace bench
+{
+	void condition_variable_benchmarks()
+	{
+		section("condition variable");
+
+		cmsis::condition_variable cv;
+		run("condition_variable notify_one, no waiter", [&]() { cv.notify_one(); });
+
+		// Wake latency: a waiter is woken, then wakes the notifier in turn
+		cmsis::mutex m;
+		cmsis::condition_variable cv_ping;
+		cmsis::condition_variable cv_pong;
+		bool ping = false;
+		bool pong = false;
+
+		cmsis::thread peer(thread_attributes("cv peer"), [&]() {
+			for (size_t i = 0; i < BENCH_SAMPLES; ++i)
+			{
+				std::unique_lock<cmsis::mutex> lock(m);
+				cv_ping.wait(lock, [&]() { return ping; });
+				ping = false;
+				pong = true;
+				lock.unlock();
+				cv_pong.notify_one();
+			}
+		});
+
+		run("condition_variable round trip (2 wake-ups)", BENCH_SAMPLES, 1, [&]() {
+			std::unique_lock<cmsis::mutex> lock(m);
+			ping = true;
+			lock.unlock();
+			cv_ping.notify_one();
+
+			lock.lock();
+			cv_pong.wait(lock, [&]() { return pong; });
+			pong = false;
+		});
+		peer.join();
+
+		{
+			std::unique_lock<cmsis::mutex> lock(m);
+			run("condition_variable wait_for(0ms) timeout", [&]() { cv.wait_for(lock, std::chrono::milliseconds(0)); });
+		}
+
+		// Phase synchronization of a group of threads: the cost is given per thread and per phase
+		const size_t phases = BENCH_SAMPLES / 10;
+		for (size_t threads : {2, 4})
+		{
+			char name[64];
+			std::snprintf(name, sizeof(name), "barrier arrive_and_wait, %u threads", static_cast<unsigned>(threads));
+			cmsis::barrier<> phase_barrier(static_cast<std::ptrdiff_t>(threads));
+			run_threads(name, threads, phases, 1, [&]() { phase_barrier.arrive_and_wait(); });
+
+			// The same barrier with a mutex and a condition variable
+			size_t arrived = 0;
+			size_t generation = 0;
+			std::snprintf(name, sizeof(name), "condition_variable barrier, %u threads", static_cast<unsigned>(threads));
+			run_threads(name, threads, phases, 1, [&]() {
+				std::unique_lock<cmsis::mutex> lock(m);
+				size_t gen = generation;
+				if (++arrived == threads)
+				{
+					arrived = 0;
+					++generation;
+					cv.notify_all();
+				}
+				else
+					cv.wait(lock, [&]() { return gen != generation; });
+			});
+		}
+	}
+} // namespace bench
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Benchmark.h"
+#include "EventFlag.h"
+#include "ThreadFlag.h"
+
+namespace bench
+{
+	namespace
+	{
+		constexpr uint32_t flag_ping = 0x1;
+		constexpr uint32_t flag_pong = 0x2;
+		constexpr uint32_t flag_start = 0x4;
+	} // namespace
+
+	void flags_benchmarks()
+	{
+		section("event and thread flags");
+
+		osEventFlagsId_t raw = osEventFlagsNew(nullptr);
+		run("osEventFlagsSet/osEventFlagsWait", [&]() {
+			osEventFlagsSet(raw, flag_ping);
+			osEventFlagsWait(raw, flag_ping, osFlagsWaitAny, osWaitForever);
+		});
+
+		cmsis::event evt;
+		run("event set/wait", [&]() {
+			evt.set(flag_ping);
+			evt.wait(flag_ping);
+		});
+
+		run("this_thread::flags set/wait", [&]() {
+			cmsis::this_thread::flags::set(flag_ping);
+			cmsis::this_thread::flags::wait(flag_ping);
+		});
+
+		// Round trips between two threads
+		cmsis::thread raw_peer(thread_attributes("evt peer"), [&]() {
+			for (size_t i = 0; i < BENCH_SAMPLES; ++i)
+			{
+				osEventFlagsWait(raw, flag_ping, osFlagsWaitAny, osWaitForever);
+				osEventFlagsSet(raw, flag_pong);
+			}
+		});
+
+		run("osEventFlags round trip", BENCH_SAMPLES, 1, [&]() {
+			osEventFlagsSet(raw, flag_ping);
+			osEventFlagsWait(raw, flag_pong, osFlagsWaitAny, osWaitForever);
+		});
+		raw_peer.join();
+		osEventFlagsDelete(raw);
+
+		cmsis::thread evt_peer(thread_attributes("evt peer"), [&]() {
+			for (size_t i = 0; i < BENCH_SAMPLES; ++i)
+			{
+				evt.wait(flag_ping);
+				evt.set(flag_pong);
+			}
+		});
+
+		run("event round trip", BENCH_SAMPLES, 1, [&]() {
+			evt.set(flag_ping);
+			evt.wait(flag_pong);
+		});
+		evt_peer.join();
+
+		osThreadId_t self = osThreadGetId();
+		cmsis::thread raw_echo(thread_attributes("flags echo"), [&]() {
+			for (size_t i = 0; i < BENCH_SAMPLES; ++i)
+			{
+				osThreadFlagsWait(flag_ping, osFlagsWaitAny, osWaitForever);
+				osThreadFlagsSet(self, flag_pong);
+			}
+		});
+
+		osThreadId_t echo_id = raw_echo.native_handle();
+		run("osThreadFlags round trip", BENCH_SAMPLES, 1, [&]() {
+			osThreadFlagsSet(echo_id, flag_ping);
+			osThreadFlagsWait(flag_pong, osFlagsWaitAny, osWaitForever);
+		});
+		raw_echo.join();
+
+		// The wrapper only signals cmsis::thread objects: the round trip runs between two of them
+		cmsis::thread echo;
+		cmsis::thread pinger(thread_attributes("flags ping"), [&]() {
+			cmsis::this_thread::flags::wait(flag_start);
+			run("thread_flags round trip", BENCH_SAMPLES, 1, [&]() {
+				cmsis::thread_flags::set(echo, flag_ping);
+				cmsis::this_thread::flags::wait(flag_pong);
+			});
+		});
+
+		echo = cmsis::thread(thread_attributes("flags echo"), [&]() {
+			for (size_t i = 0; i < BENCH_SAMPLES; ++i)
+			{
+				cmsis::this_thread::flags::wait(flag_ping);
+				cmsis::thread_flags::set(pinger, flag_pong);
+			}
+		});
+
+		cmsis::thread_flags::set(pinger, flag_start);
+		pinger.join();
+		echo.join();
+	}
+} // namespace bench
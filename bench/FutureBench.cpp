@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Benchmark.h"
+#include "Future.h"
+#include "MessageQueue.h"
+#include "Semaphore.h"
+
+namespace bench
+{
+	namespace
+	{
+		// Request answered by another thread, through a semaphore of the client
+		struct semaphore_request
+		{
+			int value;
+			int result;
+			cmsis::binary_semaphore* done;
+		};
+
+		// Request answered by another thread, through a promise
+		struct future_request
+		{
+			int value;
+			cmsis::promise<int> result;
+		};
+
+		/// Run op with a server thread answering the requests of the queue, until a nullptr.
+		template <class Request, class Answer, class Op>
+		void run_server(const char* name, cmsis::message_queue<Request*>& queue, Answer answer, Op op)
+		{
+			cmsis::thread server(thread_attributes("bench server"), [&]() {
+				while (Request* request = queue.get())
+					answer(*request);
+			});
+
+			run(name, op);
+
+			queue.put(nullptr);
+			server.join();
+		}
+	} // namespace
+
+	void future_benchmarks()
+	{
+		section("future");
+
+		run("promise/future set_value/get", []() {
+			cmsis::promise<int> p;
+			cmsis::future<int> f = p.get_future();
+			p.set_value(1);
+			f.get();
+		});
+
+		cmsis::memory_pool<cmsis::promise<int>::state_type> pool(4);
+		run("promise(pool)/future set_value/get", [&]() {
+			cmsis::promise<int> p(pool);
+			cmsis::future<int> f = p.get_future();
+			p.set_value(1);
+			f.get();
+		});
+
+		// Request/response with another thread: the client waits for the answer
+		cmsis::binary_semaphore done(0);
+		cmsis::message_queue<semaphore_request*> semaphore_queue(4);
+		run_server(
+			"request/response, binary_semaphore",
+			semaphore_queue,
+			[](semaphore_request& r) {
+				r.result = r.value + 1;
+				r.done->release();
+			},
+			[&]() {
+				semaphore_request r = {1, 0, &done};
+				semaphore_queue.put(&r);
+				done.acquire();
+			});
+
+		cmsis::message_queue<future_request*> future_queue(4);
+		run_server(
+			"request/response, promise(pool)/future",
+			future_queue,
+			[](future_request& r) { r.result.set_value(r.value + 1); },
+			[&]() {
+				future_request r = {1, cmsis::promise<int>(pool)};
+				cmsis::future<int> f = r.result.get_future();
+				future_queue.put(&r);
+				f.get();
+			});
+	}
+} // namespace bench
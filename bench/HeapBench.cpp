@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Benchmark.h"
+#include "Slab.h"
+#include <cstdio>
+#include <cstdlib>
+
+namespace bench
+{
+	void heap_benchmarks()
+	{
+		section("heap");
+
+		for (size_t size : {16, 64, 256})
+		{
+			char name[64];
+			std::snprintf(name, sizeof(name), "malloc/free %u bytes", static_cast<unsigned>(size));
+			run(name, [&]() {
+				void* volatile p = std::malloc(size);
+				std::free(p);
+			});
+
+			std::snprintf(name, sizeof(name), "slab allocate/deallocate %u bytes", static_cast<unsigned>(size));
+			run(name, [&]() {
+				void* volatile p = cmsis::slab::allocate(size);
+				cmsis::slab::deallocate(p);
+			});
+		}
+
+		run("slab allocate/deallocate 1 KiB (heap)", [&]() {
+			void* volatile p = cmsis::slab::allocate(1024);
+			cmsis::slab::deallocate(p);
+		});
+
+		run_threads("malloc/free 64 bytes, 2 threads", 2, BENCH_SAMPLES, BENCH_BATCH, [&]() {
+			void* volatile p = std::malloc(64);
+			std::free(p);
+		});
+
+		run_threads("slab allocate/deallocate 64 bytes, 2 threads", 2, BENCH_SAMPLES, BENCH_BATCH, [&]() {
+			void* volatile p = cmsis::slab::allocate(64);
+			cmsis::slab::deallocate(p);
+		});
+
+		cmsis::slab_stats stats[8];
+		size_t count = cmsis::slab::collect(stats, 8);
+		std::printf(
+			"  %10s %10s %10s %10s %12s %10s\n", "block", "capacity", "in_use", "peak", "allocations", "overflows");
+		for (size_t i = 0; i < count && i < 8; ++i)
+		{
+			const cmsis::slab_stats& st = stats[i];
+			if (st.block_size)
+				std::printf("  %10u", static_cast<unsigned>(st.block_size));
+			else
+				std::printf("  %10s", "heap");
+			std::printf(
+				" %10u %10u %10u %12lu %10lu\n",
+				static_cast<unsigned>(st.capacity),
+				static_cast<unsigned>(st.in_use),
+				static_cast<unsigned>(st.peak),
+				static_cast<unsigned long>(st.allocations),
+				static_cast<unsigned long>(st.overflows));
+		}
+	}
+} // namespace bench
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Benchmark.h"
+#include "OS.h"
+#include <cstdio>
+#include <cstdlib>
+
+// Micro-benchmarks of the C++ wrappers, compared with the CMSIS-RTOS2 calls underneath.
+// The same sources run on the POSIX host port and on a target: printf must be retargeted there.
+int main()
+{
+	cmsis::kernel::initialize();
+
+	cmsis::thread runner(bench::thread_attributes("bench"), []() {
+		std::printf("CMSIS C++ benchmarks, %s\n", cmsis::kernel::version());
+		std::printf(
+			"system timer %lu Hz, kernel tick %lu Hz\n",
+			static_cast<unsigned long>(osKernelGetSysTimerFreq()),
+			static_cast<unsigned long>(osKernelGetTickFreq()));
+
+		bench::mutex_benchmarks();
+		bench::semaphore_benchmarks();
+		bench::message_queue_benchmarks();
+		bench::flags_benchmarks();
+		bench::memory_pool_benchmarks();
+		bench::heap_benchmarks();
+		bench::condition_variable_benchmarks();
+		bench::thread_benchmarks();
+		bench::future_benchmarks();
+		bench::timer_benchmarks();
+
+		std::fflush(stdout);
+		std::exit(EXIT_SUCCESS);
+	});
+
+	cmsis::kernel::start();
+	return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Benchmark.h"
+#include "Memory.h"
+#include "PoolAllocator.h"
+#include "SharedMemoryPool.h"
+#include <cstdio>
+#include <vector>
+
+namespace bench
+{
+	namespace
+	{
+		struct block
+		{
+			uint32_t data[8];
+		};
+
+		constexpr size_t pool_size = 64;
+	} // namespace
+
+	void memory_pool_benchmarks()
+	{
+		section("memory pool");
+
+		osMemoryPoolId_t raw = osMemoryPoolNew(pool_size, sizeof(block), nullptr);
+		run("osMemoryPoolAlloc/osMemoryPoolFree", [&]() {
+			void* p = osMemoryPoolAlloc(raw, osWaitForever);
+			osMemoryPoolFree(raw, p);
+		});
+		osMemoryPoolDelete(raw);
+
+		cmsis::memory_pool<block> pool(pool_size);
+		run("memory_pool allocate/deallocate", [&]() {
+			block* p = pool.allocate();
+			pool.deallocate(p, 1);
+		});
+
+		run("memory_pool make_unique", [&]() { auto p = pool.make_unique(); });
+
+		run("memory_pool make_shared", [&]() { auto p = pool.make_shared(); });
+
+		cmsis::shared_memory_pool<block> shared_pool(pool_size);
+		run("shared_memory_pool make_shared", [&]() { auto p = shared_pool.make_shared(); });
+
+		{
+			auto shared = pool.make_shared();
+			run("std::shared_ptr copy", [&]() { auto p = shared; });
+
+			auto shared_in_pool = shared_pool.make_shared();
+			run("shared_pool_ptr copy", [&]() { auto p = shared_in_pool; });
+		}
+
+		run("operator new/delete", [&]() {
+			block* volatile p = new block;
+			delete p;
+		});
+
+		// Fill then empty the whole pool: the free list does not stay hot on a single block
+		block* blocks[pool_size];
+		run("memory_pool allocate x64, deallocate x64", BENCH_SAMPLES / 8, 1, [&]() {
+			for (size_t i = 0; i < pool_size; ++i)
+				blocks[i] = pool.allocate();
+			for (size_t i = 0; i < pool_size; ++i)
+				pool.deallocate(blocks[i], 1);
+		});
+
+		// Growth of a vector: runs of contiguous blocks of different lengths
+		run("std::vector<int> 64 push_back", BENCH_SAMPLES / 8, 1, [&]() {
+			std::vector<int> v;
+			for (int i = 0; i < 64; ++i)
+				v.push_back(i);
+		});
+
+		cmsis::block_arena arena(pool_size, sizeof(block));
+		run("std::vector<int, pool_allocator> 64 push_back", BENCH_SAMPLES / 8, 1, [&]() {
+			std::vector<int, cmsis::pool_allocator<int>> v{cmsis::pool_allocator<int>(arena)};
+			for (int i = 0; i < 64; ++i)
+				v.push_back(i);
+		});
+
+		// Scaling with the number of threads: each thread keeps 4 blocks, with and without a cache per thread
+		typedef cmsis::memory_pool_cache<block> cache_type;
+		for (size_t threads : {1, 2, 4})
+		{
+			char name[64];
+			std::snprintf(name, sizeof(name), "memory_pool allocate x4/deallocate x4, %u threads", unsigned(threads));
+			run_threads(name, threads, BENCH_SAMPLES / 4, BENCH_BATCH, [&]() {
+				block* p[4];
+				for (auto& b : p)
+					b = pool.allocate();
+				for (auto& b : p)
+					pool.deallocate(b, 1);
+			});
+
+			std::snprintf(
+				name, sizeof(name), "memory_pool_cache allocate x4/deallocate x4, %u threads", unsigned(threads));
+			run_threads_local<cache_type>(name, threads, BENCH_SAMPLES / 4, BENCH_BATCH, pool, [](cache_type& cache) {
+				block* p[4];
+				for (auto& b : p)
+					b = cache.allocate();
+				for (auto& b : p)
+					cache.deallocate(b, 1);
+			});
+		}
+	}
+} // namespace bench
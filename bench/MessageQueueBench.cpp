@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Benchmark.h"
+#include "Mailbox.h"
+#include "MessageQueue.h"
+#include "MultilevelQueue.h"
+#include "SpscChannel.h"
+
+namespace bench
+{
+	namespace
+	{
+		struct packet
+		{
+			uint32_t data[64];
+		};
+	} // namespace
+
+	void message_queue_benchmarks()
+	{
+		section("message queue");
+
+		uint32_t value = 0;
+		osMessageQueueId_t raw = osMessageQueueNew(16, sizeof(uint32_t), nullptr);
+		run("osMessageQueuePut/osMessageQueueGet", [&]() {
+			osMessageQueuePut(raw, &value, 0, osWaitForever);
+			osMessageQueueGet(raw, &value, nullptr, osWaitForever);
+		});
+		osMessageQueueDelete(raw);
+
+		cmsis::message_queue<uint32_t> q(16);
+		run("message_queue<uint32_t> put/get", [&]() {
+			q.put(value);
+			value = q.get();
+		});
+
+		run("message_queue<uint32_t> put/get(0ms)", [&]() {
+			q.put(value);
+			q.get(value, std::chrono::milliseconds(0));
+		});
+
+		// Batches: the cost is given per message
+		uint32_t batch[BENCH_BATCH] = {};
+		run_amortized("message_queue<uint32_t> put/get x16, per message", BENCH_SAMPLES, BENCH_BATCH, [&]() {
+			for (size_t i = 0; i < BENCH_BATCH; ++i)
+				q.put(batch[i]);
+			for (size_t i = 0; i < BENCH_BATCH; ++i)
+				batch[i] = q.get();
+		});
+
+		run_amortized("message_queue<uint32_t> put_n/get_n, per message", BENCH_SAMPLES, BENCH_BATCH, [&]() {
+			q.put_n(batch, BENCH_BATCH);
+			q.get_n(batch, BENCH_BATCH);
+		});
+
+		run_amortized("message_queue<uint32_t> put_n/drain, per message", BENCH_SAMPLES, BENCH_BATCH, [&]() {
+			q.put_n(batch, BENCH_BATCH);
+			q.drain(batch, BENCH_BATCH);
+		});
+
+		// Ping-pong latency between two threads, through two queues of depth 1
+		cmsis::message_queue<uint32_t> ping(1);
+		cmsis::message_queue<uint32_t> pong(1);
+		cmsis::thread peer(thread_attributes("mq peer"), [&]() {
+			for (size_t i = 0; i < BENCH_SAMPLES; ++i)
+				pong.put(ping.get() + 1);
+		});
+
+		run("message_queue<uint32_t> ping-pong round trip", BENCH_SAMPLES, 1, [&]() {
+			ping.put(value);
+			value = pong.get();
+		});
+		peer.join();
+
+		// Streaming: the consumer drains what a producer thread pushes
+		cmsis::thread producer(thread_attributes("mq producer"), [&]() {
+			for (size_t i = 0; i < BENCH_SAMPLES * BENCH_BATCH; ++i)
+				q.put(static_cast<uint32_t>(i));
+		});
+
+		run("message_queue<uint32_t> producer -> consumer", [&]() { value = q.get(); });
+		producer.join();
+
+		cmsis::thread batch_producer(thread_attributes("mq producer"), [&]() {
+			for (size_t i = 0; i < BENCH_SAMPLES * BENCH_BATCH; ++i)
+				q.put(static_cast<uint32_t>(i));
+		});
+
+		size_t received = 0;
+		histogram batch_hist;
+		uint64_t batch_ns = 0;
+		while (received < BENCH_SAMPLES * BENCH_BATCH)
+		{
+			uint32_t start = now();
+			size_t n = q.get_n(batch, BENCH_BATCH);
+			uint64_t ns = elapsed_ns(start, now());
+
+			batch_ns += ns;
+			batch_hist.add(ns / n);
+			received += n;
+		}
+		report("message_queue<uint32_t> producer -> get_n consumer", received, batch_ns, batch_hist);
+		batch_producer.join();
+
+		// A high priority message behind 15 low priority ones: sorted insertion in the kernel queue, or one list
+		// per level
+		for (uint32_t i = 0; i < 15; ++i)
+			q.put(i, 0);
+		uint8_t priority = 0;
+		run("message_queue<uint32_t> put/get priority 1 over 15", [&]() {
+			q.put(value, 1);
+			q.get(value, priority);
+		});
+		q.clear();
+
+		static cmsis::multilevel_queue<uint32_t, 16> levels;
+		for (uint32_t i = 0; i < 15; ++i)
+			levels.put(i, 0);
+		run("multilevel_queue<uint32_t> put/get priority 1 over 15", [&]() {
+			levels.put(value, 1);
+			levels.get(value, priority);
+		});
+		levels.clear();
+
+		// Large messages: copied through the queue, or built in place in a mailbox slot
+		packet pkt = {};
+		cmsis::message_queue<packet> packets(4);
+		run("message_queue<256 bytes> put/get", [&]() {
+			pkt.data[0] = value;
+			packets.put(pkt);
+			packets.get(pkt);
+		});
+
+		cmsis::mailbox<packet> mailbox(4);
+		run("mailbox<256 bytes> loan/commit/receive", [&]() {
+			auto mail = mailbox.loan();
+			mail->data[0] = value;
+			mailbox.commit(std::move(mail));
+			mail = mailbox.receive();
+		});
+
+		// Same scenarios through a lock-free channel
+		static cmsis::spsc_channel<uint32_t, 16> channel;
+		run("spsc_channel<uint32_t, 16> put/get", [&]() {
+			channel.put(value);
+			value = channel.get();
+		});
+
+		run("spsc_channel<uint32_t, 16> try_put/try_get", [&]() {
+			channel.try_put(value);
+			channel.try_get(value);
+		});
+
+		static cmsis::spsc_channel<uint32_t, 1> channel_ping;
+		static cmsis::spsc_channel<uint32_t, 1> channel_pong;
+		cmsis::thread channel_peer(thread_attributes("channel peer"), [&]() {
+			for (size_t i = 0; i < BENCH_SAMPLES; ++i)
+				channel_pong.put(channel_ping.get() + 1);
+		});
+
+		run("spsc_channel<uint32_t, 1> ping-pong round trip", BENCH_SAMPLES, 1, [&]() {
+			channel_ping.put(value);
+			value = channel_pong.get();
+		});
+		channel_peer.join();
+
+		cmsis::thread channel_producer(thread_attributes("channel producer"), [&]() {
+			for (size_t i = 0; i < BENCH_SAMPLES * BENCH_BATCH; ++i)
+				channel.put(static_cast<uint32_t>(i));
+		});
+
+		run("spsc_channel<uint32_t, 16> producer -> consumer", [&]() { value = channel.get(); });
+		channel_producer.join();
+	}
+} // namespace bench
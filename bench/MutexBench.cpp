@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AdaptiveMutex.h"
+#include "Benchmark.h"
+#include "Mutex.h"
+#include "SharedMutex.h"
+#include <cstdio>
+
+namespace bench
+{
+	void mutex_benchmarks()
+	{
+		section("mutex");
+
+		osMutexId_t raw = osMutexNew(nullptr);
+		run("osMutexAcquire/osMutexRelease", [&]() {
+			osMutexAcquire(raw, osWaitForever);
+			osMutexRelease(raw);
+		});
+		osMutexDelete(raw);
+
+		cmsis::mutex m;
+		run("mutex lock/unlock", [&]() {
+			m.lock();
+			m.unlock();
+		});
+
+		run("mutex try_lock/unlock", [&]() {
+			if (m.try_lock())
+				m.unlock();
+		});
+
+		cmsis::recursive_mutex rm;
+		run("recursive_mutex lock/unlock", [&]() {
+			rm.lock();
+			rm.unlock();
+		});
+
+		cmsis::timed_mutex tm;
+		run("timed_mutex try_lock_for(1ms)/unlock", [&]() {
+			if (tm.try_lock_for(std::chrono::milliseconds(1)))
+				tm.unlock();
+		});
+
+		volatile uint32_t counter = 0;
+		run_threads("mutex lock/unlock, 2 threads", 2, BENCH_SAMPLES, BENCH_BATCH, [&]() {
+			m.lock();
+			counter = counter + 1;
+			m.unlock();
+		});
+
+		run_threads("mutex lock/unlock, 4 threads", 4, BENCH_SAMPLES, BENCH_BATCH, [&]() {
+			m.lock();
+			counter = counter + 1;
+			m.unlock();
+		});
+
+		cmsis::adaptive_mutex am;
+		run("adaptive_mutex lock/unlock", [&]() {
+			am.lock();
+			am.unlock();
+		});
+
+		run_threads("adaptive_mutex lock/unlock, 2 threads", 2, BENCH_SAMPLES, BENCH_BATCH, [&]() {
+			am.lock();
+			counter = counter + 1;
+			am.unlock();
+		});
+
+		run_threads("adaptive_mutex lock/unlock, 4 threads", 4, BENCH_SAMPLES, BENCH_BATCH, [&]() {
+			am.lock();
+			counter = counter + 1;
+			am.unlock();
+		});
+
+		cmsis::adaptive_mutex::statistics st = am.stats();
+		std::printf(
+			"  adaptive_mutex paths: %lu fast, %lu spin, %lu slow\n",
+			static_cast<unsigned long>(st.fast),
+			static_cast<unsigned long>(st.spin),
+			static_cast<unsigned long>(st.slow));
+
+		// Read-mostly table: readers only, then compared with the exclusive mutex above
+		cmsis::shared_mutex sm;
+		run("shared_mutex lock/unlock", [&]() {
+			sm.lock();
+			sm.unlock();
+		});
+
+		run("shared_mutex lock_shared/unlock_shared", [&]() {
+			sm.lock_shared();
+			sm.unlock_shared();
+		});
+
+		for (size_t threads : {2, 4})
+		{
+			char name[64];
+			std::snprintf(name, sizeof(name), "shared_mutex lock_shared/unlock_shared, %u threads", unsigned(threads));
+			run_threads(name, threads, BENCH_SAMPLES, BENCH_BATCH, [&]() {
+				sm.lock_shared();
+				uint32_t value = counter;
+				(void)value;
+				sm.unlock_shared();
+			});
+		}
+
+		// Lazy initialization, once it has been done
+		cmsis::once_flag once;
+		volatile bool initialized = false;
+		cmsis::call_once(once, [&]() { initialized = true; });
+		run("call_once, initialized", [&]() { cmsis::call_once(once, [&]() { initialized = true; }); });
+
+		run("mutex lock/check/unlock, initialized", [&]() {
+			m.lock();
+			if (!initialized)
+				initialized = true;
+			m.unlock();
+		});
+
+		run_threads("call_once, initialized, 4 threads", 4, BENCH_SAMPLES, BENCH_BATCH, [&]() {
+			cmsis::call_once(once, [&]() { initialized = true; });
+		});
+	}
+} // namespace bench
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Benchmark.h"
+#include "Semaphore.h"
+
+namespace bench
+{
+	void semaphore_benchmarks()
+	{
+		section("semaphore");
+
+		osSemaphoreId_t raw = osSemaphoreNew(1, 0, nullptr);
+		run("osSemaphoreRelease/osSemaphoreAcquire", [&]() {
+			osSemaphoreRelease(raw);
+			osSemaphoreAcquire(raw, osWaitForever);
+		});
+		osSemaphoreDelete(raw);
+
+		cmsis::binary_semaphore bs(0);
+		run("binary_semaphore release/acquire", [&]() {
+			bs.release();
+			bs.acquire();
+		});
+
+		cmsis::counting_semaphore<> cs(0);
+		run("counting_semaphore release(4)/acquire x4", [&]() {
+			cs.release(4);
+			for (int i = 0; i < 4; ++i)
+				cs.acquire();
+		});
+
+		run("counting_semaphore try_acquire on empty", [&]() { cs.try_acquire(); });
+
+		// Ping-pong: each round trip is two releases and two wake-ups
+		cmsis::binary_semaphore ping(0);
+		cmsis::binary_semaphore pong(0);
+		cmsis::thread peer(thread_attributes("sem peer"), [&]() {
+			for (size_t i = 0; i < BENCH_SAMPLES; ++i)
+			{
+				ping.acquire();
+				pong.release();
+			}
+		});
+
+		run("binary_semaphore ping-pong round trip", BENCH_SAMPLES, 1, [&]() {
+			ping.release();
+			pong.acquire();
+		});
+		peer.join();
+	}
+} // namespace bench
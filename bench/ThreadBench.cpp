@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Benchmark.h"
+#include "Semaphore.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <cstdio>
+
+namespace bench
+{
+	namespace
+	{
+		void empty_thread(void*)
+		{
+		}
+	} // namespace
+
+	void thread_benchmarks()
+	{
+		section("thread");
+
+		// Create and join: the cost is dominated by the kernel, the wrapper adds the routine and its control block
+		run("osThreadNew/osThreadJoin", BENCH_SAMPLES / 4, 1, []() {
+			osThreadAttr_t attr = {};
+			attr.attr_bits = osThreadJoinable;
+			attr.stack_size = BENCH_STACK_SIZE;
+			osThreadJoin(osThreadNew(empty_thread, nullptr, &attr));
+		});
+
+		run("thread create/join", BENCH_SAMPLES / 4, 1, []() {
+			cmsis::thread t(thread_attributes("bench worker"), []() {});
+			t.join();
+		});
+
+		run("thread create/join, bound arguments", BENCH_SAMPLES / 4, 1, []() {
+			int a = 0;
+			cmsis::thread t(thread_attributes("bench worker"), [](int& r, int v) { r = v; }, std::ref(a), 1);
+			t.join();
+		});
+
+		// Jobs of a thread pool: the cost is given per job, until the last one has run
+		const size_t jobs = 64;
+		std::atomic<uint32_t> pending(0);
+		cmsis::binary_semaphore done(0);
+		auto job = [&]() {
+			if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				done.release();
+		};
+
+		for (size_t workers : {1, 4})
+		{
+			cmsis::thread_pool pool(workers, thread_attributes("bench pool"), jobs);
+
+			char name[64];
+			std::snprintf(name, sizeof(name), "thread_pool submit, %u workers, per job", unsigned(workers));
+			run_amortized(name, BENCH_SAMPLES / 4, jobs, [&]() {
+				pending.store(jobs, std::memory_order_relaxed);
+				for (size_t i = 0; i < jobs; ++i)
+					pool.submit(job);
+				done.acquire();
+			});
+
+			// Submitted by a worker to its own deque, the others steal
+			std::snprintf(name, sizeof(name), "thread_pool submit from a job, %u workers, per job", unsigned(workers));
+			run_amortized(name, BENCH_SAMPLES / 4, jobs - 1, [&]() {
+				pending.store(jobs - 1, std::memory_order_relaxed);
+				pool.submit([&]() {
+					for (size_t i = 1; i < jobs; ++i)
+						pool.submit(job);
+				});
+				done.acquire();
+			});
+		}
+	}
+} // namespace bench
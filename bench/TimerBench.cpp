@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Benchmark.h"
+#include "EventFlag.h"
+#include "Timer.h"
+#include "TimerWheel.h"
+#include <cstdio>
+
+namespace bench
+{
+	void timer_benchmarks()
+	{
+		section("timer");
+
+		run("timer create/destroy", BENCH_SAMPLES / 8, 1, []() {
+			cmsis::timer t(std::chrono::milliseconds(1), []() { return false; });
+		});
+
+		run("static_timer create/destroy", BENCH_SAMPLES / 8, 1, []() {
+			cmsis::static_timer t(std::chrono::milliseconds(1), []() { return false; });
+		});
+
+		cmsis::timer idle(std::chrono::milliseconds(10), []() { return true; });
+		run("timer start/stop", [&]() {
+			idle.start();
+			idle.stop();
+		});
+
+		// Jitter of a 1 tick periodic timer: deviation of each period from the nominal one
+		const uint32_t tick_ns = 1000000000U / osKernelGetTickFreq();
+		const size_t periods = BENCH_SAMPLES / 8;
+		histogram hist;
+		uint64_t period_ns = 0;
+		uint64_t deviation_ns = 0;
+		size_t count = 0;
+		uint32_t last = 0;
+		cmsis::event done;
+
+		cmsis::timer periodic(
+			std::chrono::microseconds(1000000 / osKernelGetTickFreq()),
+			[&]() {
+				uint32_t t = now();
+				if (count)
+				{
+					uint64_t ns = elapsed_ns(last, t);
+					uint64_t deviation = ns > tick_ns ? ns - tick_ns : tick_ns - ns;
+					period_ns += ns;
+					deviation_ns += deviation;
+					hist.add(deviation);
+				}
+				last = t;
+
+				if (++count <= periods)
+					return true;
+
+				done.set(1);
+				return false;
+			});
+
+		periodic.start();
+		done.wait(1);
+		report("1 tick periodic timer, period deviation", periods, deviation_ns, hist);
+		std::printf(
+			"    average period %lu ns, tick %lu ns\n",
+			static_cast<unsigned long>(period_ns / periods),
+			static_cast<unsigned long>(tick_ns));
+
+		// Same operations on a timer wheel: a start or a stop is a list operation under the wheel mutex
+		cmsis::timer_wheel wheel(std::chrono::microseconds(100), thread_attributes("timer_wheel"));
+		cmsis::wheel_timer handle(wheel, [](void*) {});
+		run("wheel_timer start/stop", [&]() {
+			handle.start(std::chrono::milliseconds(10));
+			handle.stop();
+		});
+
+		// Lateness of one-shot wheel timers started one after the other
+		struct one_shot
+		{
+			uint32_t start;
+			uint64_t delay_ns;
+			uint64_t late_ns;
+			histogram hist;
+			cmsis::event done;
+		} shot;
+		shot.delay_ns = 1500000U;
+		shot.late_ns = 0;
+
+		cmsis::wheel_timer expiry(wheel, [](void* arg) {
+			one_shot& s = *static_cast<one_shot*>(arg);
+			uint64_t ns = elapsed_ns(s.start, now());
+			uint64_t late = ns > s.delay_ns ? ns - s.delay_ns : 0;
+			s.late_ns += late;
+			s.hist.add(late);
+			s.done.set(1);
+		}, &shot);
+
+		for (size_t i = 0; i < periods; ++i)
+		{
+			shot.start = now();
+			expiry.start(std::chrono::nanoseconds(shot.delay_ns));
+			shot.done.wait(1);
+		}
+		report("wheel_timer 1.5 ms one-shot, lateness", periods, shot.late_ns, shot.hist);
+	}
+} // namespace bench
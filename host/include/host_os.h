@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// POSIX host implementation of CMSIS-RTOS2: configuration and memory sizing.
+// This header plays the role of rtx_os.h for the host port.
+
+#ifndef CMSIS_HOST_OS_H_
+#define CMSIS_HOST_OS_H_
+
+#include "cmsis_os2.h"
+
+/// Kernel version reported by osKernelGetInfo (major.minor.rev: mmnnnrrrr dec).
+#define osHostVersionKernel 10000000U
+#define osHostKernelId      "POSIX host V1.0.0"
+
+/// Kernel tick frequency in Hz.
+#ifndef OS_HOST_TICK_FREQ
+#define OS_HOST_TICK_FREQ 1000U
+#endif
+
+/// System timer frequency in Hz (resolution of osKernelGetSysTimerCount).
+#ifndef OS_HOST_SYSTIMER_FREQ
+#define OS_HOST_SYSTIMER_FREQ 100000000U
+#endif
+
+/// Default thread stack size, used when osThreadAttr_t::stack_size is 0.
+#ifndef OS_HOST_STACK_SIZE
+#define OS_HOST_STACK_SIZE 4096U
+#endif
+
+/// Minimal stack really reserved for a thread. Embedded stack sizes are far too small for the host C library,
+/// so smaller requests are silently rounded up (osThreadGetStackSize still reports the requested size).
+#ifndef OS_HOST_MIN_STACK_SIZE
+#define OS_HOST_MIN_STACK_SIZE 0x40000U
+#endif
+
+/// Timer thread priority and stack size.
+#ifndef OS_HOST_TIMER_THREAD_PRIO
+#define OS_HOST_TIMER_THREAD_PRIO osPriorityHigh
+#endif
+
+#ifndef OS_HOST_TIMER_THREAD_STACK_SIZE
+#define OS_HOST_TIMER_THREAD_STACK_SIZE OS_HOST_STACK_SIZE
+#endif
+
+// Control block sizes, for static allocation through the cb_mem/cb_size attributes.
+#define osHostThreadCbSize       (40U * sizeof(void*) + 64U)
+#define osHostTimerCbSize        (12U * sizeof(void*))
+#define osHostEventFlagsCbSize   (8U * sizeof(void*))
+#define osHostMutexCbSize        (10U * sizeof(void*))
+#define osHostSemaphoreCbSize    (8U * sizeof(void*))
+#define osHostMemoryPoolCbSize   (12U * sizeof(void*))
+#define osHostMessageQueueCbSize (16U * sizeof(void*))
+
+/// Memory pool data storage size (mp_size attribute), blocks are aligned on 16 bytes.
+#define osHostMemoryPoolMemSize(block_count, block_size) ((block_count) * (((block_size) + 15U) & ~15U))
+
+/// Message queue data storage size (mq_size attribute), each message has a 3 words header.
+#define osHostMessageQueueMemSize(msg_count, msg_size) \
+	((msg_count) * (3U * sizeof(void*) + (((msg_size) + 7U) & ~7U)))
+
+#endif // CMSIS_HOST_OS_H_
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "host_lib.h"
+
+namespace host
+{
+	struct event_flags_cb : object_cb
+	{
+		futex_mutex lock;
+		uint32_t event_flags;
+		wait_queue waiters;
+	};
+} // namespace host
+
+using namespace host;
+
+//  ==== Event Flags Management Functions ====
+
+osEventFlagsId_t osEventFlagsNew(const osEventFlagsAttr_t* attr)
+{
+	static_assert(sizeof(event_flags_cb) <= osHostEventFlagsCbSize, "osHostEventFlagsCbSize too small");
+
+	event_flags_cb* ef = attr ? cb_pool<event_flags_cb>::create(attr->cb_mem, attr->cb_size)
+								: cb_pool<event_flags_cb>::create(nullptr, 0);
+	if (ef == nullptr)
+		return nullptr;
+
+	if (attr)
+		ef->name = attr->name;
+
+	ef->id = id_event_flags;
+	return ef;
+}
+
+const char* osEventFlagsGetName(osEventFlagsId_t ef_id)
+{
+	event_flags_cb* ef = cb_cast<event_flags_cb>(ef_id, id_event_flags);
+	return ef ? ef->name : nullptr;
+}
+
+uint32_t osEventFlagsSet(osEventFlagsId_t ef_id, uint32_t flags)
+{
+	event_flags_cb* ef = cb_cast<event_flags_cb>(ef_id, id_event_flags);
+	if (ef == nullptr || (flags & osFlagsError))
+		return osFlagsErrorParameter;
+
+	ef->lock.lock();
+	ef->event_flags |= flags;
+
+	// Wake up all the threads whose condition is satisfied, in queue order
+	thread_cb* t = ef->waiters.front();
+	while (t)
+	{
+		thread_cb* next = t->wait_next;
+		uint32_t pattern = flags_check(ef->event_flags, t->wait_flags, t->wait_options);
+		if (pattern)
+			thread_wake(ef->waiters, t, static_cast<int32_t>(pattern));
+		t = next;
+	}
+
+	uint32_t result = ef->event_flags;
+	ef->lock.unlock();
+
+	return result;
+}
+
+uint32_t osEventFlagsClear(osEventFlagsId_t ef_id, uint32_t flags)
+{
+	event_flags_cb* ef = cb_cast<event_flags_cb>(ef_id, id_event_flags);
+	if (ef == nullptr || (flags & osFlagsError))
+		return osFlagsErrorParameter;
+
+	ef->lock.lock();
+	uint32_t result = ef->event_flags;
+	ef->event_flags &= ~flags;
+	ef->lock.unlock();
+
+	return result;
+}
+
+uint32_t osEventFlagsGet(osEventFlagsId_t ef_id)
+{
+	event_flags_cb* ef = cb_cast<event_flags_cb>(ef_id, id_event_flags);
+	return ef ? ef->event_flags : 0;
+}
+
+uint32_t osEventFlagsWait(osEventFlagsId_t ef_id, uint32_t flags, uint32_t options, uint32_t timeout)
+{
+	event_flags_cb* ef = cb_cast<event_flags_cb>(ef_id, id_event_flags);
+	if (ef == nullptr || (flags & osFlagsError))
+		return osFlagsErrorParameter;
+
+	ef->lock.lock();
+	uint32_t pattern = flags_check(ef->event_flags, flags, options);
+	if (pattern)
+	{
+		ef->lock.unlock();
+		return pattern;
+	}
+
+	if (timeout == 0)
+	{
+		ef->lock.unlock();
+		return osFlagsErrorResource;
+	}
+
+	thread_cb* self = thread_current();
+	self->wait_flags = flags;
+	self->wait_options = options;
+	if (!thread_block(self, ef->lock, ef->waiters, timeout))
+		return osFlagsErrorTimeout;
+
+	return static_cast<uint32_t>(self->wait_result);
+}
+
+osStatus_t osEventFlagsDelete(osEventFlagsId_t ef_id)
+{
+	event_flags_cb* ef = cb_cast<event_flags_cb>(ef_id, id_event_flags);
+	if (ef == nullptr)
+		return osErrorParameter;
+
+	ef->lock.lock();
+	ef->id = id_invalid;
+	thread_wake_all(ef->waiters, static_cast<int32_t>(osFlagsErrorResource));
+	ef->lock.unlock();
+
+	cb_pool<event_flags_cb>::destroy(ef);
+	return osOK;
+}
@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "host_lib.h"
+#include <cstring>
+
+extern "C"
+{
+	uint32_t SystemCoreClock = OS_HOST_SYSTIMER_FREQ; /**< System Clock Frequency (Core Clock) */
+
+	void SystemCoreClockUpdate(void)
+	{}
+}
+
+namespace host
+{
+	kernel_cb kernel;
+
+	void futex_mutex::lock_slow() noexcept
+	{
+		// Short spin: kernel object critical sections are a few dozen instructions
+		for (int spin = 0; spin < 100; ++spin)
+		{
+			uint32_t c = m_state.load(std::memory_order_relaxed);
+			if (c == 2)
+				break;
+			if (c == 0 && m_state.compare_exchange_weak(c, 1, std::memory_order_acquire, std::memory_order_relaxed))
+				return;
+			cpu_relax();
+		}
+
+		while (m_state.exchange(2, std::memory_order_acquire) != 0)
+			futex_wait(m_state, 2, nullptr);
+	}
+
+	uint64_t monotonic_ns() noexcept
+	{
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return static_cast<uint64_t>(ts.tv_sec) * nsec_per_sec + static_cast<uint64_t>(ts.tv_nsec);
+	}
+
+	uint64_t epoch_ns() noexcept
+	{
+		static const uint64_t epoch = monotonic_ns();
+		return epoch;
+	}
+
+	void wait_queue::push(thread_cb* t) noexcept
+	{
+		thread_cb* prev = m_tail;
+		while (prev && prev->priority < t->priority)
+			prev = prev->wait_prev;
+
+		t->wait_prev = prev;
+		t->wait_next = prev ? prev->wait_next : m_head;
+		if (t->wait_next)
+			t->wait_next->wait_prev = t;
+		else
+			m_tail = t;
+		if (prev)
+			prev->wait_next = t;
+		else
+			m_head = t;
+	}
+
+	void wait_queue::remove(thread_cb* t) noexcept
+	{
+		if (t->wait_prev)
+			t->wait_prev->wait_next = t->wait_next;
+		else
+			m_head = t->wait_next;
+		if (t->wait_next)
+			t->wait_next->wait_prev = t->wait_prev;
+		else
+			m_tail = t->wait_prev;
+
+		t->wait_next = nullptr;
+		t->wait_prev = nullptr;
+	}
+
+	void kernel_wait_running() noexcept
+	{
+		while (kernel.running.load(std::memory_order_acquire) == 0)
+			futex_wait(kernel.running, 0, nullptr);
+	}
+
+	void kernel_register(thread_cb* t) noexcept
+	{
+		kernel.lock.lock();
+		t->thread_prev = nullptr;
+		t->thread_next = kernel.threads;
+		if (kernel.threads)
+			kernel.threads->thread_prev = t;
+		kernel.threads = t;
+		++kernel.thread_count;
+		kernel.lock.unlock();
+	}
+
+	void kernel_unregister(thread_cb* t) noexcept
+	{
+		kernel.lock.lock();
+		if (t->thread_prev)
+			t->thread_prev->thread_next = t->thread_next;
+		else
+			kernel.threads = t->thread_next;
+		if (t->thread_next)
+			t->thread_next->thread_prev = t->thread_prev;
+		--kernel.thread_count;
+		kernel.lock.unlock();
+	}
+} // namespace host
+
+using namespace host;
+
+//  ==== Kernel Management Functions ====
+
+osStatus_t osKernelInitialize(void)
+{
+	uint32_t state = osKernelInactive;
+	if (!kernel.state.compare_exchange_strong(state, osKernelReady))
+		return osError;
+
+	epoch_ns(); // the kernel tick starts counting here
+	return osOK;
+}
+
+osStatus_t osKernelGetInfo(osVersion_t* version, char* id_buf, uint32_t id_size)
+{
+	if (version)
+	{
+		version->api = 20010003U;
+		version->kernel = osHostVersionKernel;
+	}
+
+	if (id_buf && id_size)
+	{
+		std::strncpy(id_buf, osHostKernelId, id_size - 1);
+		id_buf[id_size - 1] = '\0';
+	}
+
+	return osOK;
+}
+
+osKernelState_t osKernelGetState(void)
+{
+	if (kernel.dispatch_owner.load(std::memory_order_relaxed))
+		return osKernelLocked;
+
+	return static_cast<osKernelState_t>(kernel.state.load());
+}
+
+osStatus_t osKernelStart(void)
+{
+	uint32_t state = osKernelReady;
+	if (!kernel.state.compare_exchange_strong(state, osKernelRunning))
+		return osError;
+
+	kernel.running.store(1, std::memory_order_release);
+	futex_wake(kernel.running, INT32_MAX);
+
+	// The calling context becomes the idle thread: it never returns
+	std::atomic<uint32_t> idle(0);
+	for (;;)
+		futex_wait(idle, 0, nullptr);
+}
+
+int32_t osKernelLock(void)
+{
+	thread_cb* self = thread_current();
+	if (kernel.dispatch_owner.load(std::memory_order_relaxed) == self)
+		return 1;
+
+	kernel.dispatch.lock();
+	kernel.dispatch_owner.store(self, std::memory_order_relaxed);
+	return 0;
+}
+
+int32_t osKernelUnlock(void)
+{
+	thread_cb* self = thread_current();
+	if (kernel.dispatch_owner.load(std::memory_order_relaxed) != self)
+		return 0;
+
+	kernel.dispatch_owner.store(nullptr, std::memory_order_relaxed);
+	kernel.dispatch.unlock();
+	return 1;
+}
+
+int32_t osKernelRestoreLock(int32_t lock)
+{
+	switch (lock)
+	{
+	case 0:
+		osKernelUnlock();
+		return 0;
+	case 1:
+		osKernelLock();
+		return 1;
+	default:
+		return osError;
+	}
+}
+
+uint32_t osKernelSuspend(void)
+{
+	return 0;
+}
+
+void osKernelResume(uint32_t sleep_ticks)
+{
+	(void)sleep_ticks;
+}
+
+uint32_t osKernelGetTickCount(void)
+{
+	uint64_t epoch = epoch_ns();
+	return static_cast<uint32_t>((monotonic_ns() - epoch) / tick_nsec);
+}
+
+uint32_t osKernelGetTickFreq(void)
+{
+	return OS_HOST_TICK_FREQ;
+}
+
+uint32_t osKernelGetSysTimerCount(void)
+{
+	uint64_t epoch = epoch_ns();
+	uint64_t ns = monotonic_ns() - epoch;
+
+	// Fast path for the frequencies that divide 1 GHz: a division by a constant
+	if (nsec_per_sec % OS_HOST_SYSTIMER_FREQ == 0)
+		return static_cast<uint32_t>(ns / (nsec_per_sec / OS_HOST_SYSTIMER_FREQ));
+
+	return static_cast<uint32_t>((static_cast<unsigned __int128>(ns) * OS_HOST_SYSTIMER_FREQ) / nsec_per_sec);
+}
+
+uint32_t osKernelGetSysTimerFreq(void)
+{
+	return OS_HOST_SYSTIMER_FREQ;
+}
@@ -0,0 +1,386 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Internal definitions of the POSIX host implementation of CMSIS-RTOS2.
+//
+// Every kernel object owns a futex based lock and an intrusive wait queue of thread control blocks.
+// Resources are handed over directly to the first waiter (highest priority first, then FIFO), like RTX does:
+// the waker fills the waiter's result under the object lock, then releases the futex word the waiter sleeps on.
+
+#ifndef CMSIS_HOST_LIB_H_
+#define CMSIS_HOST_LIB_H_
+
+#include "cmsis_os2.h"
+#include "host_os.h"
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <ctime>
+#include <exception>
+#include <linux/futex.h>
+#include <new>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace host
+{
+	// Control block identifiers
+	enum : uint32_t
+	{
+		id_invalid = 0x00,
+		id_thread = 0xF1,
+		id_timer = 0xF2,
+		id_event_flags = 0xF3,
+		id_mutex = 0xF5,
+		id_semaphore = 0xF6,
+		id_memory_pool = 0xF7,
+		id_message_queue = 0xFA
+	};
+
+	//  ==== Futex ====
+
+	inline long futex_wait(std::atomic<uint32_t>& word, uint32_t val, const timespec* abs_time) noexcept
+	{
+		// FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC timeout
+		return syscall(
+			SYS_futex,
+			reinterpret_cast<uint32_t*>(&word),
+			FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG,
+			val,
+			abs_time,
+			nullptr,
+			FUTEX_BITSET_MATCH_ANY);
+	}
+
+	inline void futex_wake(std::atomic<uint32_t>& word, int count) noexcept
+	{
+		syscall(
+			SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE | FUTEX_PRIVATE_FLAG, count, nullptr, nullptr, 0);
+	}
+
+	inline void cpu_relax() noexcept
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+		__asm__ __volatile__("yield");
+#endif
+	}
+
+	/// Lock of a kernel object: 0 unlocked, 1 locked, 2 locked with sleepers.
+	class futex_mutex
+	{
+	public:
+		constexpr futex_mutex() noexcept :
+			m_state(0)
+		{}
+
+		void lock() noexcept
+		{
+			uint32_t c = 0;
+			if (!m_state.compare_exchange_strong(c, 1, std::memory_order_acquire, std::memory_order_relaxed))
+				lock_slow();
+		}
+
+		void unlock() noexcept
+		{
+			if (m_state.exchange(0, std::memory_order_release) == 2)
+				futex_wake(m_state, 1);
+		}
+
+		futex_mutex(const futex_mutex&) = delete;
+		futex_mutex& operator=(const futex_mutex&) = delete;
+
+	private:
+		void lock_slow() noexcept;
+
+	private:
+		std::atomic<uint32_t> m_state;
+	};
+
+	//  ==== Time ====
+
+	constexpr uint64_t nsec_per_sec = 1000000000ULL;
+	constexpr uint64_t tick_nsec = nsec_per_sec / OS_HOST_TICK_FREQ;
+
+	uint64_t monotonic_ns() noexcept;
+
+	/// Time origin of the kernel tick and system timer counters.
+	uint64_t epoch_ns() noexcept;
+
+	inline timespec to_timespec(uint64_t ns) noexcept
+	{
+		timespec ts;
+		ts.tv_sec = static_cast<time_t>(ns / nsec_per_sec);
+		ts.tv_nsec = static_cast<long>(ns % nsec_per_sec);
+		return ts;
+	}
+
+	//  ==== Control blocks ====
+
+	/// Common header of all control blocks.
+	struct object_cb
+	{
+		uint32_t id;
+		bool cb_static;        // control block provided by the application (cb_mem)
+		object_cb* free_next;  // link in the recycling pool
+		const char* name;
+	};
+
+	/// Control blocks are never given back to the heap, but recycled: a late access on a deleted object
+	/// (for instance a waiter that timed out while the object was deleted) always hits valid memory.
+	template <class T> class cb_pool
+	{
+	public:
+		static T* create(void* cb_mem, uint32_t cb_size) noexcept
+		{
+			void* mem = cb_mem;
+			if (mem)
+			{
+				if (cb_size < sizeof(T) || (reinterpret_cast<uintptr_t>(mem) % alignof(T)) != 0)
+					return nullptr;
+			}
+			else
+			{
+				s_lock.lock();
+				mem = s_free;
+				if (s_free)
+					s_free = s_free->free_next;
+				s_lock.unlock();
+
+				if (!mem)
+					mem = ::operator new(sizeof(T), std::nothrow);
+				if (!mem)
+					return nullptr;
+			}
+
+			T* cb = new (mem) T();
+			cb->cb_static = (cb_mem != nullptr);
+			cb->free_next = nullptr;
+			return cb;
+		}
+
+		static void destroy(T* cb) noexcept
+		{
+			cb->id = id_invalid;
+			if (cb->cb_static)
+				return;
+
+			s_lock.lock();
+			cb->free_next = s_free;
+			s_free = cb;
+			s_lock.unlock();
+		}
+
+	private:
+		static futex_mutex s_lock;
+		static object_cb* s_free;
+	};
+
+	template <class T> futex_mutex cb_pool<T>::s_lock;
+	template <class T> object_cb* cb_pool<T>::s_free = nullptr;
+
+	/// Validate an object identifier.
+	template <class T> inline T* cb_cast(void* id, uint32_t type) noexcept
+	{
+		T* cb = static_cast<T*>(id);
+		if (cb == nullptr || cb->id != type)
+			return nullptr;
+		return cb;
+	}
+
+	struct thread_cb;
+	struct mutex_cb;
+
+	/// Intrusive list of waiting threads, ordered by priority, FIFO among equal priorities.
+	class wait_queue
+	{
+	public:
+		wait_queue() noexcept :
+			m_head(nullptr),
+			m_tail(nullptr)
+		{}
+
+		void push(thread_cb* t) noexcept;
+		void remove(thread_cb* t) noexcept;
+
+		thread_cb* front() const noexcept { return m_head; }
+		bool empty() const noexcept { return m_head == nullptr; }
+
+	private:
+		thread_cb* m_head;
+		thread_cb* m_tail;
+	};
+
+	enum : uint32_t
+	{
+		wait_none = 0,     // not waiting, or woken by a waker
+		wait_pending = 1,  // sleeping in a wait queue
+		wait_interrupt = 2 // sleeping, but termination has been requested
+	};
+
+	enum : uint32_t
+	{
+		request_terminate = 1,
+		request_suspend = 2
+	};
+
+	struct thread_cb : object_cb
+	{
+		osPriority_t priority;
+		uint32_t attr_bits;
+		osThreadFunc_t func;
+		void* argument;
+		pthread_t handle;
+		uint32_t stack_size;
+		uintptr_t stack_top;
+		bool adopted;  // thread not created by osThreadNew
+		bool detached; // protected by lock
+		bool joining;  // protected by lock
+		std::atomic<uint32_t> state;
+
+		futex_mutex lock; // protects thread flags, join and detach
+		uint32_t thread_flags;
+		wait_queue flags_queue;
+		wait_queue join_queue;
+		wait_queue delay_queue;
+
+		// Current wait, protected by the lock of the object the thread is waiting on
+		std::atomic<uint32_t> wait;
+		thread_cb* wait_next;
+		thread_cb* wait_prev;
+		int32_t wait_result;
+		void* wait_data;
+		uint32_t wait_flags;
+		uint32_t wait_options;
+		uint8_t wait_prio;
+		uint8_t* wait_prio_ptr;
+
+		mutex_cb* mutex_list; // owned mutexes, released on exit
+
+		std::atomic<uint32_t> request; // asynchronous terminate and suspend requests
+		std::atomic<uint32_t> park;    // futex word of a suspended thread
+
+		thread_cb* thread_next; // link in the kernel thread list
+		thread_cb* thread_prev;
+	};
+
+	struct mutex_cb : object_cb
+	{
+		uint32_t attr_bits;
+		futex_mutex lock;
+		thread_cb* owner;
+		uint32_t lock_count;
+		wait_queue waiters;
+		mutex_cb* owner_next; // link in the owner's list of mutexes
+		mutex_cb* owner_prev;
+	};
+
+	//  ==== Kernel ====
+
+	// Constant initialized: objects with static storage duration may be created before main()
+	struct kernel_cb
+	{
+		std::atomic<uint32_t> state {osKernelInactive}; // osKernelState_t, without the locked state
+		std::atomic<uint32_t> running {0};              // futex word released by osKernelStart
+		futex_mutex lock;                               // protects the thread list
+		thread_cb* threads = nullptr;
+		uint32_t thread_count = 0;
+		futex_mutex dispatch; // osKernelLock
+		std::atomic<thread_cb*> dispatch_owner {nullptr};
+	};
+
+	extern kernel_cb kernel;
+	extern thread_local thread_cb* tls_thread;
+
+	void kernel_wait_running() noexcept;
+	void kernel_register(thread_cb* t) noexcept;
+	void kernel_unregister(thread_cb* t) noexcept;
+
+	//  ==== Threads ====
+
+	thread_cb* thread_adopt() noexcept;
+
+	/// Control block of the calling thread. Threads not created by osThreadNew are adopted on first use.
+	inline thread_cb* thread_current() noexcept
+	{
+		thread_cb* t = tls_thread;
+		return t ? t : thread_adopt();
+	}
+
+	/// Block the calling thread on a wait queue. The object lock must be held, it is released on return.
+	/// Return true if the thread has been woken by thread_wake, false on timeout.
+	bool thread_block(thread_cb* self, futex_mutex& lk, wait_queue& q, uint32_t timeout);
+
+	/// Remove a thread from a wait queue and wake it up. The object lock must be held.
+	inline void thread_wake(wait_queue& q, thread_cb* t, int32_t result) noexcept
+	{
+		q.remove(t);
+		t->wait_result = result;
+		t->wait.store(wait_none, std::memory_order_release);
+		futex_wake(t->wait, 1);
+	}
+
+	/// Wake up all the threads of a wait queue (object deletion). The object lock must be held.
+	inline void thread_wake_all(wait_queue& q, int32_t result) noexcept
+	{
+		while (!q.empty())
+			thread_wake(q, q.front(), result);
+	}
+
+	/// Terminate the calling thread. pthread_exit unwinds the stack: never call it from a noexcept function.
+	__NO_RETURN void thread_exit(thread_cb* self);
+
+	//  ==== Mutexes ====
+
+	/// Release all the mutexes owned by a terminating thread.
+	void mutex_owner_release(thread_cb* t) noexcept;
+
+	//  ==== Flags ====
+
+	/// Check a flags pattern against a wait condition, and clear the flags waited for.
+	/// Return the flags before clearing, or 0 if the condition is not satisfied.
+	inline uint32_t flags_check(uint32_t& flags, uint32_t mask, uint32_t options) noexcept
+	{
+		if (options & osFlagsWaitAll)
+		{
+			if ((flags & mask) != mask)
+				return 0;
+		}
+		else if ((flags & mask) == 0)
+			return 0;
+
+		uint32_t pattern = flags;
+		if ((options & osFlagsNoClear) == 0)
+			flags &= ~mask;
+
+		return pattern;
+	}
+} // namespace host
+
+#endif // CMSIS_HOST_LIB_H_
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "host_lib.h"
+
+namespace host
+{
+	struct memory_pool_cb : object_cb
+	{
+		futex_mutex lock;
+		uint8_t* storage;
+		bool storage_static;
+		uint32_t block_count;
+		uint32_t block_size;
+		uint32_t used;
+		void* free_list;
+		wait_queue waiters;
+	};
+
+	namespace
+	{
+		inline uint32_t block_align(uint32_t size) noexcept
+		{
+			return (size + 15U) & ~15U;
+		}
+	} // namespace
+} // namespace host
+
+using namespace host;
+
+//  ==== Memory Pool Management Functions ====
+
+osMemoryPoolId_t osMemoryPoolNew(uint32_t block_count, uint32_t block_size, const osMemoryPoolAttr_t* attr)
+{
+	static_assert(sizeof(memory_pool_cb) <= osHostMemoryPoolCbSize, "osHostMemoryPoolCbSize too small");
+
+	if (block_count == 0 || block_size == 0 || block_size > UINT32_MAX - 15U)
+		return nullptr;
+
+	uint32_t size = block_align(block_size);
+	uint64_t storage_size = static_cast<uint64_t>(block_count) * size;
+	uint8_t* storage = nullptr;
+	if (attr && attr->mp_mem)
+	{
+		if (attr->mp_size < storage_size || (reinterpret_cast<uintptr_t>(attr->mp_mem) & 7U) != 0)
+			return nullptr;
+		storage = static_cast<uint8_t*>(attr->mp_mem);
+	}
+
+	memory_pool_cb* mp = attr ? cb_pool<memory_pool_cb>::create(attr->cb_mem, attr->cb_size)
+								: cb_pool<memory_pool_cb>::create(nullptr, 0);
+	if (mp == nullptr)
+		return nullptr;
+
+	mp->storage_static = (storage != nullptr);
+	if (storage == nullptr)
+	{
+		storage = new (std::nothrow) uint8_t[storage_size];
+		if (storage == nullptr)
+		{
+			cb_pool<memory_pool_cb>::destroy(mp);
+			return nullptr;
+		}
+	}
+
+	// Link all the blocks in the free list
+	for (uint32_t i = 0; i < block_count; ++i)
+	{
+		void* block = storage + static_cast<size_t>(i) * size;
+		*static_cast<void**>(block) = (i + 1 < block_count) ? storage + static_cast<size_t>(i + 1) * size : nullptr;
+	}
+
+	if (attr)
+		mp->name = attr->name;
+
+	mp->storage = storage;
+	mp->block_count = block_count;
+	mp->block_size = size;
+	mp->free_list = storage;
+	mp->id = id_memory_pool;
+	return mp;
+}
+
+const char* osMemoryPoolGetName(osMemoryPoolId_t mp_id)
+{
+	memory_pool_cb* mp = cb_cast<memory_pool_cb>(mp_id, id_memory_pool);
+	return mp ? mp->name : nullptr;
+}
+
+void* osMemoryPoolAlloc(osMemoryPoolId_t mp_id, uint32_t timeout)
+{
+	memory_pool_cb* mp = cb_cast<memory_pool_cb>(mp_id, id_memory_pool);
+	if (mp == nullptr)
+		return nullptr;
+
+	mp->lock.lock();
+	void* block = mp->free_list;
+	if (block)
+	{
+		mp->free_list = *static_cast<void**>(block);
+		++mp->used;
+		mp->lock.unlock();
+		return block;
+	}
+
+	if (timeout == 0)
+	{
+		mp->lock.unlock();
+		return nullptr;
+	}
+
+	thread_cb* self = thread_current();
+	self->wait_data = nullptr;
+	if (!thread_block(self, mp->lock, mp->waiters, timeout))
+		return nullptr;
+
+	return self->wait_data;
+}
+
+osStatus_t osMemoryPoolFree(osMemoryPoolId_t mp_id, void* block)
+{
+	memory_pool_cb* mp = cb_cast<memory_pool_cb>(mp_id, id_memory_pool);
+	if (mp == nullptr)
+		return osErrorParameter;
+
+	uintptr_t offset = static_cast<uint8_t*>(block) - mp->storage;
+	if (block < mp->storage || offset >= static_cast<uintptr_t>(mp->block_count) * mp->block_size ||
+		(offset % mp->block_size) != 0)
+		return osErrorParameter;
+
+	osStatus_t sta = osOK;
+	mp->lock.lock();
+	if (mp->used == 0)
+		sta = osErrorResource;
+	else if (!mp->waiters.empty())
+	{
+		// The block goes directly to the first waiter
+		thread_cb* t = mp->waiters.front();
+		t->wait_data = block;
+		thread_wake(mp->waiters, t, osOK);
+	}
+	else
+	{
+		*static_cast<void**>(block) = mp->free_list;
+		mp->free_list = block;
+		--mp->used;
+	}
+	mp->lock.unlock();
+
+	return sta;
+}
+
+uint32_t osMemoryPoolGetCapacity(osMemoryPoolId_t mp_id)
+{
+	memory_pool_cb* mp = cb_cast<memory_pool_cb>(mp_id, id_memory_pool);
+	return mp ? mp->block_count : 0;
+}
+
+uint32_t osMemoryPoolGetBlockSize(osMemoryPoolId_t mp_id)
+{
+	memory_pool_cb* mp = cb_cast<memory_pool_cb>(mp_id, id_memory_pool);
+	return mp ? mp->block_size : 0;
+}
+
+uint32_t osMemoryPoolGetCount(osMemoryPoolId_t mp_id)
+{
+	memory_pool_cb* mp = cb_cast<memory_pool_cb>(mp_id, id_memory_pool);
+	return mp ? mp->used : 0;
+}
+
+uint32_t osMemoryPoolGetSpace(osMemoryPoolId_t mp_id)
+{
+	memory_pool_cb* mp = cb_cast<memory_pool_cb>(mp_id, id_memory_pool);
+	return mp ? mp->block_count - mp->used : 0;
+}
+
+osStatus_t osMemoryPoolDelete(osMemoryPoolId_t mp_id)
+{
+	memory_pool_cb* mp = cb_cast<memory_pool_cb>(mp_id, id_memory_pool);
+	if (mp == nullptr)
+		return osErrorParameter;
+
+	mp->lock.lock();
+	mp->id = id_invalid;
+	thread_wake_all(mp->waiters, osErrorResource);
+	mp->lock.unlock();
+
+	if (!mp->storage_static)
+		delete[] mp->storage;
+	cb_pool<memory_pool_cb>::destroy(mp);
+	return osOK;
+}
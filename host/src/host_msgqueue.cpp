@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "host_lib.h"
+#include <cstring>
+
+namespace host
+{
+	/// Message header, followed by the message data.
+	struct message_cb
+	{
+		message_cb* next;
+		message_cb* prev;
+		uintptr_t priority;
+	};
+
+	struct message_queue_cb : object_cb
+	{
+		futex_mutex lock;
+		uint8_t* storage;
+		bool storage_static;
+		uint32_t msg_count;
+		uint32_t msg_size;
+		uint32_t count;
+		message_cb* free_list;
+		message_cb* head;
+		message_cb* tail;
+		wait_queue get_waiters; // threads waiting for a message (queue empty)
+		wait_queue put_waiters; // threads waiting for a free slot (queue full)
+	};
+
+	namespace
+	{
+		inline uint32_t msg_align(uint32_t size) noexcept
+		{
+			return (size + 7U) & ~7U;
+		}
+
+		inline void* msg_data(message_cb* msg) noexcept
+		{
+			return msg + 1;
+		}
+
+		/// Insert a message by priority, FIFO among equal priorities.
+		void msg_insert(message_queue_cb* mq, message_cb* msg, uint8_t priority) noexcept
+		{
+			message_cb* prev = mq->tail;
+			while (prev && prev->priority < priority)
+				prev = prev->prev;
+
+			msg->priority = priority;
+			msg->prev = prev;
+			msg->next = prev ? prev->next : mq->head;
+			if (msg->next)
+				msg->next->prev = msg;
+			else
+				mq->tail = msg;
+			if (prev)
+				prev->next = msg;
+			else
+				mq->head = msg;
+
+			++mq->count;
+		}
+
+		message_cb* msg_remove(message_queue_cb* mq) noexcept
+		{
+			message_cb* msg = mq->head;
+			mq->head = msg->next;
+			if (mq->head)
+				mq->head->prev = nullptr;
+			else
+				mq->tail = nullptr;
+
+			--mq->count;
+			return msg;
+		}
+
+		/// Move the messages of blocked senders into the free slots. The queue lock must be held.
+		void msg_fill(message_queue_cb* mq) noexcept
+		{
+			while (mq->free_list && !mq->put_waiters.empty())
+			{
+				thread_cb* t = mq->put_waiters.front();
+				message_cb* msg = mq->free_list;
+				mq->free_list = msg->next;
+				std::memcpy(msg_data(msg), t->wait_data, mq->msg_size);
+				msg_insert(mq, msg, t->wait_prio);
+				thread_wake(mq->put_waiters, t, osOK);
+			}
+		}
+	} // namespace
+} // namespace host
+
+using namespace host;
+
+//  ==== Message Queue Management Functions ====
+
+osMessageQueueId_t osMessageQueueNew(uint32_t msg_count, uint32_t msg_size, const osMessageQueueAttr_t* attr)
+{
+	static_assert(sizeof(message_queue_cb) <= osHostMessageQueueCbSize, "osHostMessageQueueCbSize too small");
+	static_assert(sizeof(message_cb) == 3 * sizeof(void*), "message header size mismatch with host_os.h");
+
+	if (msg_count == 0 || msg_size == 0 || msg_size > UINT32_MAX - 7U)
+		return nullptr;
+
+	uint64_t slot_size = sizeof(message_cb) + msg_align(msg_size);
+	uint64_t storage_size = slot_size * msg_count;
+	uint8_t* storage = nullptr;
+	if (attr && attr->mq_mem)
+	{
+		if (attr->mq_size < storage_size || (reinterpret_cast<uintptr_t>(attr->mq_mem) % alignof(message_cb)) != 0)
+			return nullptr;
+		storage = static_cast<uint8_t*>(attr->mq_mem);
+	}
+
+	message_queue_cb* mq = attr ? cb_pool<message_queue_cb>::create(attr->cb_mem, attr->cb_size)
+								: cb_pool<message_queue_cb>::create(nullptr, 0);
+	if (mq == nullptr)
+		return nullptr;
+
+	mq->storage_static = (storage != nullptr);
+	if (storage == nullptr)
+	{
+		storage = new (std::nothrow) uint8_t[storage_size];
+		if (storage == nullptr)
+		{
+			cb_pool<message_queue_cb>::destroy(mq);
+			return nullptr;
+		}
+	}
+
+	for (uint32_t i = 0; i < msg_count; ++i)
+	{
+		message_cb* msg = reinterpret_cast<message_cb*>(storage + i * slot_size);
+		msg->next = (i + 1 < msg_count) ? reinterpret_cast<message_cb*>(storage + (i + 1) * slot_size) : nullptr;
+	}
+
+	if (attr)
+		mq->name = attr->name;
+
+	mq->storage = storage;
+	mq->msg_count = msg_count;
+	mq->msg_size = msg_size;
+	mq->free_list = reinterpret_cast<message_cb*>(storage);
+	mq->id = id_message_queue;
+	return mq;
+}
+
+const char* osMessageQueueGetName(osMessageQueueId_t mq_id)
+{
+	message_queue_cb* mq = cb_cast<message_queue_cb>(mq_id, id_message_queue);
+	return mq ? mq->name : nullptr;
+}
+
+osStatus_t osMessageQueuePut(osMessageQueueId_t mq_id, const void* msg_ptr, uint8_t msg_prio, uint32_t timeout)
+{
+	message_queue_cb* mq = cb_cast<message_queue_cb>(mq_id, id_message_queue);
+	if (mq == nullptr || msg_ptr == nullptr)
+		return osErrorParameter;
+
+	mq->lock.lock();
+	if (!mq->get_waiters.empty())
+	{
+		// The queue is empty: copy the message directly to the first receiver
+		thread_cb* t = mq->get_waiters.front();
+		std::memcpy(t->wait_data, msg_ptr, mq->msg_size);
+		if (t->wait_prio_ptr)
+			*t->wait_prio_ptr = msg_prio;
+		thread_wake(mq->get_waiters, t, osOK);
+		mq->lock.unlock();
+		return osOK;
+	}
+
+	if (mq->free_list)
+	{
+		message_cb* msg = mq->free_list;
+		mq->free_list = msg->next;
+		std::memcpy(msg_data(msg), msg_ptr, mq->msg_size);
+		msg_insert(mq, msg, msg_prio);
+		mq->lock.unlock();
+		return osOK;
+	}
+
+	if (timeout == 0)
+	{
+		mq->lock.unlock();
+		return osErrorResource;
+	}
+
+	thread_cb* self = thread_current();
+	self->wait_data = const_cast<void*>(msg_ptr);
+	self->wait_prio = msg_prio;
+	if (!thread_block(self, mq->lock, mq->put_waiters, timeout))
+		return osErrorTimeout;
+
+	return static_cast<osStatus_t>(self->wait_result);
+}
+
+osStatus_t osMessageQueueGet(osMessageQueueId_t mq_id, void* msg_ptr, uint8_t* msg_prio, uint32_t timeout)
+{
+	message_queue_cb* mq = cb_cast<message_queue_cb>(mq_id, id_message_queue);
+	if (mq == nullptr || msg_ptr == nullptr)
+		return osErrorParameter;
+
+	mq->lock.lock();
+	if (mq->head)
+	{
+		message_cb* msg = msg_remove(mq);
+		std::memcpy(msg_ptr, msg_data(msg), mq->msg_size);
+		if (msg_prio)
+			*msg_prio = static_cast<uint8_t>(msg->priority);
+
+		msg->next = mq->free_list;
+		mq->free_list = msg;
+		msg_fill(mq);
+		mq->lock.unlock();
+		return osOK;
+	}
+
+	if (timeout == 0)
+	{
+		mq->lock.unlock();
+		return osErrorResource;
+	}
+
+	thread_cb* self = thread_current();
+	self->wait_data = msg_ptr;
+	self->wait_prio_ptr = msg_prio;
+	if (!thread_block(self, mq->lock, mq->get_waiters, timeout))
+		return osErrorTimeout;
+
+	return static_cast<osStatus_t>(self->wait_result);
+}
+
+uint32_t osMessageQueueGetCapacity(osMessageQueueId_t mq_id)
+{
+	message_queue_cb* mq = cb_cast<message_queue_cb>(mq_id, id_message_queue);
+	return mq ? mq->msg_count : 0;
+}
+
+uint32_t osMessageQueueGetMsgSize(osMessageQueueId_t mq_id)
+{
+	message_queue_cb* mq = cb_cast<message_queue_cb>(mq_id, id_message_queue);
+	return mq ? mq->msg_size : 0;
+}
+
+uint32_t osMessageQueueGetCount(osMessageQueueId_t mq_id)
+{
+	message_queue_cb* mq = cb_cast<message_queue_cb>(mq_id, id_message_queue);
+	return mq ? mq->count : 0;
+}
+
+uint32_t osMessageQueueGetSpace(osMessageQueueId_t mq_id)
+{
+	message_queue_cb* mq = cb_cast<message_queue_cb>(mq_id, id_message_queue);
+	return mq ? mq->msg_count - mq->count : 0;
+}
+
+osStatus_t osMessageQueueReset(osMessageQueueId_t mq_id)
+{
+	message_queue_cb* mq = cb_cast<message_queue_cb>(mq_id, id_message_queue);
+	if (mq == nullptr)
+		return osErrorParameter;
+
+	mq->lock.lock();
+	while (mq->head)
+	{
+		message_cb* msg = msg_remove(mq);
+		msg->next = mq->free_list;
+		mq->free_list = msg;
+	}
+	msg_fill(mq);
+	mq->lock.unlock();
+
+	return osOK;
+}
+
+osStatus_t osMessageQueueDelete(osMessageQueueId_t mq_id)
+{
+	message_queue_cb* mq = cb_cast<message_queue_cb>(mq_id, id_message_queue);
+	if (mq == nullptr)
+		return osErrorParameter;
+
+	mq->lock.lock();
+	mq->id = id_invalid;
+	thread_wake_all(mq->get_waiters, osErrorResource);
+	thread_wake_all(mq->put_waiters, osErrorResource);
+	mq->lock.unlock();
+
+	if (!mq->storage_static)
+		delete[] mq->storage;
+	cb_pool<message_queue_cb>::destroy(mq);
+	return osOK;
+}
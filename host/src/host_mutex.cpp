@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "host_lib.h"
+
+namespace host
+{
+	namespace
+	{
+		void owner_link(thread_cb* t, mutex_cb* m) noexcept
+		{
+			m->owner = t;
+			m->owner_prev = nullptr;
+			m->owner_next = t->mutex_list;
+			if (t->mutex_list)
+				t->mutex_list->owner_prev = m;
+			t->mutex_list = m;
+		}
+
+		void owner_unlink(thread_cb* t, mutex_cb* m) noexcept
+		{
+			if (m->owner_prev)
+				m->owner_prev->owner_next = m->owner_next;
+			else
+				t->mutex_list = m->owner_next;
+			if (m->owner_next)
+				m->owner_next->owner_prev = m->owner_prev;
+
+			m->owner_next = nullptr;
+			m->owner_prev = nullptr;
+		}
+
+		/// Give a released mutex to the first waiter. The mutex lock must be held.
+		void mutex_handoff(mutex_cb* m) noexcept
+		{
+			if (m->waiters.empty())
+			{
+				m->owner = nullptr;
+				m->lock_count = 0;
+				return;
+			}
+
+			thread_cb* t = m->waiters.front();
+			m->lock_count = 1;
+			owner_link(t, m);
+			thread_wake(m->waiters, t, osOK);
+		}
+	} // namespace
+
+	void mutex_owner_release(thread_cb* t) noexcept
+	{
+		while (t->mutex_list)
+		{
+			mutex_cb* m = t->mutex_list;
+			m->lock.lock();
+			owner_unlink(t, m);
+
+			// Like RTX, only robust mutexes are released, the others remain locked
+			if (m->attr_bits & osMutexRobust)
+				mutex_handoff(m);
+			m->lock.unlock();
+		}
+	}
+} // namespace host
+
+using namespace host;
+
+//  ==== Mutex Management Functions ====
+
+osMutexId_t osMutexNew(const osMutexAttr_t* attr)
+{
+	static_assert(sizeof(mutex_cb) <= osHostMutexCbSize, "osHostMutexCbSize too small");
+
+	mutex_cb* m = attr ? cb_pool<mutex_cb>::create(attr->cb_mem, attr->cb_size) : cb_pool<mutex_cb>::create(nullptr, 0);
+	if (m == nullptr)
+		return nullptr;
+
+	if (attr)
+	{
+		m->name = attr->name;
+		m->attr_bits = attr->attr_bits;
+	}
+
+	m->id = id_mutex;
+	return m;
+}
+
+const char* osMutexGetName(osMutexId_t mutex_id)
+{
+	mutex_cb* m = cb_cast<mutex_cb>(mutex_id, id_mutex);
+	return m ? m->name : nullptr;
+}
+
+osStatus_t osMutexAcquire(osMutexId_t mutex_id, uint32_t timeout)
+{
+	mutex_cb* m = cb_cast<mutex_cb>(mutex_id, id_mutex);
+	if (m == nullptr)
+		return osErrorParameter;
+
+	thread_cb* self = thread_current();
+	m->lock.lock();
+	if (m->owner == nullptr)
+	{
+		m->lock_count = 1;
+		owner_link(self, m);
+		m->lock.unlock();
+		return osOK;
+	}
+
+	if (m->owner == self)
+	{
+		osStatus_t sta = osErrorResource;
+		if ((m->attr_bits & osMutexRecursive) && m->lock_count != UINT32_MAX)
+		{
+			++m->lock_count;
+			sta = osOK;
+		}
+
+		m->lock.unlock();
+		return sta;
+	}
+
+	if (timeout == 0)
+	{
+		m->lock.unlock();
+		return osErrorResource;
+	}
+
+	if (!thread_block(self, m->lock, m->waiters, timeout))
+		return osErrorTimeout;
+
+	return static_cast<osStatus_t>(self->wait_result);
+}
+
+osStatus_t osMutexRelease(osMutexId_t mutex_id)
+{
+	mutex_cb* m = cb_cast<mutex_cb>(mutex_id, id_mutex);
+	if (m == nullptr)
+		return osErrorParameter;
+
+	thread_cb* self = thread_current();
+	m->lock.lock();
+	if (m->owner != self)
+	{
+		m->lock.unlock();
+		return osErrorResource;
+	}
+
+	if (--m->lock_count == 0)
+	{
+		owner_unlink(self, m);
+		mutex_handoff(m);
+	}
+
+	m->lock.unlock();
+	return osOK;
+}
+
+osThreadId_t osMutexGetOwner(osMutexId_t mutex_id)
+{
+	mutex_cb* m = cb_cast<mutex_cb>(mutex_id, id_mutex);
+	return m ? m->owner : nullptr;
+}
+
+osStatus_t osMutexDelete(osMutexId_t mutex_id)
+{
+	mutex_cb* m = cb_cast<mutex_cb>(mutex_id, id_mutex);
+	if (m == nullptr)
+		return osErrorParameter;
+
+	m->lock.lock();
+	m->id = id_invalid;
+	if (m->owner)
+		owner_unlink(m->owner, m);
+	thread_wake_all(m->waiters, osErrorResource);
+	m->lock.unlock();
+
+	cb_pool<mutex_cb>::destroy(m);
+	return osOK;
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "host_lib.h"
+
+namespace host
+{
+	struct semaphore_cb : object_cb
+	{
+		futex_mutex lock;
+		uint32_t tokens;
+		uint32_t max_tokens;
+		wait_queue waiters;
+	};
+} // namespace host
+
+using namespace host;
+
+//  ==== Semaphore Management Functions ====
+
+osSemaphoreId_t osSemaphoreNew(uint32_t max_count, uint32_t initial_count, const osSemaphoreAttr_t* attr)
+{
+	static_assert(sizeof(semaphore_cb) <= osHostSemaphoreCbSize, "osHostSemaphoreCbSize too small");
+
+	if (max_count == 0 || initial_count > max_count)
+		return nullptr;
+
+	semaphore_cb* s =
+		attr ? cb_pool<semaphore_cb>::create(attr->cb_mem, attr->cb_size) : cb_pool<semaphore_cb>::create(nullptr, 0);
+	if (s == nullptr)
+		return nullptr;
+
+	if (attr)
+		s->name = attr->name;
+
+	s->tokens = initial_count;
+	s->max_tokens = max_count;
+	s->id = id_semaphore;
+	return s;
+}
+
+const char* osSemaphoreGetName(osSemaphoreId_t semaphore_id)
+{
+	semaphore_cb* s = cb_cast<semaphore_cb>(semaphore_id, id_semaphore);
+	return s ? s->name : nullptr;
+}
+
+osStatus_t osSemaphoreAcquire(osSemaphoreId_t semaphore_id, uint32_t timeout)
+{
+	semaphore_cb* s = cb_cast<semaphore_cb>(semaphore_id, id_semaphore);
+	if (s == nullptr)
+		return osErrorParameter;
+
+	s->lock.lock();
+	if (s->tokens)
+	{
+		--s->tokens;
+		s->lock.unlock();
+		return osOK;
+	}
+
+	if (timeout == 0)
+	{
+		s->lock.unlock();
+		return osErrorResource;
+	}
+
+	thread_cb* self = thread_current();
+	if (!thread_block(self, s->lock, s->waiters, timeout))
+		return osErrorTimeout;
+
+	return static_cast<osStatus_t>(self->wait_result);
+}
+
+osStatus_t osSemaphoreRelease(osSemaphoreId_t semaphore_id)
+{
+	semaphore_cb* s = cb_cast<semaphore_cb>(semaphore_id, id_semaphore);
+	if (s == nullptr)
+		return osErrorParameter;
+
+	osStatus_t sta = osOK;
+	s->lock.lock();
+	if (!s->waiters.empty())
+		thread_wake(s->waiters, s->waiters.front(), osOK); // the token goes directly to the waiter
+	else if (s->tokens < s->max_tokens)
+		++s->tokens;
+	else
+		sta = osErrorResource;
+	s->lock.unlock();
+
+	return sta;
+}
+
+uint32_t osSemaphoreGetCount(osSemaphoreId_t semaphore_id)
+{
+	semaphore_cb* s = cb_cast<semaphore_cb>(semaphore_id, id_semaphore);
+	return s ? s->tokens : 0;
+}
+
+osStatus_t osSemaphoreDelete(osSemaphoreId_t semaphore_id)
+{
+	semaphore_cb* s = cb_cast<semaphore_cb>(semaphore_id, id_semaphore);
+	if (s == nullptr)
+		return osErrorParameter;
+
+	s->lock.lock();
+	s->id = id_invalid;
+	thread_wake_all(s->waiters, osErrorResource);
+	s->lock.unlock();
+
+	cb_pool<semaphore_cb>::destroy(s);
+	return osOK;
+}
@@ -0,0 +1,564 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "host_lib.h"
+#include <sched.h>
+
+namespace host
+{
+	thread_local thread_cb* tls_thread = nullptr;
+
+	namespace
+	{
+		// Releases the control block of an adopted thread when the underlying pthread exits
+		struct adopt_guard
+		{
+			thread_cb* cb = nullptr;
+
+			~adopt_guard()
+			{
+				if (cb)
+				{
+					mutex_owner_release(cb);
+					kernel_unregister(cb);
+					tls_thread = nullptr;
+					cb_pool<thread_cb>::destroy(cb);
+				}
+			}
+		};
+
+		thread_local adopt_guard tls_adopted;
+
+		void thread_park(thread_cb* self) noexcept
+		{
+			self->state.store(osThreadBlocked, std::memory_order_relaxed);
+
+			uint32_t park = self->park.load(std::memory_order_acquire);
+			while (self->request.load(std::memory_order_acquire) & request_suspend)
+			{
+				futex_wait(self->park, park, nullptr);
+				park = self->park.load(std::memory_order_acquire);
+			}
+
+			self->state.store(osThreadRunning, std::memory_order_relaxed);
+		}
+
+		/// Process asynchronous requests of other threads (osThreadTerminate, osThreadSuspend).
+		inline void thread_check_requests(thread_cb* self)
+		{
+			uint32_t request = self->request.load(std::memory_order_acquire);
+			if (request & request_terminate)
+				thread_exit(self);
+			if (request & request_suspend)
+				thread_park(self);
+		}
+
+		void* thread_entry(void* argument)
+		{
+			thread_cb* self = static_cast<thread_cb*>(argument);
+			tls_thread = self;
+			self->stack_top = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+
+			// Threads created before osKernelStart wait for the scheduler
+			kernel_wait_running();
+
+			self->state.store(osThreadRunning, std::memory_order_relaxed);
+			thread_check_requests(self);
+
+			self->func(self->argument);
+			thread_exit(self);
+		}
+
+		inline bool priority_valid(osPriority_t priority) noexcept
+		{
+			return priority >= osPriorityIdle && priority <= osPriorityISR;
+		}
+	} // namespace
+
+	thread_cb* thread_adopt() noexcept
+	{
+		thread_cb* t = cb_pool<thread_cb>::create(nullptr, 0);
+		if (!t)
+			std::terminate();
+
+		t->id = id_thread;
+		t->priority = osPriorityNormal;
+		t->handle = pthread_self();
+		t->stack_top = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+		t->adopted = true;
+		t->detached = true;
+		t->state.store(osThreadRunning, std::memory_order_relaxed);
+
+		kernel_register(t);
+		tls_thread = t;
+		tls_adopted.cb = t;
+		return t;
+	}
+
+	bool thread_block(thread_cb* self, futex_mutex& lk, wait_queue& q, uint32_t timeout)
+	{
+		if (self->request.load(std::memory_order_relaxed) & request_terminate)
+		{
+			lk.unlock();
+			thread_exit(self);
+		}
+
+		timespec abs_time;
+		const timespec* deadline = nullptr;
+		if (timeout != osWaitForever)
+		{
+			abs_time = to_timespec(monotonic_ns() + static_cast<uint64_t>(timeout) * tick_nsec);
+			deadline = &abs_time;
+		}
+
+		self->wait.store(wait_pending, std::memory_order_relaxed);
+		self->state.store(osThreadBlocked, std::memory_order_relaxed);
+		q.push(self);
+		lk.unlock();
+
+		while (self->wait.load(std::memory_order_acquire) == wait_pending)
+		{
+			if (futex_wait(self->wait, wait_pending, deadline) != 0 && errno == ETIMEDOUT)
+				break;
+		}
+
+		bool woken = (self->wait.load(std::memory_order_acquire) == wait_none);
+		if (!woken)
+		{
+			// Timeout or termination request: leave the queue, unless a waker has been faster
+			lk.lock();
+			woken = (self->wait.load(std::memory_order_relaxed) == wait_none);
+			if (!woken)
+			{
+				q.remove(self);
+				self->wait.store(wait_none, std::memory_order_relaxed);
+			}
+			lk.unlock();
+		}
+
+		self->state.store(osThreadRunning, std::memory_order_relaxed);
+		thread_check_requests(self);
+		return woken;
+	}
+
+	void thread_exit(thread_cb* self)
+	{
+		mutex_owner_release(self);
+		kernel_unregister(self);
+
+		self->lock.lock();
+		self->state.store(osThreadTerminated, std::memory_order_relaxed);
+		bool recycle = self->detached;
+		thread_wake_all(self->join_queue, osOK);
+		self->lock.unlock();
+
+		tls_thread = nullptr;
+		if (self->adopted)
+			tls_adopted.cb = nullptr;
+		if (recycle)
+			cb_pool<thread_cb>::destroy(self);
+
+		pthread_exit(nullptr);
+	}
+} // namespace host
+
+using namespace host;
+
+//  ==== Thread Management Functions ====
+
+osThreadId_t osThreadNew(osThreadFunc_t func, void* argument, const osThreadAttr_t* attr)
+{
+	static_assert(sizeof(thread_cb) <= osHostThreadCbSize, "osHostThreadCbSize too small");
+
+	if (func == nullptr)
+		return nullptr;
+
+	const char* name = nullptr;
+	uint32_t attr_bits = 0;
+	void* stack_mem = nullptr;
+	uint32_t stack_size = OS_HOST_STACK_SIZE;
+	osPriority_t priority = osPriorityNormal;
+	thread_cb* t = nullptr;
+	if (attr)
+	{
+		name = attr->name;
+		attr_bits = attr->attr_bits;
+		stack_mem = attr->stack_mem;
+		if (attr->stack_size)
+			stack_size = attr->stack_size;
+		if (attr->priority != osPriorityNone)
+		{
+			if (!priority_valid(attr->priority))
+				return nullptr;
+			priority = attr->priority;
+		}
+
+		t = cb_pool<thread_cb>::create(attr->cb_mem, attr->cb_size);
+	}
+	else
+		t = cb_pool<thread_cb>::create(nullptr, 0);
+
+	if (t == nullptr)
+		return nullptr;
+
+	t->id = id_thread;
+	t->name = name;
+	t->priority = priority;
+	t->attr_bits = attr_bits;
+	t->func = func;
+	t->argument = argument;
+	t->stack_size = stack_size;
+	t->detached = (attr_bits & osThreadJoinable) == 0;
+	t->state.store(osThreadReady, std::memory_order_relaxed);
+
+	pthread_attr_t pattr;
+	pthread_attr_init(&pattr);
+	if (stack_mem && stack_size >= OS_HOST_MIN_STACK_SIZE)
+		pthread_attr_setstack(&pattr, stack_mem, stack_size);
+	else
+		pthread_attr_setstacksize(&pattr, stack_size < OS_HOST_MIN_STACK_SIZE ? OS_HOST_MIN_STACK_SIZE : stack_size);
+	if (t->detached)
+		pthread_attr_setdetachstate(&pattr, PTHREAD_CREATE_DETACHED);
+
+	kernel_register(t);
+
+	// The thread lock is held until the handle is stored, a detached thread cannot exit before
+	t->lock.lock();
+	int err = pthread_create(&t->handle, &pattr, thread_entry, t);
+	t->lock.unlock();
+	pthread_attr_destroy(&pattr);
+
+	if (err != 0)
+	{
+		kernel_unregister(t);
+		cb_pool<thread_cb>::destroy(t);
+		return nullptr;
+	}
+
+	return t;
+}
+
+const char* osThreadGetName(osThreadId_t thread_id)
+{
+	thread_cb* t = cb_cast<thread_cb>(thread_id, id_thread);
+	return t ? t->name : nullptr;
+}
+
+osThreadId_t osThreadGetId(void)
+{
+	return thread_current();
+}
+
+osThreadState_t osThreadGetState(osThreadId_t thread_id)
+{
+	thread_cb* t = cb_cast<thread_cb>(thread_id, id_thread);
+	if (t == nullptr)
+		return osThreadError;
+
+	osThreadState_t state = static_cast<osThreadState_t>(t->state.load(std::memory_order_relaxed));
+	if (state == osThreadRunning && t != tls_thread)
+		return osThreadReady;
+
+	return state;
+}
+
+uint32_t osThreadGetStackSize(osThreadId_t thread_id)
+{
+	thread_cb* t = cb_cast<thread_cb>(thread_id, id_thread);
+	return t ? t->stack_size : 0;
+}
+
+uint32_t osThreadGetStackSpace(osThreadId_t thread_id)
+{
+	// Only measurable for the calling thread: the host has no stack watermark
+	thread_cb* t = cb_cast<thread_cb>(thread_id, id_thread);
+	if (t == nullptr || t != tls_thread || t->stack_size == 0)
+		return 0;
+
+	uintptr_t used = t->stack_top - reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+	return (used < t->stack_size) ? static_cast<uint32_t>(t->stack_size - used) : 0;
+}
+
+osStatus_t osThreadSetPriority(osThreadId_t thread_id, osPriority_t priority)
+{
+	thread_cb* t = cb_cast<thread_cb>(thread_id, id_thread);
+	if (t == nullptr || !priority_valid(priority))
+		return osErrorParameter;
+
+	if (t->state.load(std::memory_order_relaxed) == osThreadTerminated)
+		return osErrorResource;
+
+	t->priority = priority;
+	return osOK;
+}
+
+osPriority_t osThreadGetPriority(osThreadId_t thread_id)
+{
+	thread_cb* t = cb_cast<thread_cb>(thread_id, id_thread);
+	if (t == nullptr || t->state.load(std::memory_order_relaxed) == osThreadTerminated)
+		return osPriorityError;
+
+	return t->priority;
+}
+
+osStatus_t osThreadYield(void)
+{
+	thread_check_requests(thread_current());
+	sched_yield();
+	return osOK;
+}
+
+osStatus_t osThreadSuspend(osThreadId_t thread_id)
+{
+	thread_cb* t = cb_cast<thread_cb>(thread_id, id_thread);
+	if (t == nullptr)
+		return osErrorParameter;
+
+	if (t->state.load(std::memory_order_relaxed) == osThreadTerminated)
+		return osErrorResource;
+
+	// Another thread is suspended when it reaches its next kernel wait
+	t->request.fetch_or(request_suspend, std::memory_order_acq_rel);
+	if (t == tls_thread)
+		thread_park(t);
+
+	return osOK;
+}
+
+osStatus_t osThreadResume(osThreadId_t thread_id)
+{
+	thread_cb* t = cb_cast<thread_cb>(thread_id, id_thread);
+	if (t == nullptr)
+		return osErrorParameter;
+
+	if ((t->request.fetch_and(~request_suspend, std::memory_order_acq_rel) & request_suspend) == 0)
+		return osErrorResource;
+
+	t->park.fetch_add(1, std::memory_order_release);
+	futex_wake(t->park, 1);
+	return osOK;
+}
+
+osStatus_t osThreadDetach(osThreadId_t thread_id)
+{
+	thread_cb* t = cb_cast<thread_cb>(thread_id, id_thread);
+	if (t == nullptr)
+		return osErrorParameter;
+
+	t->lock.lock();
+	if (t->detached || t->joining)
+	{
+		t->lock.unlock();
+		return osErrorResource;
+	}
+
+	t->detached = true;
+	bool terminated = (t->state.load(std::memory_order_relaxed) == osThreadTerminated);
+	t->lock.unlock();
+
+	if (terminated)
+	{
+		pthread_join(t->handle, nullptr);
+		cb_pool<thread_cb>::destroy(t);
+	}
+	else
+		pthread_detach(t->handle);
+
+	return osOK;
+}
+
+osStatus_t osThreadJoin(osThreadId_t thread_id)
+{
+	thread_cb* t = cb_cast<thread_cb>(thread_id, id_thread);
+	if (t == nullptr)
+		return osErrorParameter;
+
+	thread_cb* self = thread_current();
+	if (t == self)
+		return osErrorResource;
+
+	t->lock.lock();
+	if (t->detached || t->joining)
+	{
+		t->lock.unlock();
+		return osErrorResource;
+	}
+
+	t->joining = true;
+	if (t->state.load(std::memory_order_relaxed) != osThreadTerminated)
+		thread_block(self, t->lock, t->join_queue, osWaitForever);
+	else
+		t->lock.unlock();
+
+	pthread_join(t->handle, nullptr);
+	cb_pool<thread_cb>::destroy(t);
+	return osOK;
+}
+
+void osThreadExit(void)
+{
+	thread_exit(thread_current());
+}
+
+osStatus_t osThreadTerminate(osThreadId_t thread_id)
+{
+	thread_cb* t = cb_cast<thread_cb>(thread_id, id_thread);
+	if (t == nullptr)
+		return osErrorParameter;
+
+	if (t == tls_thread)
+		thread_exit(t);
+
+	if (t->state.load(std::memory_order_relaxed) == osThreadTerminated)
+		return osErrorResource;
+
+	// The thread exits at its next kernel call: interrupt its current wait or suspension
+	t->request.fetch_or(request_terminate, std::memory_order_acq_rel);
+	uint32_t pending = wait_pending;
+	if (t->wait.compare_exchange_strong(pending, wait_interrupt, std::memory_order_acq_rel))
+		futex_wake(t->wait, 1);
+	osThreadResume(t);
+	return osOK;
+}
+
+uint32_t osThreadGetCount(void)
+{
+	return kernel.thread_count;
+}
+
+uint32_t osThreadEnumerate(osThreadId_t* thread_array, uint32_t array_items)
+{
+	if (thread_array == nullptr || array_items == 0)
+		return 0;
+
+	uint32_t count = 0;
+	kernel.lock.lock();
+	for (thread_cb* t = kernel.threads; t && count < array_items; t = t->thread_next)
+		thread_array[count++] = t;
+	kernel.lock.unlock();
+
+	return count;
+}
+
+//  ==== Thread Flags Functions ====
+
+uint32_t osThreadFlagsSet(osThreadId_t thread_id, uint32_t flags)
+{
+	thread_cb* t = cb_cast<thread_cb>(thread_id, id_thread);
+	if (t == nullptr || (flags & osFlagsError))
+		return osFlagsErrorParameter;
+
+	t->lock.lock();
+	t->thread_flags |= flags;
+	if (!t->flags_queue.empty())
+	{
+		uint32_t pattern = flags_check(t->thread_flags, t->wait_flags, t->wait_options);
+		if (pattern)
+			thread_wake(t->flags_queue, t, static_cast<int32_t>(pattern));
+	}
+	uint32_t result = t->thread_flags;
+	t->lock.unlock();
+
+	return result;
+}
+
+uint32_t osThreadFlagsClear(uint32_t flags)
+{
+	if (flags & osFlagsError)
+		return osFlagsErrorParameter;
+
+	thread_cb* self = thread_current();
+	self->lock.lock();
+	uint32_t result = self->thread_flags;
+	self->thread_flags &= ~flags;
+	self->lock.unlock();
+
+	return result;
+}
+
+uint32_t osThreadFlagsGet(void)
+{
+	thread_cb* self = thread_current();
+	self->lock.lock();
+	uint32_t result = self->thread_flags;
+	self->lock.unlock();
+
+	return result;
+}
+
+uint32_t osThreadFlagsWait(uint32_t flags, uint32_t options, uint32_t timeout)
+{
+	if (flags & osFlagsError)
+		return osFlagsErrorParameter;
+
+	thread_cb* self = thread_current();
+	self->lock.lock();
+	uint32_t pattern = flags_check(self->thread_flags, flags, options);
+	if (pattern)
+	{
+		self->lock.unlock();
+		return pattern;
+	}
+
+	if (timeout == 0)
+	{
+		self->lock.unlock();
+		return osFlagsErrorResource;
+	}
+
+	self->wait_flags = flags;
+	self->wait_options = options;
+	if (!thread_block(self, self->lock, self->flags_queue, timeout))
+		return osFlagsErrorTimeout;
+
+	return static_cast<uint32_t>(self->wait_result);
+}
+
+//  ==== Generic Wait Functions ====
+
+osStatus_t osDelay(uint32_t ticks)
+{
+	thread_cb* self = thread_current();
+	if (ticks == 0)
+	{
+		thread_check_requests(self);
+		return osOK;
+	}
+
+	self->lock.lock();
+	thread_block(self, self->lock, self->delay_queue, ticks);
+	return osOK;
+}
+
+osStatus_t osDelayUntil(uint32_t ticks)
+{
+	uint32_t delay = ticks - osKernelGetTickCount();
+	if (delay == 0 || delay > 0x7FFFFFFFU)
+		return osErrorParameter;
+
+	return osDelay(delay);
+}
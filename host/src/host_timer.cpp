@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "host_lib.h"
+
+namespace host
+{
+	struct timer_cb : object_cb
+	{
+		osTimerFunc_t func;
+		void* argument;
+		osTimerType_t type;
+		bool running;
+		uint32_t load;     // period in ticks
+		uint64_t deadline; // monotonic time of the next expiry
+		timer_cb* next;    // link in the list of running timers, sorted by deadline
+		timer_cb* prev;
+	};
+
+	namespace
+	{
+		// All the timers are served by one thread, started on the first osTimerNew
+		struct timer_service
+		{
+			futex_mutex lock;
+			timer_cb* head = nullptr;
+			timer_cb* current = nullptr;        // timer whose callback is running
+			osThreadId_t thread = nullptr;
+			std::atomic<uint32_t> seq {0};      // futex word of the timer thread, bumped on list changes
+			std::atomic<uint32_t> done {0};     // futex word bumped at the end of each callback
+		};
+
+		timer_service service;
+
+		void timer_unlink(timer_cb* t) noexcept
+		{
+			if (t->prev)
+				t->prev->next = t->next;
+			else
+				service.head = t->next;
+			if (t->next)
+				t->next->prev = t->prev;
+
+			t->next = nullptr;
+			t->prev = nullptr;
+			t->running = false;
+		}
+
+		void timer_link(timer_cb* t) noexcept
+		{
+			timer_cb* prev = nullptr;
+			timer_cb* next = service.head;
+			while (next && next->deadline <= t->deadline)
+			{
+				prev = next;
+				next = next->next;
+			}
+
+			t->prev = prev;
+			t->next = next;
+			if (next)
+				next->prev = t;
+			if (prev)
+				prev->next = t;
+			else
+				service.head = t;
+			t->running = true;
+		}
+
+		/// Wake the timer thread so that it recomputes its deadline. The service lock must be held.
+		inline void timer_notify() noexcept
+		{
+			service.seq.fetch_add(1, std::memory_order_release);
+			futex_wake(service.seq, 1);
+		}
+
+		__NO_RETURN void timer_thread(void*)
+		{
+			service.lock.lock();
+			for (;;)
+			{
+				uint64_t now = monotonic_ns();
+				timer_cb* t = service.head;
+				if (t && t->deadline <= now)
+				{
+					timer_unlink(t);
+					if (t->type == osTimerPeriodic)
+					{
+						t->deadline += static_cast<uint64_t>(t->load) * tick_nsec;
+						timer_link(t);
+					}
+
+					// The callback runs unlocked: it may start, stop or delete timers
+					service.current = t;
+					osTimerFunc_t func = t->func;
+					void* argument = t->argument;
+					service.lock.unlock();
+
+					func(argument);
+
+					service.lock.lock();
+					service.current = nullptr;
+					service.done.fetch_add(1, std::memory_order_release);
+					futex_wake(service.done, INT32_MAX);
+					continue;
+				}
+
+				uint32_t seq = service.seq.load(std::memory_order_acquire);
+				timespec abs_time;
+				const timespec* deadline = nullptr;
+				if (t)
+				{
+					abs_time = to_timespec(t->deadline);
+					deadline = &abs_time;
+				}
+				service.lock.unlock();
+
+				futex_wait(service.seq, seq, deadline);
+				service.lock.lock();
+			}
+		}
+
+		bool timer_service_start() noexcept
+		{
+			if (service.thread)
+				return true;
+
+			osThreadAttr_t attr = {};
+			attr.name = "osHostTimerThread";
+			attr.stack_size = OS_HOST_TIMER_THREAD_STACK_SIZE;
+			attr.priority = OS_HOST_TIMER_THREAD_PRIO;
+			service.thread = osThreadNew(timer_thread, nullptr, &attr);
+			return service.thread != nullptr;
+		}
+	} // namespace
+} // namespace host
+
+using namespace host;
+
+//  ==== Timer Management Functions ====
+
+osTimerId_t osTimerNew(osTimerFunc_t func, osTimerType_t type, void* argument, const osTimerAttr_t* attr)
+{
+	static_assert(sizeof(timer_cb) <= osHostTimerCbSize, "osHostTimerCbSize too small");
+
+	if (func == nullptr || (type != osTimerOnce && type != osTimerPeriodic))
+		return nullptr;
+
+	service.lock.lock();
+	bool started = timer_service_start();
+	service.lock.unlock();
+	if (!started)
+		return nullptr;
+
+	timer_cb* t = attr ? cb_pool<timer_cb>::create(attr->cb_mem, attr->cb_size) : cb_pool<timer_cb>::create(nullptr, 0);
+	if (t == nullptr)
+		return nullptr;
+
+	if (attr)
+		t->name = attr->name;
+
+	t->func = func;
+	t->argument = argument;
+	t->type = type;
+	t->id = id_timer;
+	return t;
+}
+
+const char* osTimerGetName(osTimerId_t timer_id)
+{
+	timer_cb* t = cb_cast<timer_cb>(timer_id, id_timer);
+	return t ? t->name : nullptr;
+}
+
+osStatus_t osTimerStart(osTimerId_t timer_id, uint32_t ticks)
+{
+	timer_cb* t = cb_cast<timer_cb>(timer_id, id_timer);
+	if (t == nullptr || ticks == 0)
+		return osErrorParameter;
+
+	service.lock.lock();
+	if (t->running)
+		timer_unlink(t);
+
+	t->load = ticks;
+	t->deadline = monotonic_ns() + static_cast<uint64_t>(ticks) * tick_nsec;
+	timer_link(t);
+	timer_notify();
+	service.lock.unlock();
+
+	return osOK;
+}
+
+osStatus_t osTimerStop(osTimerId_t timer_id)
+{
+	timer_cb* t = cb_cast<timer_cb>(timer_id, id_timer);
+	if (t == nullptr)
+		return osErrorParameter;
+
+	osStatus_t sta = osErrorResource;
+	service.lock.lock();
+	if (t->running)
+	{
+		timer_unlink(t);
+		timer_notify();
+		sta = osOK;
+	}
+	service.lock.unlock();
+
+	return sta;
+}
+
+uint32_t osTimerIsRunning(osTimerId_t timer_id)
+{
+	timer_cb* t = cb_cast<timer_cb>(timer_id, id_timer);
+	if (t == nullptr)
+		return 0;
+
+	service.lock.lock();
+	bool running = t->running;
+	service.lock.unlock();
+
+	return running ? 1U : 0U;
+}
+
+osStatus_t osTimerDelete(osTimerId_t timer_id)
+{
+	timer_cb* t = cb_cast<timer_cb>(timer_id, id_timer);
+	if (t == nullptr)
+		return osErrorParameter;
+
+	service.lock.lock();
+	t->id = id_invalid;
+	if (t->running)
+	{
+		timer_unlink(t);
+		timer_notify();
+	}
+
+	// Wait for the end of a running callback, unless the timer deletes itself
+	while (service.current == t && osThreadGetId() != service.thread)
+	{
+		uint32_t done = service.done.load(std::memory_order_acquire);
+		service.lock.unlock();
+		futex_wait(service.done, done, nullptr);
+		service.lock.lock();
+	}
+	service.lock.unlock();
+
+	cb_pool<timer_cb>::destroy(t);
+	return osOK;
+}
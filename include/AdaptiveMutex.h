@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CMSIS_ADAPTIVE_MUTEX_H_
+#define CMSIS_ADAPTIVE_MUTEX_H_
+
+#include "Mutex.h"
+#include "OS.h"
+#include <atomic>
+#include <cstdint>
+
+/// Default number of attempts on the lock word before blocking. Use 0 on a single core target: the owner can't
+/// release the lock while another thread spins.
+#ifndef CMSIS_ADAPTIVE_MUTEX_SPIN
+#define CMSIS_ADAPTIVE_MUTEX_SPIN 100
+#endif
+
+namespace cmsis
+{
+	// Mutex for short critical sections: an uncontended lock or unlock is a single atomic operation, a contended
+	// lock spins for a while before blocking. Blocked threads go through a priority inheritance mutex, which boosts
+	// the owner when it took the lock on the slow path. An owner that took the lock on the fast path isn't boosted.
+	// Not recursive, and can't be used from an ISR.
+	class adaptive_mutex
+	{
+	public:
+		typedef cmsis::mutex::native_handle_type native_handle_type;
+
+		/// How the lock has been taken, since the construction.
+		struct statistics
+		{
+			uint32_t fast; // at the first attempt
+			uint32_t spin; // while spinning
+			uint32_t slow; // after blocking
+		};
+
+		explicit adaptive_mutex(uint32_t spin = CMSIS_ADAPTIVE_MUTEX_SPIN);
+		~adaptive_mutex() = default;
+
+		void lock()
+		{
+			uint32_t expected = unlocked;
+			if (m_state.compare_exchange_strong(expected, locked, std::memory_order_acquire, std::memory_order_relaxed))
+				count(m_fast);
+			else
+				lock_contended();
+		}
+
+		void unlock()
+		{
+			if (m_slow_owner)
+				unlock_slow();
+			else if (m_state.exchange(unlocked, std::memory_order_acq_rel) == contended)
+				wake();
+		}
+
+		bool try_lock() noexcept
+		{
+			uint32_t expected = unlocked;
+			if (!m_state.compare_exchange_strong(
+					expected, locked, std::memory_order_acquire, std::memory_order_relaxed))
+				return false;
+
+			count(m_fast);
+			return true;
+		}
+
+		statistics stats() const noexcept
+		{
+			return {
+				m_fast.load(std::memory_order_relaxed),
+				m_spun.load(std::memory_order_relaxed),
+				m_slow.load(std::memory_order_relaxed)};
+		}
+
+		/// Handle of the kernel mutex used by the slow path.
+		native_handle_type native_handle() noexcept { return m_mutex.native_handle(); }
+
+		adaptive_mutex(const adaptive_mutex&) = delete;
+		adaptive_mutex& operator=(const adaptive_mutex&) = delete;
+
+	private:
+		enum lock_state : uint32_t
+		{
+			unlocked,
+			locked,
+			contended // locked, and a thread may be blocked
+		};
+
+		// Counters are only written by the owner: no read-modify-write is needed
+		static void count(std::atomic<uint32_t>& counter) noexcept
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+
+		void lock_contended();
+		void unlock_slow();
+		void wake() noexcept;
+
+	private:
+		std::atomic<uint32_t> m_state;
+		std::atomic<void*> m_waiter; // thread blocked on the lock word, it owns m_mutex
+		bool m_slow_owner;           // the owner holds m_mutex, written by the owner only
+		uint32_t m_spin;
+		cmsis::mutex m_mutex; // serializes the blocked threads, with priority inheritance
+		std::atomic<uint32_t> m_fast;
+		std::atomic<uint32_t> m_spun;
+		std::atomic<uint32_t> m_slow;
+	};
+} // namespace cmsis
+
+namespace sys
+{
+	using adaptive_mutex = cmsis::adaptive_mutex;
+}
+
+#endif // CMSIS_ADAPTIVE_MUTEX_H_
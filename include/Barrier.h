@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CPP_CMSIS_BARRIER_H_
+#define CPP_CMSIS_BARRIER_H_
+
+#include "Latch.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace cmsis
+{
+	namespace internal
+	{
+		struct empty_completion
+		{
+			void operator()() noexcept {}
+		};
+	} // namespace internal
+
+	// Reusable barrier: the arrivals are counted in an atomic, the last arriving thread runs the completion function,
+	// then wakes up the whole group with one set of an event flag.
+	template <class CompletionFunction = internal::empty_completion> class barrier
+	{
+	public:
+		class arrival_token
+		{
+		private:
+			friend class barrier;
+
+			explicit arrival_token(uint32_t phase) noexcept :
+				m_phase(phase)
+			{}
+
+			uint32_t m_phase;
+		};
+
+		static constexpr std::ptrdiff_t max() noexcept { return INT32_MAX; }
+
+		explicit barrier(std::ptrdiff_t expected, CompletionFunction f = CompletionFunction()) :
+			m_completion(std::move(f)),
+			m_expected(static_cast<int32_t>(expected)),
+			m_count(static_cast<int32_t>(expected)),
+			m_phase(0)
+		{}
+		~barrier() = default;
+
+		arrival_token arrive(std::ptrdiff_t update = 1)
+		{
+			// The phase can't change before this arrival
+			uint32_t phase = m_phase.load(std::memory_order_relaxed);
+			if (m_count.fetch_sub(static_cast<int32_t>(update), std::memory_order_acq_rel) == update)
+				complete(phase);
+
+			return arrival_token(phase);
+		}
+
+		void wait(arrival_token&& token) const
+		{
+			while (m_phase.load(std::memory_order_acquire) == token.m_phase)
+				m_event.wait(token.m_phase);
+		}
+
+		void arrive_and_wait() { wait(arrive()); }
+
+		void arrive_and_drop()
+		{
+			m_expected.fetch_sub(1, std::memory_order_relaxed);
+			arrive();
+		}
+
+		barrier(const barrier&) = delete;
+		barrier& operator=(const barrier&) = delete;
+
+	private:
+		void complete(uint32_t phase)
+		{
+			m_completion();
+			m_event.prepare(phase);
+			m_count.store(m_expected.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			m_phase.store(phase + 1, std::memory_order_release);
+			m_event.complete(phase);
+		}
+
+	private:
+		CompletionFunction m_completion;
+		std::atomic<int32_t> m_expected;
+		std::atomic<int32_t> m_count;
+		std::atomic<uint32_t> m_phase;
+		mutable internal::phase_event m_event;
+	};
+} // namespace cmsis
+
+namespace sys
+{
+	template <class CompletionFunction = cmsis::internal::empty_completion>
+	using barrier = cmsis::barrier<CompletionFunction>;
+}
+
+#if !defined(GLIBCXX_HAS_GTHREADS) && !defined(_GLIBCXX_HAS_GTHREADS)
+namespace std
+{
+	template <class CompletionFunction = cmsis::internal::empty_completion>
+	using barrier = cmsis::barrier<CompletionFunction>;
+} // namespace std
+#endif
+
+#endif // CPP_CMSIS_BARRIER_H_
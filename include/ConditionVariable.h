@@ -29,9 +29,7 @@
 #define CMSIS_CONDITION_VARIABLE_H_
 
 #include "Mutex.h"
-#include "Semaphore.h"
 #include <condition_variable>
-#include <list>
 
 namespace cmsis
 {
@@ -49,7 +47,10 @@ namespace cmsis
 		typedef void* native_handle_type;
 		typedef std::chrono::system_clock clock_t;
 
-		condition_variable() = default;
+		condition_variable() :
+			m_head(nullptr),
+			m_tail(nullptr)
+		{}
 		~condition_variable() = default;
 
 		void notify_one() noexcept;
@@ -90,7 +91,7 @@ namespace cmsis
 		template <class Rep, class Period>
 		cv_status wait_for(std::unique_lock<cmsis::mutex>& lock, const std::chrono::duration<Rep, Period>& rel_time)
 		{
-			return wait_for_usec(lock, std::chrono::duration_cast<std::chrono::microseconds>(rel_time));
+			return wait_for_usec(lock, internal::to_usec(rel_time));
 		}
 
 		template <class Rep, class Period, class Predicate>
@@ -115,11 +116,16 @@ namespace cmsis
 		condition_variable& operator=(const condition_variable&) = delete;
 
 	private:
+		struct waiter; // lives on the stack of the waiting thread
+
 		cv_status wait_for_usec(std::unique_lock<cmsis::mutex>& lock, std::chrono::microseconds usec);
+		cv_status wait_ticks(std::unique_lock<cmsis::mutex>& lock, uint32_t timeout);
+		void unlink(waiter* w) noexcept;
 
 	private:
 		cmsis::mutex m_mutex;
-		std::list<cmsis::binary_semaphore*> m_wait;
+		waiter* m_head; // intrusive FIFO of the waiting threads
+		waiter* m_tail;
 	};
 } // namespace cmsis
 
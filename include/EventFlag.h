@@ -28,6 +28,8 @@
 #ifndef CMSIS_EVENTFLAG_H_
 #define CMSIS_EVENTFLAG_H_
 
+#include "StaticStorage.h"
+#include "Timeout.h"
 #include "WaitFlag.h"
 #include <chrono>
 
@@ -68,7 +70,7 @@ namespace cmsis
 			const std::chrono::duration<Rep, Period>& rel_time,
 			mask_type& flagValue)
 		{
-			return wait_for_usec(mask, flg, rel_time, flagValue);
+			return wait_for_usec(mask, flg, internal::to_usec(rel_time), flagValue);
 		}
 
 		template <class Rep, class Period>
@@ -100,6 +102,9 @@ namespace cmsis
 
 		native_handle_type native_handle() noexcept { return m_id; }
 
+	protected:
+		event(mask_type mask, void* cb_mem, size_t cb_size);
+
 	private:
 		status wait_for_usec(mask_type mask, wait_flag flg, std::chrono::microseconds usec, mask_type& flagValue);
 
@@ -111,11 +116,28 @@ namespace cmsis
 	{
 		__x.swap(__y);
 	}
+
+#ifdef CMSIS_STATIC_STORAGE
+	// Event flags with the control block embedded in the object, which can't be moved
+	class static_event : private internal::static_storage<CMSIS_EVENT_FLAGS_CB_SIZE>, public event
+	{
+	public:
+		static_event(mask_type mask = 0) :
+			event(mask, cb_mem, sizeof(cb_mem))
+		{}
+
+		static_event(const static_event&) = delete;
+		static_event& operator=(const static_event&) = delete;
+	};
+#endif // CMSIS_STATIC_STORAGE
 } // namespace cmsis
 
 namespace sys
 {
 	using event = cmsis::event;
+#ifdef CMSIS_STATIC_STORAGE
+	using static_event = cmsis::static_event;
+#endif
 }
 
 #endif // CMSIS_EVENTFLAG_H_
@@ -0,0 +1,620 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CMSIS_FUTURE_H_
+#define CMSIS_FUTURE_H_
+
+#include "KernelLock.h"
+#include "Memory.h"
+#include "Thread.h"
+#include "Timeout.h"
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace cmsis
+{
+	template <class T> class future;
+	template <class T> class shared_future;
+	template <class T> class promise;
+
+	namespace internal
+	{
+		/// Throw a std::future_error, std::terminate without exceptions.
+		[[noreturn]] void throw_future_error(std::future_errc errc);
+
+		// Shared state of a promise and its futures, reference counted. The threads that wait for the result are
+		// woken up by a thread flag reserved by the library, the state doesn't hold any kernel object.
+		class base_future_state
+		{
+		public:
+			void add_ref() noexcept { m_refs.fetch_add(1, std::memory_order_relaxed); }
+			void release() noexcept
+			{
+				if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+					m_destroy(this);
+			}
+
+			bool is_ready() const noexcept { return m_status.load(std::memory_order_acquire) & ready; }
+
+			void wait() const;
+
+			template <class Rep, class Period>
+			std::future_status wait_for(const std::chrono::duration<Rep, Period>& rel_time) const
+			{
+				return wait_for_usec(to_usec(rel_time));
+			}
+
+			template <class Clock, class Duration>
+			std::future_status wait_until(const std::chrono::time_point<Clock, Duration>& abs_time) const
+			{
+				auto rel_time = abs_time - Clock::now();
+				if (rel_time < std::chrono::microseconds::zero())
+					return is_ready() ? std::future_status::ready : std::future_status::timeout;
+
+				return wait_for(rel_time);
+			}
+
+			/// Mark the state as given to a future, throws future_already_retrieved the second time.
+			void retrieve();
+
+#ifdef __cpp_exceptions
+			void set_exception(std::exception_ptr e);
+#endif
+
+			/// Store a broken_promise error if the state hasn't been satisfied.
+			void abandon() noexcept;
+
+			base_future_state(const base_future_state&) = delete;
+			base_future_state& operator=(const base_future_state&) = delete;
+
+		protected:
+			enum status_bits : uint32_t
+			{
+				claimed = 1,   // a result is being stored
+				ready = 2,     // the result is there
+				retrieved = 4, // the future has been taken
+				broken = 8     // the promise has been destroyed without a result
+			};
+
+			base_future_state(void (*destroy)(base_future_state*), void* pool) noexcept;
+			~base_future_state() = default;
+
+			/// Reserve the result, throws promise_already_satisfied if it is already there.
+			void claim();
+			void unclaim() noexcept { m_status.fetch_and(~static_cast<uint32_t>(claimed), std::memory_order_relaxed); }
+
+			/// Publish the result, and wake up the waiting threads.
+			void make_ready() noexcept;
+
+			/// Throw the stored exception, if any.
+			void check_result() const;
+
+			void* pool() const noexcept { return m_pool; }
+
+		private:
+			std::future_status wait_for_usec(std::chrono::microseconds usec) const;
+			bool wait_ready(uint32_t timeout) const;
+
+		private:
+			std::atomic<uint32_t> m_refs;
+			std::atomic<uint32_t> m_status;
+			mutable wait_list m_waiters;
+			void (*m_destroy)(base_future_state*);
+			void* m_pool; // memory_pool of the state, nullptr when it is on the heap
+#ifdef __cpp_exceptions
+			std::exception_ptr m_exception;
+#endif
+		};
+
+		/// Storage of the result of a future.
+		template <class T> class future_value
+		{
+		public:
+			typedef T result_type;
+			typedef const T& shared_result_type;
+
+			future_value() noexcept :
+				m_constructed(false)
+			{}
+			~future_value()
+			{
+				if (m_constructed)
+					get()->~T();
+			}
+
+			template <class... Args> void construct(Args&&... args)
+			{
+				::new (static_cast<void*>(&m_storage)) T(std::forward<Args>(args)...);
+				m_constructed = true;
+			}
+
+			result_type move() { return std::move(*get()); }
+			shared_result_type shared() const { return *get(); }
+
+		private:
+			T* get() noexcept { return reinterpret_cast<T*>(&m_storage); }
+			const T* get() const noexcept { return reinterpret_cast<const T*>(&m_storage); }
+
+			typename std::aligned_storage<sizeof(T), alignof(T)>::type m_storage;
+			bool m_constructed;
+		};
+
+		template <class T> class future_value<T&>
+		{
+		public:
+			typedef T& result_type;
+			typedef T& shared_result_type;
+
+			void construct(T& value) noexcept { m_value = &value; }
+
+			result_type move() const noexcept { return *m_value; }
+			shared_result_type shared() const noexcept { return *m_value; }
+
+		private:
+			T* m_value = nullptr;
+		};
+
+		template <> class future_value<void>
+		{
+		public:
+			typedef void result_type;
+			typedef void shared_result_type;
+
+			void construct() noexcept {}
+
+			void move() const noexcept {}
+			void shared() const noexcept {}
+		};
+
+		template <class T> class future_state : public base_future_state
+		{
+		public:
+			typedef memory_pool<future_state> pool_type;
+
+			explicit future_state(pool_type* pool = nullptr) noexcept :
+				base_future_state(&destroy, pool)
+			{}
+
+			template <class... Args> void set_value(Args&&... args)
+			{
+				claim();
+#ifdef __cpp_exceptions
+				try
+				{
+					m_value.construct(std::forward<Args>(args)...);
+				}
+				catch (...)
+				{
+					unclaim();
+					throw;
+				}
+#else
+				m_value.construct(std::forward<Args>(args)...);
+#endif
+				make_ready();
+			}
+
+			/// Result of future::get, once the state is ready.
+			typename future_value<T>::result_type move()
+			{
+				check_result();
+				return m_value.move();
+			}
+
+			/// Result of shared_future::get, once the state is ready.
+			typename future_value<T>::shared_result_type shared() const
+			{
+				check_result();
+				return m_value.shared();
+			}
+
+		private:
+			static void destroy(base_future_state* base) noexcept
+			{
+				future_state* state = static_cast<future_state*>(base);
+				pool_type* pool = static_cast<pool_type*>(state->pool());
+				if (pool == nullptr)
+				{
+					delete state;
+					return;
+				}
+
+				// The last reference can't throw: a block refused by the kernel is a corruption of the pool
+				state->~future_state();
+				bool freed = pool->try_deallocate(state);
+				assert(freed);
+				(void)freed;
+			}
+
+		private:
+			future_value<T> m_value;
+		};
+
+		/// Intrusive pointer to a shared state.
+		template <class T> class future_state_ptr
+		{
+		public:
+			future_state_ptr() noexcept :
+				m_state(nullptr)
+			{}
+			explicit future_state_ptr(future_state<T>* state) noexcept :
+				m_state(state)
+			{}
+			future_state_ptr(const future_state_ptr& other) noexcept :
+				m_state(other.m_state)
+			{
+				if (m_state)
+					m_state->add_ref();
+			}
+			future_state_ptr(future_state_ptr&& other) noexcept :
+				m_state(other.m_state)
+			{
+				other.m_state = nullptr;
+			}
+			~future_state_ptr()
+			{
+				if (m_state)
+					m_state->release();
+			}
+
+			future_state_ptr& operator=(future_state_ptr other) noexcept
+			{
+				std::swap(m_state, other.m_state);
+				return *this;
+			}
+
+			void swap(future_state_ptr& other) noexcept { std::swap(m_state, other.m_state); }
+
+			/// The state, throws no_state when there is none.
+			future_state<T>& operator*() const
+			{
+				if (m_state == nullptr)
+					throw_future_error(std::future_errc::no_state);
+				return *m_state;
+			}
+			future_state<T>* operator->() const { return &**this; }
+			explicit operator bool() const noexcept { return m_state != nullptr; }
+
+		private:
+			future_state<T>* m_state;
+		};
+
+		template <class R, bool = std::is_void<R>::value> struct task_result
+		{
+			template <class F, class... Args> static void run(promise<R>& p, F& f, Args&&... args)
+			{
+				p.set_value(f(std::forward<Args>(args)...));
+			}
+		};
+
+		template <class R> struct task_result<R, true>
+		{
+			template <class F, class... Args> static void run(promise<R>& p, F& f, Args&&... args)
+			{
+				f(std::forward<Args>(args)...);
+				p.set_value();
+			}
+		};
+
+		/// Call f(args...) and store its result, or its exception, in p.
+		template <class R, class F, class... Args> void set_task_result(promise<R>& p, F& f, Args&&... args)
+		{
+#ifdef __cpp_exceptions
+			try
+			{
+				task_result<R>::run(p, f, std::forward<Args>(args)...);
+			}
+			catch (...)
+			{
+				p.set_exception(std::current_exception());
+			}
+#else
+			task_result<R>::run(p, f, std::forward<Args>(args)...);
+#endif
+		}
+	} // namespace internal
+
+	// STL like implementation. The shared state is allocated on the heap, or from a memory_pool given to the
+	// constructor: sys::memory_pool<sys::promise<T>::state_type>. The pool must outlive the promise and its futures.
+	// set_value() can't be called from an ISR, it takes the kernel lock to wake up the waiting threads.
+	template <class T> class promise
+	{
+	public:
+		typedef internal::future_state<T> state_type;
+		typedef typename state_type::pool_type pool_type;
+
+		promise() :
+			m_state(new state_type())
+		{}
+		explicit promise(pool_type& pool) :
+			m_state(::new (static_cast<void*>(pool.allocate())) state_type(&pool))
+		{}
+		promise(promise&& other) noexcept = default;
+		~promise()
+		{
+			if (m_state)
+				m_state->abandon();
+		}
+
+		promise& operator=(promise&& other) noexcept
+		{
+			promise(std::move(other)).swap(*this);
+			return *this;
+		}
+
+		void swap(promise& other) noexcept { m_state.swap(other.m_state); }
+
+		future<T> get_future()
+		{
+			m_state->retrieve();
+			return future<T>(m_state);
+		}
+
+		template <class... Args> void set_value(Args&&... args) { m_state->set_value(std::forward<Args>(args)...); }
+
+#ifdef __cpp_exceptions
+		void set_exception(std::exception_ptr e) { m_state->set_exception(e); }
+#endif
+
+		promise(const promise&) = delete;
+		promise& operator=(const promise&) = delete;
+
+	private:
+		internal::future_state_ptr<T> m_state;
+	};
+
+	template <class T> class future
+	{
+	public:
+		future() noexcept = default;
+		future(future&& other) noexcept = default;
+		~future() = default;
+
+		future& operator=(future&& other) noexcept = default;
+
+		/// Wait for the result and take it, the future is no longer valid.
+		typename internal::future_value<T>::result_type get()
+		{
+			m_state->wait();
+			internal::future_state_ptr<T> state(std::move(m_state));
+			return state->move();
+		}
+
+		shared_future<T> share() noexcept { return shared_future<T>(std::move(*this)); }
+
+		bool valid() const noexcept { return static_cast<bool>(m_state); }
+
+		/// True when the result is there, get() doesn't wait.
+		bool is_ready() const { return m_state->is_ready(); }
+
+		void wait() const { m_state->wait(); }
+
+		template <class Rep, class Period>
+		std::future_status wait_for(const std::chrono::duration<Rep, Period>& rel_time) const
+		{
+			return m_state->wait_for(rel_time);
+		}
+
+		template <class Clock, class Duration>
+		std::future_status wait_until(const std::chrono::time_point<Clock, Duration>& abs_time) const
+		{
+			return m_state->wait_until(abs_time);
+		}
+
+		future(const future&) = delete;
+		future& operator=(const future&) = delete;
+
+	private:
+		friend class promise<T>;
+		friend class shared_future<T>;
+
+		explicit future(const internal::future_state_ptr<T>& state) noexcept :
+			m_state(state)
+		{}
+
+		internal::future_state_ptr<T> m_state;
+	};
+
+	template <class T> class shared_future
+	{
+	public:
+		shared_future() noexcept = default;
+		shared_future(const shared_future& other) noexcept = default;
+		shared_future(shared_future&& other) noexcept = default;
+		shared_future(future<T>&& other) noexcept :
+			m_state(std::move(other.m_state))
+		{}
+		~shared_future() = default;
+
+		shared_future& operator=(const shared_future& other) noexcept = default;
+		shared_future& operator=(shared_future&& other) noexcept = default;
+
+		/// Wait for the result, it stays in the shared state.
+		typename internal::future_value<T>::shared_result_type get() const
+		{
+			m_state->wait();
+			return m_state->shared();
+		}
+
+		bool valid() const noexcept { return static_cast<bool>(m_state); }
+		bool is_ready() const { return m_state->is_ready(); }
+
+		void wait() const { m_state->wait(); }
+
+		template <class Rep, class Period>
+		std::future_status wait_for(const std::chrono::duration<Rep, Period>& rel_time) const
+		{
+			return m_state->wait_for(rel_time);
+		}
+
+		template <class Clock, class Duration>
+		std::future_status wait_until(const std::chrono::time_point<Clock, Duration>& abs_time) const
+		{
+			return m_state->wait_until(abs_time);
+		}
+
+	private:
+		internal::future_state_ptr<T> m_state;
+	};
+
+	template <class Signature> class packaged_task;
+
+	// The task is kept in a std::function: a callable larger than its small buffer is copied on the heap.
+	template <class R, class... Args> class packaged_task<R(Args...)>
+	{
+	public:
+		typedef typename promise<R>::pool_type pool_type;
+
+		packaged_task() noexcept :
+			m_pool(nullptr)
+		{}
+
+		template <
+			class F,
+			class = typename std::enable_if<!std::is_same<typename std::decay<F>::type, packaged_task>::value>::type>
+		explicit packaged_task(F&& f) :
+			m_task(std::forward<F>(f)),
+			m_pool(nullptr)
+		{}
+
+		/// The shared states are allocated from pool.
+		template <class F>
+		packaged_task(F&& f, pool_type& pool) :
+			m_task(std::forward<F>(f)),
+			m_promise(pool),
+			m_pool(&pool)
+		{}
+
+		packaged_task(packaged_task&& other) noexcept = default;
+		~packaged_task() = default;
+
+		packaged_task& operator=(packaged_task&& other) noexcept = default;
+
+		void swap(packaged_task& other) noexcept
+		{
+			std::swap(m_task, other.m_task);
+			m_promise.swap(other.m_promise);
+			std::swap(m_pool, other.m_pool);
+		}
+
+		bool valid() const noexcept { return static_cast<bool>(m_task); }
+
+		future<R> get_future() { return m_promise.get_future(); }
+
+		void operator()(Args... args)
+		{
+			if (!m_task)
+				internal::throw_future_error(std::future_errc::no_state);
+
+			internal::set_task_result(m_promise, m_task, std::forward<Args>(args)...);
+		}
+
+		/// New shared state, to run the task again.
+		void reset()
+		{
+			if (!m_task)
+				internal::throw_future_error(std::future_errc::no_state);
+
+			m_promise = m_pool ? promise<R>(*m_pool) : promise<R>();
+		}
+
+		packaged_task(const packaged_task&) = delete;
+		packaged_task& operator=(const packaged_task&) = delete;
+
+	private:
+		std::function<R(Args...)> m_task;
+		promise<R> m_promise;
+		pool_type* m_pool;
+	};
+
+	namespace internal
+	{
+		// Result of the copy of f called with the copies of args, as in async_at (std::result_of is gone in C++20)
+		template <class F, class... Args>
+		using async_result_t =
+			decltype(std::declval<typename std::decay<F>::type&>()(std::declval<typename std::decay<Args>::type>()...));
+
+		template <class R, class F, class... Args>
+		future<R> async_at(promise<R>&& p, const thread::attributes& attr, F&& f, Args&&... args)
+		{
+			future<R> result = p.get_future();
+			thread t(
+				attr,
+				[](promise<R>& task_promise,
+				   typename std::decay<F>::type& task,
+				   typename std::decay<Args>::type&... task_args) {
+					// Called once: the copies of the arguments are given as rvalues, like std::async
+					set_task_result(task_promise, task, std::move(task_args)...);
+				},
+				std::move(p),
+				std::forward<F>(f),
+				std::forward<Args>(args)...);
+			t.detach();
+			return result;
+		}
+	} // namespace internal
+
+	/// Run f(args...) in a new detached thread. Unlike std::async, the destructor of the future doesn't wait for the
+	/// end of the thread; f and args are copied in the thread.
+	template <class F, class... Args>
+	future<internal::async_result_t<F, Args...>> async(const thread::attributes& attr, F&& f, Args&&... args)
+	{
+		typedef internal::async_result_t<F, Args...> R;
+		return internal::async_at(promise<R>(), attr, std::forward<F>(f), std::forward<Args>(args)...);
+	}
+
+	/// async with the shared state allocated from pool.
+	template <class F, class... Args>
+	future<internal::async_result_t<F, Args...>> async(
+		typename promise<internal::async_result_t<F, Args...>>::pool_type& pool,
+		const thread::attributes& attr,
+		F&& f,
+		Args&&... args)
+	{
+		typedef internal::async_result_t<F, Args...> R;
+		return internal::async_at(promise<R>(pool), attr, std::forward<F>(f), std::forward<Args>(args)...);
+	}
+} // namespace cmsis
+
+namespace sys
+{
+	template <class T> using future = cmsis::future<T>;
+	template <class T> using shared_future = cmsis::shared_future<T>;
+	template <class T> using promise = cmsis::promise<T>;
+	template <class Signature> using packaged_task = cmsis::packaged_task<Signature>;
+	using cmsis::async;
+} // namespace sys
+
+#endif // CMSIS_FUTURE_H_
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CPP_CMSIS_KERNEL_LOCK_H_
+#define CPP_CMSIS_KERNEL_LOCK_H_
+
+#include <cstdint>
+
+namespace cmsis
+{
+	namespace internal
+	{
+		// Scoped lock of the kernel, for the short critical sections of the library. Unlike dispatch, it doesn't
+		// throw: before the start of the kernel, there is only one thread and nothing is locked.
+		class kernel_lock
+		{
+		public:
+			kernel_lock() noexcept;
+			~kernel_lock();
+
+			kernel_lock(const kernel_lock&) = delete;
+			kernel_lock& operator=(const kernel_lock&) = delete;
+
+		private:
+			int32_t m_lock;
+		};
+
+		// A thread blocked on a wait_list, on its own stack
+		struct list_waiter
+		{
+			list_waiter* next;
+			void* thread;
+			bool woken;
+		};
+
+		// Threads waiting for an event, protected by the kernel lock. A waiter checks the event and pushes itself
+		// under the lock, then blocks on a thread flag reserved by the library: notify_all() wakes up the whole list.
+		class wait_list
+		{
+		public:
+			constexpr wait_list() noexcept :
+				m_head(nullptr)
+			{}
+
+			/// Queue the calling thread, the caller holds the kernel lock.
+			void push(list_waiter& self) noexcept;
+
+			/// Wake up all the waiters with the thread flag, the caller holds the kernel lock.
+			void notify_all(uint32_t flag) noexcept;
+
+			/// Block a queued thread until notify_all(), for timeout kernel ticks at most (osWaitForever). A flag left
+			/// by a previous wake-up only costs another check. Returns false on timeout, the thread has left the
+			/// list. Throws std::system_error, named what, on any other error.
+			bool wait(list_waiter& self, uint32_t flag, uint32_t timeout, const char* what);
+
+			wait_list(const wait_list&) = delete;
+			wait_list& operator=(const wait_list&) = delete;
+
+		private:
+			void remove(list_waiter& self) noexcept;
+
+		private:
+			list_waiter* m_head;
+		};
+	} // namespace internal
+} // namespace cmsis
+
+#endif // CPP_CMSIS_KERNEL_LOCK_H_
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CPP_CMSIS_LATCH_H_
+#define CPP_CMSIS_LATCH_H_
+
+#include "EventFlag.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace cmsis
+{
+	namespace internal
+	{
+		// End of phase broadcast: the phases alternate between two event flags, so the whole group is woken up by a
+		// single set of the flag, which is left set for the late waiters. The flag of the next phase is cleared before:
+		// all the waiters of its previous use have returned, since they took part in the phase that ends.
+		class phase_event
+		{
+		public:
+			phase_event();
+			~phase_event() = default;
+
+			/// Wait for the end of the phase, may return spuriously.
+			void wait(uint32_t phase);
+
+			/// Clear the flag of the next phase, before the publication of the end of the phase.
+			void prepare(uint32_t phase);
+
+			/// Wake up all the threads waiting for the end of the phase.
+			void complete(uint32_t phase);
+
+			phase_event(const phase_event&) = delete;
+			phase_event& operator=(const phase_event&) = delete;
+
+		private:
+			static event::mask_type flag(uint32_t phase) noexcept { return 1U << (phase & 1); }
+
+		private:
+			event m_event;
+		};
+	} // namespace internal
+
+	// Single use barrier: the counter is an atomic, the kernel is only called by the waiters which find it not null,
+	// and once by the thread which decrements it to zero.
+	class latch
+	{
+	public:
+		static constexpr std::ptrdiff_t max() noexcept { return INT32_MAX; }
+
+		explicit latch(std::ptrdiff_t expected) :
+			m_count(static_cast<int32_t>(expected))
+		{}
+		~latch() = default;
+
+		void count_down(std::ptrdiff_t update = 1)
+		{
+			if (m_count.fetch_sub(static_cast<int32_t>(update), std::memory_order_acq_rel) == update)
+				m_event.complete(0);
+		}
+
+		bool try_wait() const noexcept { return m_count.load(std::memory_order_acquire) == 0; }
+
+		void wait() const
+		{
+			while (!try_wait())
+				m_event.wait(0);
+		}
+
+		void arrive_and_wait(std::ptrdiff_t update = 1)
+		{
+			count_down(update);
+			wait();
+		}
+
+		latch(const latch&) = delete;
+		latch& operator=(const latch&) = delete;
+
+	private:
+		std::atomic<int32_t> m_count;
+		mutable internal::phase_event m_event;
+	};
+} // namespace cmsis
+
+namespace sys
+{
+	using latch = cmsis::latch;
+}
+
+#if !defined(GLIBCXX_HAS_GTHREADS) && !defined(_GLIBCXX_HAS_GTHREADS)
+namespace std
+{
+	using latch = cmsis::latch;
+} // namespace std
+#endif
+
+#endif // CPP_CMSIS_LATCH_H_
@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CMSIS_MAILBOX_H_
+#define CMSIS_MAILBOX_H_
+
+#include "Memory.h"
+#include "MessageQueue.h"
+#include "OSException.h"
+#include "cmsis_os2.h"
+#include <cassert>
+#include <chrono>
+#include <memory>
+
+namespace cmsis
+{
+	template <class T> class mailbox;
+
+	// Deleter of the mail of a mailbox: destroys the message and gives its slot back.
+	template <class T> class mailbox_delete
+	{
+	public:
+		mailbox_delete() noexcept :
+			m_mailbox(nullptr)
+		{}
+		explicit mailbox_delete(mailbox<T>& mbox) noexcept :
+			m_mailbox(&mbox)
+		{}
+
+		void operator()(T* p) const noexcept
+		{
+			if (p)
+				m_mailbox->release(p);
+		}
+
+		mailbox<T>* get_mailbox() const noexcept { return m_mailbox; }
+
+	private:
+		mailbox<T>* m_mailbox;
+	};
+
+	// Queue of messages built in the slots of a memory pool: a producer loans a slot, builds its message in place,
+	// and commits it; the consumer receives the same slot, which goes back to the pool with the destruction of the
+	// mail. Only a pointer goes through the kernel queue, whatever the size of T: there is no copy and no heap.
+	// The queue has room for all the slots, so a commit never waits, and can be done from an ISR like try_loan()
+	// and try_receive(). The mails must be released before the destruction of the mailbox.
+	template <class T> class mailbox : private internal::message_queue_impl, private internal::base_memory_pool
+	{
+	public:
+		typedef T element_type;
+		typedef mailbox_delete<T> deleter_type;
+		typedef std::unique_ptr<T, deleter_type> mail_ptr;
+
+		explicit mailbox(size_t count) :
+			internal::message_queue_impl(count, sizeof(T*)),
+			internal::base_memory_pool(count, sizeof(T))
+		{}
+		~mailbox() noexcept(false) { clear(); }
+
+		/// Build a message in a free slot, waits for one.
+		template <class... Args> mail_ptr loan(Args&&... args)
+		{
+			return build(internal::base_memory_pool::allocate(1), std::forward<Args>(args)...);
+		}
+
+		/// Build a message in a free slot without waiting: the mail is empty when there is none.
+		template <class... Args> mail_ptr try_loan(Args&&... args)
+		{
+			return build(internal::base_memory_pool::try_allocate(), std::forward<Args>(args)...);
+		}
+
+		/// Build a message in a free slot, waiting for rel_time at most: the mail is empty on timeout.
+		template <class Rep, class Period, class... Args>
+		mail_ptr loan_for(const std::chrono::duration<Rep, Period>& rel_time, Args&&... args)
+		{
+			return build(internal::base_memory_pool::allocate_for(rel_time), std::forward<Args>(args)...);
+		}
+
+		/// Queue a loaned mail, never waits. The messages of higher priority are received first.
+		void commit(mail_ptr&& mail, uint8_t priority = 0)
+		{
+			if (!mail || mail.get_deleter().get_mailbox() != this)
+#ifdef __cpp_exceptions
+				throw std::system_error(osErrorParameter, os_category(), "mailbox: invalid mail");
+#else
+				std::terminate();
+#endif
+
+			T* p = mail.get();
+			if (!internal::message_queue_impl::try_put(&p, priority))
+#ifdef __cpp_exceptions
+				throw std::system_error(osErrorResource, os_category(), "mailbox: queue full");
+#else
+				std::terminate();
+#endif
+			mail.release();
+		}
+
+		/// Receive a mail, waits for one.
+		mail_ptr receive()
+		{
+			T* p = nullptr;
+			internal::message_queue_impl::get(&p);
+			return mail_ptr(p, deleter_type(*this));
+		}
+
+		/// Receive a mail without waiting: the mail is empty when there is none.
+		mail_ptr try_receive()
+		{
+			T* p = nullptr;
+			internal::message_queue_impl::try_get(&p);
+			return mail_ptr(p, deleter_type(*this));
+		}
+
+		/// Receive a mail, waiting for rel_time at most: the mail is empty on timeout.
+		template <class Rep, class Period> mail_ptr receive_for(const std::chrono::duration<Rep, Period>& rel_time)
+		{
+			T* p = nullptr;
+			if (internal::message_queue_impl::get(&p, internal::to_usec(rel_time)) != mq_status::no_timeout)
+				p = nullptr;
+			return mail_ptr(p, deleter_type(*this));
+		}
+
+		/// Number of committed mails not received yet.
+		size_t size() const { return internal::message_queue_impl::size(); }
+		bool empty() const { return size() == 0; }
+
+		/// Number of slots.
+		size_t capacity() const { return internal::base_memory_pool::max_size(); }
+
+		/// Release the committed mails not received yet.
+		void clear()
+		{
+			T* p = nullptr;
+			while (internal::message_queue_impl::try_get(&p))
+				release(p);
+		}
+
+		mailbox(const mailbox&) = delete;
+		mailbox& operator=(const mailbox&) = delete;
+
+	protected:
+		mailbox(
+			size_t count,
+			void* mq_cb,
+			size_t mq_cb_size,
+			void* mq_mem,
+			size_t mq_size,
+			void* mp_cb,
+			size_t mp_cb_size,
+			void* mp_mem,
+			size_t mp_size) :
+			internal::message_queue_impl(count, sizeof(T*), mq_cb, mq_cb_size, mq_mem, mq_size),
+			internal::base_memory_pool(count, sizeof(T), mp_cb, mp_cb_size, mp_mem, mp_size)
+		{}
+
+	private:
+		friend class mailbox_delete<T>;
+
+		template <class... Args> mail_ptr build(void* p, Args&&... args)
+		{
+			if (!p)
+				return mail_ptr(nullptr, deleter_type(*this));
+
+#ifdef __cpp_exceptions
+			try
+			{
+				::new (p) T(std::forward<Args>(args)...);
+			}
+			catch (...)
+			{
+				bool freed = internal::base_memory_pool::try_deallocate(p);
+				assert(freed);
+				(void)freed;
+				throw;
+			}
+#else
+			::new (p) T(std::forward<Args>(args)...);
+#endif
+			return mail_ptr(static_cast<T*>(p), deleter_type(*this));
+		}
+
+		/// Destroy the message and free its slot, without throwing: called by the deleter.
+		void release(T* p) noexcept
+		{
+			p->~T();
+			bool freed = internal::base_memory_pool::try_deallocate(p);
+			assert(freed);
+			(void)freed;
+		}
+	};
+
+#ifdef CMSIS_STATIC_STORAGE
+	namespace internal
+	{
+		// Memory of the queue and of the pool of a static_mailbox
+		template <class T, size_t N> struct mailbox_storage
+		{
+			static_storage<CMSIS_MESSAGE_QUEUE_CB_SIZE, CMSIS_MESSAGE_QUEUE_MEM_SIZE(N, sizeof(T*))> queue;
+			static_storage<CMSIS_MEMORY_POOL_CB_SIZE, CMSIS_MEMORY_POOL_MEM_SIZE(N, sizeof(T))> pool;
+		};
+	} // namespace internal
+
+	// Mailbox of N slots, with the control blocks, the queue and the slots embedded in the object.
+	// It can't be moved.
+	template <class T, size_t N>
+	class static_mailbox : private internal::mailbox_storage<T, N>, public mailbox<T>
+	{
+	public:
+		static_mailbox() :
+			mailbox<T>(
+				N,
+				this->queue.cb_mem,
+				sizeof(this->queue.cb_mem),
+				this->queue.mem,
+				sizeof(this->queue.mem),
+				this->pool.cb_mem,
+				sizeof(this->pool.cb_mem),
+				this->pool.mem,
+				sizeof(this->pool.mem))
+		{}
+
+		static_mailbox(const static_mailbox&) = delete;
+		static_mailbox& operator=(const static_mailbox&) = delete;
+	};
+#endif // CMSIS_STATIC_STORAGE
+} // namespace cmsis
+
+namespace sys
+{
+	template <class T> using mailbox = cmsis::mailbox<T>;
+	template <class T> using mailbox_delete = cmsis::mailbox_delete<T>;
+#ifdef CMSIS_STATIC_STORAGE
+	template <class T, size_t N> using static_mailbox = cmsis::static_mailbox<T, N>;
+#endif
+} // namespace sys
+
+#endif // CMSIS_MAILBOX_H_
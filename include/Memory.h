@@ -28,7 +28,17 @@
 #ifndef CMSIS_MEMORY_H_
 #define CMSIS_MEMORY_H_
 
+#include "StaticStorage.h"
+#include "Timeout.h"
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <mutex>
+
+/// Default number of blocks of a magazine of memory_pool_cache.
+#ifndef CMSIS_MEMORY_POOL_MAGAZINE_SIZE
+#define CMSIS_MEMORY_POOL_MAGAZINE_SIZE 16
+#endif
 
 namespace cmsis
 {
@@ -39,14 +49,39 @@ namespace cmsis
 		protected:
 			typedef void* native_handle_type;
 
-			base_memory_pool(size_t count, size_t n);
+			base_memory_pool(
+				size_t count,
+				size_t n,
+				void* cb_mem = nullptr,
+				size_t cb_size = 0,
+				void* mp_mem = nullptr,
+				size_t mp_size = 0);
 			base_memory_pool(base_memory_pool&& other);
 			~base_memory_pool() noexcept(false);
 
 			base_memory_pool& operator=(base_memory_pool&& other);
 
 			void* allocate(size_t n);
+			void* try_allocate() noexcept; // nullptr when the pool is empty, callable from an ISR
+			size_t try_allocate(void** blocks, size_t n) noexcept; // up to n blocks, under one kernel lock
+
+			template <class Rep, class Period> void* allocate_for(const std::chrono::duration<Rep, Period>& rel_time)
+			{
+				return allocate_for_usec(to_usec(rel_time));
+			}
+
+			template <class Clock, class Duration>
+			void* allocate_until(const std::chrono::time_point<Clock, Duration>& abs_time)
+			{
+				auto rel_time = abs_time - Clock::now();
+				if (rel_time < std::chrono::microseconds::zero())
+					return try_allocate();
+
+				return allocate_for(rel_time);
+			}
+
 			void deallocate(void* p);
+			bool try_deallocate(void* p) noexcept; // false when the kernel refuses the block, callable from an ISR
 			size_t max_size() const noexcept;
 			size_t size() const noexcept;
 
@@ -55,11 +90,47 @@ namespace cmsis
 			base_memory_pool(const base_memory_pool&) = delete;
 			base_memory_pool& operator=(const base_memory_pool&) = delete;
 
+		private:
+			void* allocate_for_usec(std::chrono::microseconds usec);
+
 		private:
 			native_handle_type m_id;
 		};
+
+		// Part of memory_pool_cache which doesn't depend on the type. The caches are linked in a list, under the
+		// kernel lock: a cache which finds its pool empty takes the blocks of another cache of the same pool.
+		class base_pool_cache
+		{
+		public:
+			/// Held by the owner thread for each operation on its blocks: spins while another cache takes them.
+			void lock() const noexcept;
+			void unlock() const noexcept { m_busy.store(false, std::memory_order_release); }
+
+			base_pool_cache(const base_pool_cache&) = delete;
+			base_pool_cache& operator=(const base_pool_cache&) = delete;
+
+		protected:
+			base_pool_cache(const void* pool, void** blocks, size_t capacity) noexcept;
+			~base_pool_cache();
+
+			/// Move half the blocks of another cache of the pool into this one, which is locked by its owner.
+			/// Returns the number of blocks moved, 0 when the other caches are empty or in use.
+			size_t steal() noexcept;
+
+		protected:
+			void** m_blocks;
+			size_t m_count;
+
+		private:
+			const void* m_pool;
+			size_t m_capacity;
+			base_pool_cache* m_next;
+			mutable std::atomic<bool> m_busy;
+		};
 	} // namespace internal
 
+	template <class T, size_t MagazineSize> class memory_pool_cache;
+
 	template <class T> class memory_pool_delete;
 
 	// This class satisfies allocator completeness requirements.
@@ -96,7 +167,27 @@ namespace cmsis
 		const_pointer address(const_reference x) const noexcept { return std::addressof(x); }
 
 		pointer allocate(size_type n = 1, const void* = 0) { return static_cast<pointer>(Base::allocate(n)); }
+
+		/// Allocate a block without waiting, nullptr when the pool is empty. Can be called from an ISR.
+		pointer try_allocate() noexcept { return static_cast<pointer>(Base::try_allocate()); }
+
+		/// Allocate a block, waiting for rel_time at most (rounded up to the kernel ticks). nullptr on timeout.
+		template <class Rep, class Period> pointer allocate_for(const std::chrono::duration<Rep, Period>& rel_time)
+		{
+			return static_cast<pointer>(Base::allocate_for(rel_time));
+		}
+
+		/// Allocate a block, waiting until abs_time at most. nullptr on timeout.
+		template <class Clock, class Duration>
+		pointer allocate_until(const std::chrono::time_point<Clock, Duration>& abs_time)
+		{
+			return static_cast<pointer>(Base::allocate_until(abs_time));
+		}
 		void deallocate(pointer p, size_type) { Base::deallocate(p); }
+
+		/// Free a block without throwing, for the paths which can't throw (destructors): false when the kernel
+		/// refuses the block, which isn't a block of this pool. Can be called from an ISR.
+		bool try_deallocate(pointer p) noexcept { return Base::try_deallocate(p); }
 		size_type max_size() const noexcept { return Base::max_size(); }
 		size_type size() const noexcept { return Base::size(); }
 
@@ -111,22 +202,185 @@ namespace cmsis
 
 		template <class... Args> std::unique_ptr<T, deleter_type> make_unique(Args&&... args)
 		{
-			std::unique_ptr<T, deleter_type> ptr(allocate(), get_deleter());
-			construct(ptr.get(), std::forward<Args>(args)...);
-			return ptr;
+			return make_unique_at(allocate(), std::forward<Args>(args)...);
 		}
 
 		template <class... Args> std::shared_ptr<T> make_shared(Args&&... args)
 		{
-			std::shared_ptr<T> ptr(allocate(), get_deleter());
-			construct(ptr.get(), std::forward<Args>(args)...);
-			return ptr;
+			return make_shared_at(allocate(), std::forward<Args>(args)...);
+		}
+
+		/// make_unique without waiting: the pointer is empty when the pool is empty.
+		template <class... Args> std::unique_ptr<T, deleter_type> try_make_unique(Args&&... args)
+		{
+			return make_unique_at(try_allocate(), std::forward<Args>(args)...);
+		}
+
+		/// make_shared without waiting: the pointer is empty when the pool is empty.
+		template <class... Args> std::shared_ptr<T> try_make_shared(Args&&... args)
+		{
+			return make_shared_at(try_allocate(), std::forward<Args>(args)...);
 		}
 
 		native_handle_type native_handle() noexcept { return Base::native_handle(); }
 
 		memory_pool(const memory_pool&) = delete;
 		memory_pool& operator=(const memory_pool&) = delete;
+
+	protected:
+		memory_pool(size_type count, void* cb_mem, size_t cb_size, void* mp_mem, size_t mp_size) :
+			Base(count, sizeof(T), cb_mem, cb_size, mp_mem, mp_size)
+		{}
+
+	private:
+		template <class, size_t> friend class memory_pool_cache; // takes a magazine with Base::try_allocate
+
+		/// Build the object in the block p, the block is released if the constructor throws.
+		template <class... Args> pointer construct_at(pointer p, Args&&... args)
+		{
+			if (p)
+			{
+#ifdef __cpp_exceptions
+				try
+				{
+					construct(p, std::forward<Args>(args)...);
+				}
+				catch (...)
+				{
+					deallocate(p, 1);
+					throw;
+				}
+#else
+				construct(p, std::forward<Args>(args)...);
+#endif
+			}
+			return p;
+		}
+
+		template <class... Args> std::unique_ptr<T, deleter_type> make_unique_at(pointer p, Args&&... args)
+		{
+			return std::unique_ptr<T, deleter_type>(construct_at(p, std::forward<Args>(args)...), get_deleter());
+		}
+
+		template <class... Args> std::shared_ptr<T> make_shared_at(pointer p, Args&&... args)
+		{
+			if (!construct_at(p, std::forward<Args>(args)...))
+				return std::shared_ptr<T>();
+
+			return std::shared_ptr<T>(p, get_deleter());
+		}
+	};
+
+#ifdef CMSIS_STATIC_STORAGE
+	// Memory pool of N blocks, with the control block and the blocks embedded in the object.
+	// It can't be moved.
+	template <class T, size_t N>
+	class static_memory_pool
+		: private internal::static_storage<CMSIS_MEMORY_POOL_CB_SIZE, CMSIS_MEMORY_POOL_MEM_SIZE(N, sizeof(T))>,
+		  public memory_pool<T>
+	{
+	public:
+		static_memory_pool() :
+			memory_pool<T>(N, this->cb_mem, sizeof(this->cb_mem), this->mem, sizeof(this->mem))
+		{}
+
+		static_memory_pool(const static_memory_pool&) = delete;
+		static_memory_pool& operator=(const static_memory_pool&) = delete;
+	};
+#endif // CMSIS_STATIC_STORAGE
+
+	// Cache of blocks of a memory pool, owned by one thread (a local object of the thread function). The blocks freed
+	// by the thread are kept for its next allocations, without a call to the kernel. The cache holds up to two
+	// magazines of MagazineSize blocks: an empty cache is refilled with a magazine taken from the pool under one
+	// kernel lock, a full one gives a magazine back, so a thread that alternates allocations and releases stays in
+	// the cache. A block can be freed in the cache of another thread, or directly in the pool. The remaining blocks
+	// go back to the pool with the destruction of the cache, which must precede the one of the pool. Not usable
+	// from an ISR.
+	// When the pool is empty, allocate() takes half the blocks of another cache of the pool, and polls the pool and
+	// the other caches every millisecond while they are all empty. A thread blocked in allocate() of the pool itself
+	// only gets the blocks freed to the pool: call flush() on the idle caches to give their blocks back.
+	template <class T, size_t MagazineSize = CMSIS_MEMORY_POOL_MAGAZINE_SIZE>
+	class memory_pool_cache : private internal::base_pool_cache
+	{
+		static_assert(MagazineSize != 0, "empty magazine");
+
+	public:
+		typedef size_t size_type;
+		typedef T* pointer;
+		typedef T value_type;
+
+		explicit memory_pool_cache(memory_pool<T>& mempool) noexcept :
+			internal::base_pool_cache(&mempool, m_storage, capacity()),
+			m_mempool(mempool)
+		{}
+		~memory_pool_cache() noexcept(false) { flush(); }
+
+		/// Allocate one block, from the cache first. Waits for a block when the pool and the caches are empty.
+		pointer allocate(size_type n = 1)
+		{
+			if (n != 1)
+				return m_mempool.allocate(n);
+
+			for (;;)
+			{
+				{
+					std::lock_guard<internal::base_pool_cache> lock(*this);
+					if (m_count != 0 || refill() != 0 || steal() != 0)
+						return static_cast<pointer>(m_blocks[--m_count]);
+				}
+
+				pointer p = m_mempool.allocate_for(std::chrono::milliseconds(1));
+				if (p)
+					return p;
+			}
+		}
+
+		/// Keep the block in the cache, a magazine goes back to the pool when the cache is full.
+		void deallocate(pointer p, size_type)
+		{
+			std::lock_guard<internal::base_pool_cache> lock(*this);
+			if (m_count == capacity())
+				release(MagazineSize);
+
+			m_blocks[m_count++] = p;
+		}
+
+		/// Give all the blocks of the cache back to the pool, for the threads waiting for a block of the pool.
+		void flush()
+		{
+			std::lock_guard<internal::base_pool_cache> lock(*this);
+			release(m_count);
+		}
+
+		/// Number of blocks in the cache.
+		size_type size() const noexcept
+		{
+			std::lock_guard<const internal::base_pool_cache> lock(*this);
+			return m_count;
+		}
+		static constexpr size_type capacity() noexcept { return 2 * MagazineSize; }
+
+		memory_pool_cache(const memory_pool_cache&) = delete;
+		memory_pool_cache& operator=(const memory_pool_cache&) = delete;
+
+	private:
+		/// Take up to a magazine of blocks from the pool, without waiting.
+		size_type refill() noexcept
+		{
+			if (m_count < MagazineSize)
+				m_count += m_mempool.Base::try_allocate(m_blocks + m_count, MagazineSize - m_count);
+			return m_count;
+		}
+
+		void release(size_type n)
+		{
+			while (n--)
+				m_mempool.deallocate(static_cast<pointer>(m_blocks[--m_count]), 1);
+		}
+
+	private:
+		memory_pool<T>& m_mempool;
+		void* m_storage[2 * MagazineSize];
 	};
 
 	template <class T> class memory_pool_delete
@@ -180,6 +434,11 @@ namespace sys
 {
 	template <class T> using memory_pool = cmsis::memory_pool<T>;
 	template <class T> using memory_pool_delete = cmsis::memory_pool_delete<T>;
+	template <class T, size_t MagazineSize = CMSIS_MEMORY_POOL_MAGAZINE_SIZE>
+	using memory_pool_cache = cmsis::memory_pool_cache<T, MagazineSize>;
+#ifdef CMSIS_STATIC_STORAGE
+	template <class T, size_t N> using static_memory_pool = cmsis::static_memory_pool<T, N>;
+#endif
 } // namespace sys
 
 #endif // CMSIS_MEMORY_H_
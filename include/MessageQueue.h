@@ -28,9 +28,12 @@
 #ifndef CPP_CMSIS_MESSAGE_QUEUE_H_INCLUDED
 #define CPP_CMSIS_MESSAGE_QUEUE_H_INCLUDED
 
+#include "StaticStorage.h"
+#include "Timeout.h"
 #include <chrono>
 #include <memory>
 #include <type_traits>
+#include <utility>
 
 namespace cmsis
 {
@@ -48,7 +51,13 @@ namespace cmsis
 		class message_queue_impl
 		{
 		public:
-			message_queue_impl(size_t max_len, size_t ele_len);
+			message_queue_impl(
+				size_t max_len,
+				size_t ele_len,
+				void* cb_mem = nullptr,
+				size_t cb_size = 0,
+				void* mq_mem = nullptr,
+				size_t mq_size = 0);
 			message_queue_impl(const message_queue_impl&) = delete;
 			message_queue_impl(message_queue_impl&& t);
 			~message_queue_impl() noexcept(false);
@@ -61,14 +70,30 @@ namespace cmsis
 			void put(const void* data, uint8_t priority);
 			mq_status put(const void* data, uint8_t priority, std::chrono::microseconds usec);
 
-			void get(void* data);
-			mq_status get(void* data, std::chrono::microseconds usec);
+			// priority receives the priority of the message, if not null
+			void get(void* data, uint8_t* priority = nullptr);
+			mq_status get(void* data, std::chrono::microseconds usec, uint8_t* priority = nullptr);
+
+			bool try_put(const void* data, uint8_t priority);
+			bool try_get(void* data, uint8_t* priority = nullptr);
+
+			// Batch transfers of elements of ele_len bytes: block for the first element only, then move the rest
+			// without waiting. Return the number of elements moved.
+			size_t put_n(const void* data, size_t ele_len, size_t count, uint8_t priority);
+			size_t
+			put_n(const void* data, size_t ele_len, size_t count, uint8_t priority, std::chrono::microseconds usec);
+			size_t get_n(void* data, size_t ele_len, size_t count);
+			size_t get_n(void* data, size_t ele_len, size_t count, std::chrono::microseconds usec);
 
 			size_t size() const;
 			size_t capacity() const;
 
 			void clear();
 
+		private:
+			size_t put_available(const void* data, size_t ele_len, size_t count, uint8_t priority);
+			size_t get_available(void* data, size_t ele_len, size_t count);
+
 		private:
 			void* m_id;
 		};
@@ -105,13 +130,13 @@ namespace cmsis
 		template <class Rep, class Period>
 		mq_status put(const element_type& data, uint8_t priority, const std::chrono::duration<Rep, Period>& wait_time)
 		{
-			return internal::message_queue_impl::put(&data, priority, wait_time);
+			return internal::message_queue_impl::put(&data, priority, internal::to_usec(wait_time));
 		}
 
 		template <class Rep, class Period>
 		mq_status put(const element_type& data, const std::chrono::duration<Rep, Period>& wait_time)
 		{
-			return internal::message_queue_impl::put(&data, 0, wait_time);
+			return internal::message_queue_impl::put(&data, 0, internal::to_usec(wait_time));
 		}
 
 		element_type get()
@@ -123,10 +148,65 @@ namespace cmsis
 
 		void get(element_type& data) { internal::message_queue_impl::get(&data); }
 
+		/// Get a message and its priority.
+		void get(element_type& data, uint8_t& priority) { internal::message_queue_impl::get(&data, &priority); }
+
 		template <class Rep, class Period>
 		mq_status get(element_type& data, const std::chrono::duration<Rep, Period>& wait_time)
 		{
-			return internal::message_queue_impl::get(&data, wait_time);
+			return internal::message_queue_impl::get(&data, internal::to_usec(wait_time));
+		}
+
+		template <class Rep, class Period>
+		mq_status get(element_type& data, uint8_t& priority, const std::chrono::duration<Rep, Period>& wait_time)
+		{
+			return internal::message_queue_impl::get(&data, internal::to_usec(wait_time), &priority);
+		}
+
+		/// Put up to count elements: wait for room for the first one only. Return the number of elements put.
+		size_t put_n(const element_type* data, size_t count, uint8_t priority = 0)
+		{
+			return internal::message_queue_impl::put_n(data, sizeof(element_type), count, priority);
+		}
+
+		template <class Rep, class Period>
+		size_t put_n(
+			const element_type* data,
+			size_t count,
+			uint8_t priority,
+			const std::chrono::duration<Rep, Period>& wait_time)
+		{
+			return internal::message_queue_impl::put_n(
+				data,
+				sizeof(element_type),
+				count,
+				priority,
+				internal::to_usec(wait_time));
+		}
+
+		/// Get up to count elements: wait for the first one only. Return the number of elements got.
+		size_t get_n(element_type* data, size_t count)
+		{
+			return internal::message_queue_impl::get_n(data, sizeof(element_type), count);
+		}
+
+		template <class Rep, class Period>
+		size_t get_n(element_type* data, size_t count, const std::chrono::duration<Rep, Period>& wait_time)
+		{
+			return internal::message_queue_impl::get_n(data, sizeof(element_type), count, internal::to_usec(wait_time));
+		}
+
+		/// Move up to max queued elements to out, without waiting. Return the number of elements moved.
+		template <class OutputIt> size_t drain(OutputIt out, size_t max)
+		{
+			size_t n = 0;
+			element_type data;
+			while (n < max && internal::message_queue_impl::try_get(&data))
+			{
+				*out++ = std::move(data);
+				++n;
+			}
+			return n;
 		}
 
 		bool empty() const { return size() == 0; }
@@ -134,6 +214,11 @@ namespace cmsis
 		size_t capacity() const { return internal::message_queue_impl::capacity(); }
 
 		void clear() { internal::message_queue_impl::clear(); }
+
+	protected:
+		message_queue(size_t max_len, void* cb_mem, size_t cb_size, void* mq_mem, size_t mq_size) :
+			internal::message_queue_impl(max_len, sizeof(T), cb_mem, cb_size, mq_mem, mq_size)
+		{}
 	};
 
 	template <class T> // Specialization for unique_pointer
@@ -171,14 +256,14 @@ namespace cmsis
 		mq_status put(std::unique_ptr<T>&& data, uint8_t priority, const std::chrono::duration<Rep, Period>& wait_time)
 		{
 			pointer ptr = data.release();
-			return internal::message_queue_impl::put(&ptr, priority, wait_time);
+			return internal::message_queue_impl::put(&ptr, priority, internal::to_usec(wait_time));
 		}
 
 		template <class Rep, class Period>
 		mq_status put(std::unique_ptr<T>&& data, const std::chrono::duration<Rep, Period>& wait_time)
 		{
 			pointer ptr = data.release();
-			return internal::message_queue_impl::put(&ptr, 0, wait_time);
+			return internal::message_queue_impl::put(&ptr, 0, internal::to_usec(wait_time));
 		}
 
 		std::unique_ptr<T> get()
@@ -191,7 +276,15 @@ namespace cmsis
 		void get(std::unique_ptr<T>& data)
 		{
 			void* ptr = nullptr;
-			bool ret = internal::message_queue_impl::get(&ptr);
+			internal::message_queue_impl::get(&ptr);
+			data.reset(static_cast<pointer>(ptr));
+		}
+
+		/// Get a message and its priority.
+		void get(std::unique_ptr<T>& data, uint8_t& priority)
+		{
+			void* ptr = nullptr;
+			internal::message_queue_impl::get(&ptr, &priority);
 			data.reset(static_cast<pointer>(ptr));
 		}
 
@@ -199,11 +292,83 @@ namespace cmsis
 		mq_status get(std::unique_ptr<T>& data, const std::chrono::duration<Rep, Period>& wait_time)
 		{
 			void* ptr = nullptr;
-			mq_status ret = internal::message_queue_impl::get(&ptr, wait_time);
+			mq_status ret = internal::message_queue_impl::get(&ptr, internal::to_usec(wait_time));
 			data.reset(static_cast<pointer>(ptr));
 			return ret;
 		}
 
+		template <class Rep, class Period>
+		mq_status
+		get(std::unique_ptr<T>& data, uint8_t& priority, const std::chrono::duration<Rep, Period>& wait_time)
+		{
+			void* ptr = nullptr;
+			mq_status ret = internal::message_queue_impl::get(&ptr, internal::to_usec(wait_time), &priority);
+			data.reset(static_cast<pointer>(ptr));
+			return ret;
+		}
+
+		/// Put up to count elements: wait for room for the first one only. The elements put are released,
+		/// the others stay owned by the caller. Return the number of elements put.
+		size_t put_n(std::unique_ptr<T>* data, size_t count, uint8_t priority = 0)
+		{
+			if (count == 0)
+				return 0;
+
+			put(std::move(data[0]), priority);
+			return 1 + put_available(data + 1, count - 1, priority);
+		}
+
+		template <class Rep, class Period>
+		size_t put_n(
+			std::unique_ptr<T>* data,
+			size_t count,
+			uint8_t priority,
+			const std::chrono::duration<Rep, Period>& wait_time)
+		{
+			if (count == 0)
+				return 0;
+
+			pointer ptr = data[0].get();
+			mq_status sta = internal::message_queue_impl::put(&ptr, priority, internal::to_usec(wait_time));
+			if (sta != mq_status::no_timeout)
+				return 0;
+
+			data[0].release();
+			return 1 + put_available(data + 1, count - 1, priority);
+		}
+
+		/// Get up to count elements: wait for the first one only. Return the number of elements got.
+		size_t get_n(std::unique_ptr<T>* data, size_t count)
+		{
+			if (count == 0)
+				return 0;
+
+			get(data[0]);
+			return 1 + drain(data + 1, count - 1);
+		}
+
+		template <class Rep, class Period>
+		size_t get_n(std::unique_ptr<T>* data, size_t count, const std::chrono::duration<Rep, Period>& wait_time)
+		{
+			if (count == 0 || get(data[0], wait_time) != mq_status::no_timeout)
+				return 0;
+
+			return 1 + drain(data + 1, count - 1);
+		}
+
+		/// Move up to max queued elements to out, without waiting. Return the number of elements moved.
+		template <class OutputIt> size_t drain(OutputIt out, size_t max)
+		{
+			size_t n = 0;
+			void* ptr = nullptr;
+			while (n < max && internal::message_queue_impl::try_get(&ptr))
+			{
+				*out++ = std::unique_ptr<T>(static_cast<pointer>(ptr));
+				++n;
+			}
+			return n;
+		}
+
 		bool empty() const { return size() == 0; }
 		size_t size() const { return internal::message_queue_impl::size(); }
 		size_t capacity() const { return internal::message_queue_impl::capacity(); }
@@ -216,6 +381,25 @@ namespace cmsis
 
 			internal::message_queue_impl::clear();
 		}
+
+	protected:
+		message_queue(size_t max_len, void* cb_mem, size_t cb_size, void* mq_mem, size_t mq_size) :
+			internal::message_queue_impl(max_len, sizeof(pointer), cb_mem, cb_size, mq_mem, mq_size)
+		{}
+
+	private:
+		size_t put_available(std::unique_ptr<T>* data, size_t count, uint8_t priority)
+		{
+			size_t n = 0;
+			for (; n < count; ++n)
+			{
+				pointer ptr = data[n].get();
+				if (!internal::message_queue_impl::try_put(&ptr, priority))
+					break;
+				data[n].release();
+			}
+			return n;
+		}
 	};
 
 	template <class T> // Specialization for pointer
@@ -248,13 +432,13 @@ namespace cmsis
 		template <class Rep, class Period>
 		mq_status put(const pointer& ptr, uint8_t priority, const std::chrono::duration<Rep, Period>& wait_time)
 		{
-			return internal::message_queue_impl::put(&ptr, priority, wait_time);
+			return internal::message_queue_impl::put(&ptr, priority, internal::to_usec(wait_time));
 		}
 
 		template <class Rep, class Period>
 		mq_status put(const pointer& ptr, const std::chrono::duration<Rep, Period>& wait_time)
 		{
-			return internal::message_queue_impl::put(&ptr, 0, wait_time);
+			return internal::message_queue_impl::put(&ptr, 0, internal::to_usec(wait_time));
 		}
 
 		pointer get()
@@ -267,7 +451,15 @@ namespace cmsis
 		void get(pointer& data)
 		{
 			void* ptr = nullptr;
-			bool ret = internal::message_queue_impl::get(&ptr);
+			internal::message_queue_impl::get(&ptr);
+			data = static_cast<pointer>(ptr);
+		}
+
+		/// Get a message and its priority.
+		void get(pointer& data, uint8_t& priority)
+		{
+			void* ptr = nullptr;
+			internal::message_queue_impl::get(&ptr, &priority);
 			data = static_cast<pointer>(ptr);
 		}
 
@@ -275,28 +467,123 @@ namespace cmsis
 		mq_status get(pointer& data, const std::chrono::duration<Rep, Period>& wait_time)
 		{
 			void* ptr = nullptr;
-			mq_status ret = internal::message_queue_impl::get(&ptr, wait_time);
+			mq_status ret = internal::message_queue_impl::get(&ptr, internal::to_usec(wait_time));
+			data = static_cast<pointer>(ptr);
+			return ret;
+		}
+
+		template <class Rep, class Period>
+		mq_status get(pointer& data, uint8_t& priority, const std::chrono::duration<Rep, Period>& wait_time)
+		{
+			void* ptr = nullptr;
+			mq_status ret = internal::message_queue_impl::get(&ptr, internal::to_usec(wait_time), &priority);
 			data = static_cast<pointer>(ptr);
 			return ret;
 		}
 
+		/// Put up to count elements: wait for room for the first one only. Return the number of elements put.
+		size_t put_n(const pointer* data, size_t count, uint8_t priority = 0)
+		{
+			return internal::message_queue_impl::put_n(data, sizeof(pointer), count, priority);
+		}
+
+		template <class Rep, class Period>
+		size_t
+		put_n(const pointer* data, size_t count, uint8_t priority, const std::chrono::duration<Rep, Period>& wait_time)
+		{
+			return internal::message_queue_impl::put_n(
+				data,
+				sizeof(pointer),
+				count,
+				priority,
+				internal::to_usec(wait_time));
+		}
+
+		/// Get up to count elements: wait for the first one only. Return the number of elements got.
+		size_t get_n(pointer* data, size_t count)
+		{
+			return internal::message_queue_impl::get_n(data, sizeof(pointer), count);
+		}
+
+		template <class Rep, class Period>
+		size_t get_n(pointer* data, size_t count, const std::chrono::duration<Rep, Period>& wait_time)
+		{
+			return internal::message_queue_impl::get_n(data, sizeof(pointer), count, internal::to_usec(wait_time));
+		}
+
+		/// Move up to max queued elements to out, without waiting. Return the number of elements moved.
+		template <class OutputIt> size_t drain(OutputIt out, size_t max)
+		{
+			size_t n = 0;
+			void* ptr = nullptr;
+			while (n < max && internal::message_queue_impl::try_get(&ptr))
+			{
+				*out++ = static_cast<pointer>(ptr);
+				++n;
+			}
+			return n;
+		}
+
 		bool empty() const { return size() == 0; }
 		size_t size() const { return internal::message_queue_impl::size(); }
 		size_t capacity() const { return internal::message_queue_impl::capacity(); }
 
 		void clear() { internal::message_queue_impl::clear(); }
+
+	protected:
+		message_queue(size_t max_len, void* cb_mem, size_t cb_size, void* mq_mem, size_t mq_size) :
+			internal::message_queue_impl(max_len, sizeof(pointer), cb_mem, cb_size, mq_mem, mq_size)
+		{}
 	};
 
 	template <class T> inline void swap(message_queue<T>& __x, message_queue<T>& __y) noexcept
 	{
 		__x.swap(__y);
 	}
+
+#ifdef CMSIS_STATIC_STORAGE
+	namespace internal
+	{
+		// Size of a message in the kernel queue
+		template <class T> struct message_size : std::integral_constant<size_t, sizeof(T)>
+		{};
+
+		template <class T>
+		struct message_size<std::unique_ptr<T>>
+			: std::integral_constant<size_t, sizeof(typename std::unique_ptr<T>::pointer)>
+		{};
+
+		template <class T> struct message_size<T*> : std::integral_constant<size_t, sizeof(T*)>
+		{};
+	} // namespace internal
+
+	// Message queue of N messages, with the control block and the messages embedded in the object.
+	// It can't be moved, nor swapped.
+	template <class T, size_t N>
+	class static_message_queue
+		: private internal::static_storage<
+			  CMSIS_MESSAGE_QUEUE_CB_SIZE,
+			  CMSIS_MESSAGE_QUEUE_MEM_SIZE(N, internal::message_size<T>::value)>,
+		  public message_queue<T>
+	{
+	public:
+		static_message_queue() :
+			message_queue<T>(N, this->cb_mem, sizeof(this->cb_mem), this->mem, sizeof(this->mem))
+		{}
+
+		static_message_queue(const static_message_queue&) = delete;
+		static_message_queue& operator=(const static_message_queue&) = delete;
+	};
+#endif // CMSIS_STATIC_STORAGE
 } // namespace cmsis
 
 namespace sys
 {
 	using mq_status = cmsis::mq_status;
 	template <class T> using message_queue = cmsis::message_queue<T>;
+#ifdef CMSIS_STATIC_STORAGE
+	template <class T, size_t N> using static_message_queue = cmsis::static_message_queue<T, N>;
+#endif
 } // namespace sys
 
 #endif // CPP_CMSIS_MESSAGE_QUEUE_H_INCLUDED
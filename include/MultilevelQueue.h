@@ -0,0 +1,411 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CMSIS_MULTILEVEL_QUEUE_H_
+#define CMSIS_MULTILEVEL_QUEUE_H_
+
+#include "KernelLock.h"
+#include "MessageQueue.h"
+#include "OSException.h"
+#include "Semaphore.h"
+#include "cmsis_os2.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#if defined(RTE_CMSIS_RTOS2_RTX5)
+#include "cmsis_compiler.h"
+#endif
+
+namespace cmsis
+{
+	namespace internal
+	{
+		// Lists of the nodes of a multilevel_queue: a FIFO per priority level, a bitmap of the levels that aren't
+		// empty, and a free list. Every operation is O(1), the caller holds the kernel lock.
+		class multilevel_index
+		{
+		public:
+			static constexpr size_t max_levels = 32;
+			static constexpr size_t max_nodes = 0xFFFF;
+
+			multilevel_index(uint16_t* next, size_t count) noexcept;
+
+			/// Take a free node, there must be one.
+			size_t take() noexcept
+			{
+				uint16_t node = m_free;
+				m_free = m_next[node];
+				return node;
+			}
+
+			/// Give back a node taken, or popped.
+			void give(size_t node) noexcept
+			{
+				m_next[node] = m_free;
+				m_free = static_cast<uint16_t>(node);
+			}
+
+			/// Queue a taken node at the end of its level.
+			void push(size_t node, uint8_t level) noexcept
+			{
+				m_next[node] = npos;
+				if (m_tail[level] == npos)
+					m_head[level] = static_cast<uint16_t>(node);
+				else
+					m_next[m_tail[level]] = static_cast<uint16_t>(node);
+				m_tail[level] = static_cast<uint16_t>(node);
+
+				++m_size[level];
+				++m_count;
+				m_levels |= 1U << level;
+			}
+
+			/// First node of the highest level, npos when the lists are empty.
+			size_t front(uint8_t& level) const noexcept
+			{
+				if (m_levels == 0)
+					return npos;
+
+				level = static_cast<uint8_t>(top_level());
+				return m_head[level];
+			}
+
+			/// Remove the first node of the highest level, there must be one.
+			size_t pop(uint8_t& level) noexcept
+			{
+				size_t node = front(level);
+				m_head[level] = m_next[node];
+				if (m_head[level] == npos)
+				{
+					m_tail[level] = npos;
+					m_levels &= ~(1U << level);
+				}
+
+				--m_size[level];
+				--m_count;
+				return node;
+			}
+
+			size_t size() const noexcept { return m_count; }
+			size_t size(uint8_t level) const noexcept { return m_size[level]; }
+			int top_level() const noexcept { return m_levels ? highest_bit(m_levels) : -1; }
+
+			static constexpr uint16_t npos = 0xFFFF;
+
+			multilevel_index(const multilevel_index&) = delete;
+			multilevel_index& operator=(const multilevel_index&) = delete;
+
+		private:
+			/// Index of the highest bit set in value, which isn't 0.
+			static int highest_bit(uint32_t value) noexcept
+			{
+#if defined(RTE_CMSIS_RTOS2_RTX5)
+				return 31 - __CLZ(value);
+#elif defined(__GNUC__)
+				return 31 - __builtin_clz(value);
+#else
+				int bit = 0;
+				for (int shift = 16; shift; shift /= 2)
+				{
+					if (value >> shift)
+					{
+						value >>= shift;
+						bit += shift;
+					}
+				}
+				return bit;
+#endif
+			}
+
+		private:
+			uint16_t* m_next;
+			uint16_t m_free;
+			uint16_t m_count;
+			uint32_t m_levels; // bit n set when the level n isn't empty
+			uint16_t m_head[max_levels];
+			uint16_t m_tail[max_levels];
+			uint16_t m_size[max_levels];
+		};
+	} // namespace internal
+
+	// Queue of N messages on Levels priority levels (0 to Levels - 1, the highest first), FIFO within a level.
+	// Unlike message_queue, whose insertion is sorted by priority, both put and get are O(1) whatever the number
+	// of messages queued at the other levels. The messages are stored in the object; T only needs to be movable.
+	// peek() copies the next message without removing it, size(priority) counts the messages of a level, and
+	// top_priority() gives the level of the next message: enough to decide whether to preempt the current work.
+	// The lists are updated under the kernel lock, the messages are built and moved outside of it: a node belongs to
+	// the caller once taken from the free list or popped. Only peek() copies a message under the kernel lock. The
+	// queue can't be used from an ISR.
+	template <class T, size_t N, size_t Levels = 8> class multilevel_queue
+	{
+		static_assert(N != 0 && N < internal::multilevel_index::max_nodes, "invalid number of messages");
+		static_assert(
+			Levels != 0 && Levels <= internal::multilevel_index::max_levels,
+			"invalid number of priority levels");
+
+	public:
+		typedef T element_type;
+
+		multilevel_queue() :
+			m_index(m_next, N),
+			m_free(N),
+			m_queued(0)
+		{}
+		~multilevel_queue() { clear(); }
+
+		/// Queue a message, waits for room.
+		void put(const element_type& data, uint8_t priority = 0)
+		{
+			check_priority(priority);
+			m_free.acquire();
+			put_at(data, priority);
+		}
+
+		void put(element_type&& data, uint8_t priority = 0)
+		{
+			check_priority(priority);
+			m_free.acquire();
+			put_at(std::move(data), priority);
+		}
+
+		/// Queue a message, waiting for room for wait_time at most.
+		template <class Rep, class Period>
+		mq_status put(const element_type& data, uint8_t priority, const std::chrono::duration<Rep, Period>& wait_time)
+		{
+			check_priority(priority);
+			if (!m_free.try_acquire_for(wait_time))
+				return wait_time > wait_time.zero() ? mq_status::timeout : mq_status::full;
+
+			put_at(data, priority);
+			return mq_status::no_timeout;
+		}
+
+		bool try_put(const element_type& data, uint8_t priority = 0)
+		{
+			check_priority(priority);
+			if (!m_free.try_acquire())
+				return false;
+
+			put_at(data, priority);
+			return true;
+		}
+
+		/// Get the first message of the highest level, waits for one.
+		element_type get()
+		{
+			uint8_t priority = 0;
+			m_queued.acquire();
+			return take_front(priority);
+		}
+
+		void get(element_type& data, uint8_t& priority)
+		{
+			m_queued.acquire();
+			data = take_front(priority);
+		}
+
+		/// Get the first message of the highest level, waiting for wait_time at most.
+		template <class Rep, class Period>
+		mq_status get(element_type& data, uint8_t& priority, const std::chrono::duration<Rep, Period>& wait_time)
+		{
+			if (!m_queued.try_acquire_for(wait_time))
+				return wait_time > wait_time.zero() ? mq_status::timeout : mq_status::empty;
+
+			data = take_front(priority);
+			return mq_status::no_timeout;
+		}
+
+		bool try_get(element_type& data, uint8_t& priority)
+		{
+			if (!m_queued.try_acquire())
+				return false;
+
+			data = take_front(priority);
+			return true;
+		}
+
+		/// Copy the next message and its priority, without removing it. Returns false when the queue is empty.
+		/// The copy assignment runs under the kernel lock, the message could be popped otherwise: it must not call a
+		/// blocking service (an allocation through a mutex...).
+		bool peek(element_type& data, uint8_t& priority) const
+		{
+			internal::kernel_lock lock;
+			size_t node = m_index.front(priority);
+			if (node == internal::multilevel_index::npos)
+				return false;
+
+			data = *item(node);
+			return true;
+		}
+
+		/// Priority of the next message, -1 when the queue is empty.
+		int top_priority() const noexcept
+		{
+			internal::kernel_lock lock;
+			return m_index.top_level();
+		}
+
+		bool empty() const noexcept { return size() == 0; }
+
+		size_t size() const noexcept
+		{
+			internal::kernel_lock lock;
+			return m_index.size();
+		}
+
+		size_t size(uint8_t priority) const noexcept
+		{
+			internal::kernel_lock lock;
+			return priority < Levels ? m_index.size(priority) : 0;
+		}
+
+		static constexpr size_t capacity() noexcept { return N; }
+		static constexpr size_t levels() noexcept { return Levels; }
+
+		/// Remove the queued messages.
+		void clear()
+		{
+			uint8_t priority = 0;
+			while (m_queued.try_acquire())
+				take_front(priority);
+		}
+
+		multilevel_queue(const multilevel_queue&) = delete;
+		multilevel_queue& operator=(const multilevel_queue&) = delete;
+
+	private:
+		typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_type;
+
+		element_type* item(size_t node) noexcept { return reinterpret_cast<element_type*>(&m_items[node]); }
+		const element_type* item(size_t node) const noexcept
+		{
+			return reinterpret_cast<const element_type*>(&m_items[node]);
+		}
+
+		static void check_priority(uint8_t priority)
+		{
+			if (priority >= Levels)
+#ifdef __cpp_exceptions
+				throw std::system_error(osErrorParameter, os_category(), "multilevel_queue: invalid priority");
+#else
+				std::terminate();
+#endif
+		}
+
+		/// Build the message in a free node, then queue it. A node has been counted for the caller.
+		template <class U> void put_at(U&& data, uint8_t priority)
+		{
+			size_t node = take_node();
+#ifdef __cpp_exceptions
+			try
+			{
+				::new (static_cast<void*>(item(node))) element_type(std::forward<U>(data));
+			}
+			catch (...)
+			{
+				give_node(node);
+				m_free.release();
+				throw;
+			}
+#else
+			::new (static_cast<void*>(item(node))) element_type(std::forward<U>(data));
+#endif
+			{
+				internal::kernel_lock lock;
+				m_index.push(node, priority);
+			}
+			m_queued.release();
+		}
+
+		/// Remove the next message, a message has been counted for the caller.
+		element_type take_front(uint8_t& priority)
+		{
+			// The node is out of the lists: the message is moved without the lock
+			popped_node node(*this, priority);
+			return std::move(*node);
+		}
+
+		size_t take_node() noexcept
+		{
+			internal::kernel_lock lock;
+			return m_index.take();
+		}
+
+		void give_node(size_t node) noexcept
+		{
+			internal::kernel_lock lock;
+			m_index.give(node);
+		}
+
+	private:
+		// Node removed from the lists: the message is destroyed and the node freed with this object, even when the
+		// move of the message throws.
+		class popped_node
+		{
+		public:
+			popped_node(multilevel_queue& queue, uint8_t& priority) noexcept :
+				m_queue(queue)
+			{
+				internal::kernel_lock lock;
+				m_node = queue.m_index.pop(priority);
+			}
+			~popped_node()
+			{
+				m_queue.item(m_node)->~element_type();
+				m_queue.give_node(m_node);
+				m_queue.m_free.release();
+			}
+
+			element_type& operator*() const noexcept { return *m_queue.item(m_node); }
+
+			popped_node(const popped_node&) = delete;
+			popped_node& operator=(const popped_node&) = delete;
+
+		private:
+			multilevel_queue& m_queue;
+			size_t m_node;
+		};
+
+	private:
+		storage_type m_items[N];
+		uint16_t m_next[N];
+		internal::multilevel_index m_index;
+		counting_semaphore<N> m_free;   // free nodes
+		counting_semaphore<N> m_queued; // queued messages
+	};
+} // namespace cmsis
+
+namespace sys
+{
+	template <class T, size_t N, size_t Levels = 8>
+	using multilevel_queue = cmsis::multilevel_queue<T, N, Levels>;
+} // namespace sys
+
+#endif // CMSIS_MULTILEVEL_QUEUE_H_
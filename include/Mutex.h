@@ -28,18 +28,59 @@
 #ifndef CMSIS_MUTEX_H_
 #define CMSIS_MUTEX_H_
 
+#include "KernelLock.h"
+#include "StaticStorage.h"
+#include "Timeout.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <mutex>
+#include <type_traits>
+#include <utility>
 
 namespace cmsis
 {
+#ifdef CMSIS_MUTEX_PROFILING
+	/// Statistics of a mutex, in profiling builds. Durations are in nanoseconds, measured with the system timer.
+	struct mutex_stats
+	{
+		const char* name;
+		void* handle;
+		void* owner;           // owner thread when the statistics were collected
+		uint32_t acquires;     // successful locks
+		uint32_t contentions;  // successful locks that had to wait for another owner
+		uint64_t total_wait;   // time spent waiting by the contended locks
+		uint64_t max_wait;     // longest wait of a lock
+		uint64_t max_hold;     // longest time the mutex has been owned
+	};
+
+	namespace mutex_profiler
+	{
+		/// Copy the statistics of the live mutexes into stats. Returns the number of live mutexes, which can be more
+		/// than max.
+		size_t collect(mutex_stats* stats, size_t max) noexcept;
+
+		/// Write the statistics of the live mutexes as text, one line per mutex. Returns the length of the full text
+		/// like snprintf: it has been truncated if it is not less than size.
+		size_t dump(char* buffer, size_t size) noexcept;
+
+		/// Clear the statistics of the live mutexes.
+		void reset() noexcept;
+	} // namespace mutex_profiler
+#endif // CMSIS_MUTEX_PROFILING
+
 	namespace internal
 	{
+#ifdef CMSIS_MUTEX_PROFILING
+		struct mutex_registry;
+#endif
+
 		class base_timed_mutex
 		{
 		protected:
 			typedef void* native_handle_type;
 
-			base_timed_mutex(const char* name, bool recursive);
+			base_timed_mutex(const char* name, bool recursive, void* cb_mem = nullptr, size_t cb_size = 0);
 			~base_timed_mutex() noexcept(false);
 
 			void lock();
@@ -48,7 +89,7 @@ namespace cmsis
 
 			template <class Rep, class Period> bool try_lock_for(const std::chrono::duration<Rep, Period>& rel_time)
 			{
-				return try_lock_for_usec(rel_time);
+				return try_lock_for_usec(to_usec(rel_time));
 			}
 
 			template <class Clock, class Duration>
@@ -68,9 +109,35 @@ namespace cmsis
 
 		private:
 			bool try_lock_for_usec(std::chrono::microseconds usec);
+			int32_t acquire(uint32_t timeout);
+
+#ifdef CMSIS_MUTEX_PROFILING
+			friend struct mutex_registry;
+
+			// Written by the owner of the mutex only, durations in system timer ticks
+			struct profile
+			{
+				base_timed_mutex* prev; // list of the live mutexes
+				base_timed_mutex* next;
+				const char* name;
+				uint32_t depth;
+				uint32_t hold_start;
+				uint32_t acquires;
+				uint32_t contentions;
+				uint64_t total_wait;
+				uint32_t max_wait;
+				uint32_t max_hold;
+			};
+
+			void profile_acquired(uint32_t wait_start, bool contended) noexcept;
+			void profile_release() noexcept;
+#endif // CMSIS_MUTEX_PROFILING
 
 		private:
 			native_handle_type m_id; ///< mutex identifier
+#ifdef CMSIS_MUTEX_PROFILING
+			profile m_profile;
+#endif
 		};
 	} // namespace internal
 
@@ -83,6 +150,9 @@ namespace cmsis
 		mutex() :
 			internal::base_timed_mutex("mutex", false)
 		{}
+		explicit mutex(const char* name) :
+			internal::base_timed_mutex(name, false)
+		{}
 		~mutex() = default;
 
 		void lock() { internal::base_timed_mutex::lock(); }
@@ -93,6 +163,11 @@ namespace cmsis
 
 		mutex(const mutex&) = delete;
 		mutex& operator=(const mutex&) = delete;
+
+	protected:
+		mutex(const char* name, void* cb_mem, size_t cb_size) :
+			internal::base_timed_mutex(name, false, cb_mem, cb_size)
+		{}
 	};
 
 	class recursive_mutex : private internal::base_timed_mutex
@@ -103,6 +178,9 @@ namespace cmsis
 		recursive_mutex() :
 			internal::base_timed_mutex("recursive_mutex", true)
 		{}
+		explicit recursive_mutex(const char* name) :
+			internal::base_timed_mutex(name, true)
+		{}
 		~recursive_mutex() = default;
 
 		void lock() { internal::base_timed_mutex::lock(); }
@@ -113,6 +191,11 @@ namespace cmsis
 
 		recursive_mutex(const recursive_mutex&) = delete;
 		recursive_mutex& operator=(const recursive_mutex&) = delete;
+
+	protected:
+		recursive_mutex(const char* name, void* cb_mem, size_t cb_size) :
+			internal::base_timed_mutex(name, true, cb_mem, cb_size)
+		{}
 	};
 
 	class timed_mutex : private internal::base_timed_mutex
@@ -123,6 +206,9 @@ namespace cmsis
 		timed_mutex() :
 			internal::base_timed_mutex("timed_mutex", false)
 		{}
+		explicit timed_mutex(const char* name) :
+			internal::base_timed_mutex(name, false)
+		{}
 		~timed_mutex() = default;
 
 		void lock() { internal::base_timed_mutex::lock(); }
@@ -144,6 +230,11 @@ namespace cmsis
 
 		timed_mutex(const timed_mutex&) = delete;
 		timed_mutex& operator=(const timed_mutex&) = delete;
+
+	protected:
+		timed_mutex(const char* name, void* cb_mem, size_t cb_size) :
+			internal::base_timed_mutex(name, false, cb_mem, cb_size)
+		{}
 	};
 
 	class recursive_timed_mutex : private internal::base_timed_mutex
@@ -154,6 +245,9 @@ namespace cmsis
 		recursive_timed_mutex() :
 			internal::base_timed_mutex("recursive_timed_mutex", true)
 		{}
+		explicit recursive_timed_mutex(const char* name) :
+			internal::base_timed_mutex(name, true)
+		{}
 		~recursive_timed_mutex() = default;
 
 		void lock() { internal::base_timed_mutex::lock(); }
@@ -175,7 +269,118 @@ namespace cmsis
 
 		recursive_timed_mutex(const recursive_timed_mutex&) = delete;
 		recursive_timed_mutex& operator=(const recursive_timed_mutex&) = delete;
+
+	protected:
+		recursive_timed_mutex(const char* name, void* cb_mem, size_t cb_size) :
+			internal::base_timed_mutex(name, true, cb_mem, cb_size)
+		{}
+	};
+
+#ifdef CMSIS_STATIC_STORAGE
+	// Mutexes with the control block embedded in the object
+	class static_mutex : private internal::static_storage<CMSIS_MUTEX_CB_SIZE>, public mutex
+	{
+	public:
+		explicit static_mutex(const char* name = "mutex") :
+			mutex(name, cb_mem, sizeof(cb_mem))
+		{}
 	};
+
+	class static_recursive_mutex : private internal::static_storage<CMSIS_MUTEX_CB_SIZE>, public recursive_mutex
+	{
+	public:
+		explicit static_recursive_mutex(const char* name = "recursive_mutex") :
+			recursive_mutex(name, cb_mem, sizeof(cb_mem))
+		{}
+	};
+
+	class static_timed_mutex : private internal::static_storage<CMSIS_MUTEX_CB_SIZE>, public timed_mutex
+	{
+	public:
+		explicit static_timed_mutex(const char* name = "timed_mutex") :
+			timed_mutex(name, cb_mem, sizeof(cb_mem))
+		{}
+	};
+
+	class static_recursive_timed_mutex : private internal::static_storage<CMSIS_MUTEX_CB_SIZE>,
+										 public recursive_timed_mutex
+	{
+	public:
+		explicit static_recursive_timed_mutex(const char* name = "recursive_timed_mutex") :
+			recursive_timed_mutex(name, cb_mem, sizeof(cb_mem))
+		{}
+	};
+#endif // CMSIS_STATIC_STORAGE
+
+	class once_flag;
+
+	namespace internal
+	{
+		/// First calls of call_once: run routine(context) once, or wait for the thread running it.
+		void call_once_slow(once_flag& flag, void (*routine)(void*), void* context);
+
+		template <class _Callable, class... _Args>
+		void invoke_once(std::false_type, _Callable&& __f, _Args&&... __args)
+		{
+			std::forward<_Callable>(__f)(std::forward<_Args>(__args)...);
+		}
+
+		template <class _Callable, class... _Args>
+		void invoke_once(std::true_type, _Callable&& __f, _Args&&... __args)
+		{
+			std::mem_fn(__f)(std::forward<_Args>(__args)...);
+		}
+
+		template <class _Routine> void run_once(void* __p)
+		{
+			(*static_cast<_Routine*>(__p))();
+		}
+	} // namespace internal
+
+	// STL like implementation. The flag is a single word, without any kernel object: the threads that call
+	// call_once while another thread runs the routine wait on a thread flag reserved by the library.
+	class once_flag
+	{
+	public:
+		constexpr once_flag() noexcept :
+			m_state(0),
+			m_waiters()
+		{}
+
+		once_flag(const once_flag&) = delete;
+		once_flag& operator=(const once_flag&) = delete;
+
+	private:
+		friend void internal::call_once_slow(once_flag& flag, void (*routine)(void*), void* context);
+		template <class _Callable, class... _Args> friend void call_once(once_flag&, _Callable&&, _Args&&...);
+
+		enum state : uint32_t
+		{
+			init,
+			running,
+			done
+		};
+
+		std::atomic<uint32_t> m_state;
+		internal::wait_list m_waiters; // threads waiting for the routine
+	};
+
+	/// Call __f(__args...) once, even if it is called from several threads. Once a call has returned, the next
+	/// ones are a single atomic load. If the call throws, the exception is given to the caller and another
+	/// thread, or the next call, tries again. Can't be used from an ISR.
+	template <class _Callable, class... _Args> void call_once(once_flag& __flag, _Callable&& __f, _Args&&... __args)
+	{
+		if (__flag.m_state.load(std::memory_order_acquire) == once_flag::done)
+			return;
+
+		auto __call = [&]() {
+			internal::invoke_once(
+				std::is_member_pointer<typename std::decay<_Callable>::type>(),
+				std::forward<_Callable>(__f),
+				std::forward<_Args>(__args)...);
+		};
+		internal::call_once_slow(__flag, &internal::run_once<decltype(__call)>, &__call);
+	}
 } // namespace cmsis
 
 #if !defined(GLIBCXX_HAS_GTHREADS) && !defined(_GLIBCXX_HAS_GTHREADS)
@@ -185,6 +390,8 @@ namespace std
 	using recursive_mutex = cmsis::recursive_mutex;
 	using timed_mutex = cmsis::timed_mutex;
 	using recursive_timed_mutex = cmsis::recursive_timed_mutex;
+	using once_flag = cmsis::once_flag;
+	using cmsis::call_once;
 } // namespace std
 #endif
 
@@ -74,6 +74,19 @@ namespace cmsis
 		uint32_t clock_frequency();
 	} // namespace core
 
+	namespace internal
+	{
+		/// Hint to the core that the thread is spinning.
+		inline void cpu_relax() noexcept
+		{
+#if defined(__x86_64__) || defined(__i386__)
+			__builtin_ia32_pause();
+#elif defined(__aarch64__) || (defined(__ARM_ARCH) && __ARM_ARCH >= 7)
+			__asm__ __volatile__("yield");
+#endif
+		}
+	} // namespace internal
+
 	/// Management of the RTOS Kernel scheduler.
 	/// This class is conform to the C++ BasicLockable concept, and can be used by std::lock_guard.
 	class dispatch
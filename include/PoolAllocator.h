@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CMSIS_POOL_ALLOCATOR_H_
+#define CMSIS_POOL_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <type_traits>
+
+/// Number of words of the bitmap (32 blocks each) scanned by an allocation before it releases the kernel lock.
+#ifndef CMSIS_POOL_ALLOCATOR_SCAN_WORDS
+#define CMSIS_POOL_ALLOCATOR_SCAN_WORDS 4
+#endif
+
+namespace cmsis
+{
+	// Arena of count blocks of the same size, that gives runs of contiguous blocks. The free blocks are tracked in a
+	// bitmap, a request takes the first run that is long enough (first fit). The bitmap is scanned a word at a time,
+	// under the kernel lock which is released every CMSIS_POOL_ALLOCATOR_SCAN_WORDS words: the scheduler is stopped
+	// for a bounded time, whatever the number of blocks. A scan which fails after a deallocation starts again.
+	class block_arena
+	{
+	public:
+		/// The blocks and the bitmap are taken from the heap, once.
+		block_arena(size_t count, size_t block_size);
+		~block_arena();
+
+		/// First block of a run of blocks that holds size bytes, aligned for any type. Returns nullptr when no run is
+		/// long enough.
+		void* allocate(size_t size) noexcept;
+
+		/// Free the run of allocate(size), with the same size.
+		void deallocate(void* p, size_t size) noexcept;
+
+		size_t block_size() const noexcept { return m_block_size; }
+		size_t max_size() const noexcept { return m_count; } // number of blocks
+		size_t size() const noexcept;                         // allocated blocks
+
+		/// Size of the blocks, rounded up to keep them aligned for any type.
+		static constexpr size_t aligned_block_size(size_t block_size) noexcept
+		{
+			return (block_size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+		}
+
+		/// Number of words of the bitmap.
+		static constexpr size_t bitmap_size(size_t count) noexcept { return (count + 31) / 32; }
+
+		block_arena(const block_arena&) = delete;
+		block_arena& operator=(const block_arena&) = delete;
+
+	protected:
+		block_arena(size_t count, size_t block_size, void* mem, uint32_t* bitmap) noexcept;
+
+	private:
+		size_t blocks(size_t size) const noexcept { return size ? (size + m_block_size - 1) / m_block_size : 1; }
+
+	private:
+		unsigned char* m_mem;
+		uint32_t* m_bitmap; // a bit set for each allocated block
+		size_t m_count;
+		size_t m_block_size;
+		size_t m_used;
+		uint32_t m_epoch; // count of the allocations, a scan starts again its run when it changes
+		uint32_t m_freed; // count of the deallocations, a failed scan starts again when it changes
+		void* m_heap; // memory to free in the destructor
+	};
+
+	// Arena of N blocks of BlockSize bytes, with the blocks and the bitmap embedded in the object. Unlike the other
+	// static objects, it doesn't need the kernel: it can be a global object.
+	template <size_t BlockSize, size_t N> class static_block_arena : public block_arena
+	{
+		static_assert(BlockSize != 0 && N != 0, "empty arena");
+
+	public:
+		static_block_arena() noexcept :
+			block_arena(N, BlockSize, m_mem, m_bitmap)
+		{}
+
+	private:
+		alignas(std::max_align_t) unsigned char m_mem[N * aligned_block_size(BlockSize)];
+		uint32_t m_bitmap[bitmap_size(N)];
+	};
+
+	// Allocator of a block_arena, for the STL containers: std::vector<T, cmsis::pool_allocator<T>>. It satisfies the
+	// Allocator requirements: the copies, and the allocators rebound to other types, share the same arena. The arena
+	// must outlive the containers.
+	template <class T> class pool_allocator
+	{
+		static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned type");
+
+	public:
+		typedef T value_type;
+		typedef T* pointer;
+		typedef const T* const_pointer;
+		typedef T& reference;
+		typedef const T& const_reference;
+		typedef size_t size_type;
+		typedef ptrdiff_t difference_type;
+
+		typedef std::true_type propagate_on_container_copy_assignment;
+		typedef std::true_type propagate_on_container_move_assignment;
+		typedef std::true_type propagate_on_container_swap;
+
+		template <class U> struct rebind
+		{
+			typedef pool_allocator<U> other;
+		};
+
+		explicit pool_allocator(block_arena& arena) noexcept :
+			m_arena(&arena)
+		{}
+		pool_allocator(const pool_allocator&) noexcept = default;
+		template <class U>
+		pool_allocator(const pool_allocator<U>& other) noexcept :
+			m_arena(other.arena())
+		{}
+
+		pool_allocator& operator=(const pool_allocator&) noexcept = default;
+
+		pointer allocate(size_type n, const void* = 0)
+		{
+			void* p = (n <= max_size()) ? m_arena->allocate(n * sizeof(T)) : nullptr;
+			if (!p)
+#ifdef __cpp_exceptions
+				throw std::bad_alloc();
+#else
+				std::terminate();
+#endif
+			return static_cast<pointer>(p);
+		}
+
+		void deallocate(pointer p, size_type n) noexcept { m_arena->deallocate(p, n * sizeof(T)); }
+
+		size_type max_size() const noexcept { return m_arena->max_size() * m_arena->block_size() / sizeof(T); }
+
+		block_arena* arena() const noexcept { return m_arena; }
+
+	private:
+		block_arena* m_arena;
+	};
+
+	template <class T1, class T2> bool operator==(const pool_allocator<T1>& lhs, const pool_allocator<T2>& rhs)
+	{
+		return lhs.arena() == rhs.arena();
+	}
+
+	template <class T1, class T2> bool operator!=(const pool_allocator<T1>& lhs, const pool_allocator<T2>& rhs)
+	{
+		return lhs.arena() != rhs.arena();
+	}
+} // namespace cmsis
+
+namespace sys
+{
+	using block_arena = cmsis::block_arena;
+	template <size_t BlockSize, size_t N> using static_block_arena = cmsis::static_block_arena<BlockSize, N>;
+	template <class T> using pool_allocator = cmsis::pool_allocator<T>;
+} // namespace sys
+
+#endif // CMSIS_POOL_ALLOCATOR_H_
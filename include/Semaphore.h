@@ -28,27 +28,62 @@
 #ifndef CPP_CMSIS_SEMAPHORE_H_
 #define CPP_CMSIS_SEMAPHORE_H_
 
+#include "StaticStorage.h"
+#include "Timeout.h"
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 
 namespace cmsis
 {
 	namespace internal
 	{
+		// The count is kept in an atomic: the kernel semaphore is only used to block and wake up the threads, when the
+		// count is negative (its opposite is the number of waiting threads).
 		class base_semaphore
 		{
 		public:
 			typedef void* native_handle_type;
 
-			base_semaphore(std::ptrdiff_t max, std::ptrdiff_t desired);
+			base_semaphore(std::ptrdiff_t max, std::ptrdiff_t desired, void* cb_mem = nullptr, size_t cb_size = 0);
 			~base_semaphore() noexcept(false);
 
-			void release(std::ptrdiff_t update = 1);
-			void acquire();
-			bool try_acquire() noexcept;
+			void release(std::ptrdiff_t update = 1)
+			{
+				int32_t count = m_count.load(std::memory_order_relaxed);
+				do
+				{
+					// A negative count means that the semaphore is empty
+					if (update < 0 || update > m_max - (count > 0 ? count : 0))
+						release_error();
+				} while (!m_count.compare_exchange_weak(
+					count, count + static_cast<int32_t>(update), std::memory_order_release, std::memory_order_relaxed));
+
+				if (count < 0)
+					wake(update < -count ? static_cast<int32_t>(update) : -count);
+			}
+
+			void acquire()
+			{
+				if (m_count.fetch_sub(1, std::memory_order_acquire) <= 0)
+					wait();
+			}
+
+			bool try_acquire() noexcept
+			{
+				int32_t count = m_count.load(std::memory_order_relaxed);
+				while (count > 0)
+				{
+					if (m_count.compare_exchange_weak(
+							count, count - 1, std::memory_order_acquire, std::memory_order_relaxed))
+						return true;
+				}
+				return false;
+			}
 
 			template <class Rep, class Period> bool try_acquire_for(const std::chrono::duration<Rep, Period>& rel_time)
 			{
-				return try_acquire_for_usec(std::chrono::duration_cast<std::chrono::microseconds>(rel_time));
+				return try_acquire_for_usec(to_usec(rel_time));
 			}
 
 			template <class Clock, class Duration>
@@ -61,6 +96,7 @@ namespace cmsis
 				return try_acquire_for(rel_time);
 			}
 
+			/// Handle of the kernel semaphore used to block the threads, its count isn't the count of the semaphore.
 			native_handle_type native_handle() noexcept { return m_id; }
 
 			base_semaphore(const base_semaphore&) = delete;
@@ -68,9 +104,14 @@ namespace cmsis
 
 		private:
 			bool try_acquire_for_usec(std::chrono::microseconds usec);
+			void wait();
+			void wake(int32_t count);
+			[[noreturn]] void release_error();
 
 		private:
 			native_handle_type m_id; ///< sempahore identifier
+			std::atomic<int32_t> m_count;
+			int32_t m_max;
 		};
 	} // namespace internal
 
@@ -105,9 +146,29 @@ namespace cmsis
 
 		counting_semaphore(const counting_semaphore&) = delete;
 		counting_semaphore& operator=(const counting_semaphore&) = delete;
+
+	protected:
+		counting_semaphore(std::ptrdiff_t desired, void* cb_mem, size_t cb_size) :
+			internal::base_semaphore(max(), desired, cb_mem, cb_size)
+		{}
 	};
 
 	using binary_semaphore = counting_semaphore<1>;
+
+#ifdef CMSIS_STATIC_STORAGE
+	// Semaphore with the control block embedded in the object
+	template <std::ptrdiff_t LeastMaxValue = 0xFFFFFFFF>
+	class static_counting_semaphore : private internal::static_storage<CMSIS_SEMAPHORE_CB_SIZE>,
+									  public counting_semaphore<LeastMaxValue>
+	{
+	public:
+		explicit static_counting_semaphore(std::ptrdiff_t desired) :
+			counting_semaphore<LeastMaxValue>(desired, this->cb_mem, sizeof(this->cb_mem))
+		{}
+	};
+
+	using static_binary_semaphore = static_counting_semaphore<1>;
+#endif // CMSIS_STATIC_STORAGE
 } // namespace cmsis
 
 #if !defined(GLIBCXX_HAS_GTHREADS) && !defined(_GLIBCXX_HAS_GTHREADS)
@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CMSIS_SHARED_MEMORY_POOL_H_
+#define CMSIS_SHARED_MEMORY_POOL_H_
+
+#include "Memory.h"
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace cmsis
+{
+	template <class T> class shared_memory_pool;
+
+	namespace internal
+	{
+		// Block of a shared_memory_pool
+		template <class T> struct shared_pool_node
+		{
+			std::atomic<uint32_t> refs;
+			shared_memory_pool<T>* pool;
+			typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+			T* object() noexcept { return reinterpret_cast<T*>(&storage); }
+		};
+	} // namespace internal
+
+	// Shared pointer to an object of a shared_memory_pool. The reference count is in the pool block, before the
+	// object: copying or releasing a pointer never allocates. The last pointer destroys the object and frees its
+	// block, it can be released in an ISR if the destructor of T can. Unlike std::shared_ptr, it can't point to a base
+	// class or a member of the object.
+	template <class T> class shared_pool_ptr
+	{
+	public:
+		typedef T element_type;
+
+		constexpr shared_pool_ptr() noexcept :
+			m_node(nullptr)
+		{}
+		constexpr shared_pool_ptr(std::nullptr_t) noexcept :
+			m_node(nullptr)
+		{}
+		shared_pool_ptr(const shared_pool_ptr& other) noexcept :
+			m_node(other.m_node)
+		{
+			if (m_node)
+				m_node->refs.fetch_add(1, std::memory_order_relaxed);
+		}
+		shared_pool_ptr(shared_pool_ptr&& other) noexcept :
+			m_node(other.m_node)
+		{
+			other.m_node = nullptr;
+		}
+		~shared_pool_ptr() { reset(); }
+
+		shared_pool_ptr& operator=(const shared_pool_ptr& other) noexcept
+		{
+			shared_pool_ptr(other).swap(*this);
+			return *this;
+		}
+		shared_pool_ptr& operator=(shared_pool_ptr&& other) noexcept
+		{
+			shared_pool_ptr(std::move(other)).swap(*this);
+			return *this;
+		}
+
+		void reset() noexcept
+		{
+			if (m_node && m_node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				m_node->pool->release(m_node);
+			m_node = nullptr;
+		}
+
+		void swap(shared_pool_ptr& other) noexcept { std::swap(m_node, other.m_node); }
+
+		T* get() const noexcept { return m_node ? m_node->object() : nullptr; }
+		T& operator*() const noexcept { return *get(); }
+		T* operator->() const noexcept { return get(); }
+		explicit operator bool() const noexcept { return m_node != nullptr; }
+
+		/// Number of pointers to the object, 0 for an empty pointer.
+		long use_count() const noexcept { return m_node ? m_node->refs.load(std::memory_order_relaxed) : 0; }
+
+	private:
+		friend class shared_memory_pool<T>;
+		typedef internal::shared_pool_node<T> node;
+
+		explicit shared_pool_ptr(node* n) noexcept :
+			m_node(n)
+		{}
+
+	private:
+		node* m_node;
+	};
+
+	template <class T> bool operator==(const shared_pool_ptr<T>& lhs, const shared_pool_ptr<T>& rhs) noexcept
+	{
+		return lhs.get() == rhs.get();
+	}
+
+	template <class T> bool operator!=(const shared_pool_ptr<T>& lhs, const shared_pool_ptr<T>& rhs) noexcept
+	{
+		return lhs.get() != rhs.get();
+	}
+
+	template <class T> bool operator==(const shared_pool_ptr<T>& lhs, std::nullptr_t) noexcept
+	{
+		return !lhs;
+	}
+
+	template <class T> bool operator!=(const shared_pool_ptr<T>& lhs, std::nullptr_t) noexcept
+	{
+		return static_cast<bool>(lhs);
+	}
+
+	template <class T> void swap(shared_pool_ptr<T>& lhs, shared_pool_ptr<T>& rhs) noexcept
+	{
+		lhs.swap(rhs);
+	}
+
+	// Memory pool of shared objects: each block holds the reference count and the object, so make_shared never
+	// touches the heap. Don't destroy the pool before the last pointer to its objects.
+	template <class T> class shared_memory_pool : private internal::base_memory_pool
+	{
+	public:
+		typedef internal::base_memory_pool Base;
+		typedef typename Base::native_handle_type native_handle_type;
+		typedef size_t size_type;
+		typedef shared_pool_ptr<T> pointer;
+
+		explicit shared_memory_pool(size_type count) :
+			Base(count, sizeof(node))
+		{}
+		~shared_memory_pool() noexcept(false) = default;
+
+		/// Build an object in a block of the pool, waits for a free block.
+		template <class... Args> pointer make_shared(Args&&... args)
+		{
+			return make_shared_at(Base::allocate(1), std::forward<Args>(args)...);
+		}
+
+		/// make_shared without waiting: the pointer is empty when the pool is empty.
+		template <class... Args> pointer try_make_shared(Args&&... args)
+		{
+			return make_shared_at(Base::try_allocate(), std::forward<Args>(args)...);
+		}
+
+		/// make_shared waiting for rel_time at most: the pointer is empty on timeout.
+		template <class Rep, class Period, class... Args>
+		pointer make_shared_for(const std::chrono::duration<Rep, Period>& rel_time, Args&&... args)
+		{
+			return make_shared_at(Base::allocate_for(rel_time), std::forward<Args>(args)...);
+		}
+
+		size_type max_size() const noexcept { return Base::max_size(); }
+		size_type size() const noexcept { return Base::size(); }
+
+		/// Size of a block: the object and its reference count.
+		static constexpr size_t block_size() noexcept { return sizeof(node); }
+
+		native_handle_type native_handle() noexcept { return Base::native_handle(); }
+
+		shared_memory_pool(const shared_memory_pool&) = delete;
+		shared_memory_pool& operator=(const shared_memory_pool&) = delete;
+
+	protected:
+		shared_memory_pool(size_type count, void* cb_mem, size_t cb_size, void* mp_mem, size_t mp_size) :
+			Base(count, sizeof(node), cb_mem, cb_size, mp_mem, mp_size)
+		{}
+
+	private:
+		friend class shared_pool_ptr<T>;
+		typedef internal::shared_pool_node<T> node;
+
+		template <class... Args> pointer make_shared_at(void* p, Args&&... args)
+		{
+			if (!p)
+				return pointer();
+
+			node* n = static_cast<node*>(p);
+#ifdef __cpp_exceptions
+			try
+			{
+				::new (static_cast<void*>(n->object())) T(std::forward<Args>(args)...);
+			}
+			catch (...)
+			{
+				Base::deallocate(p);
+				throw;
+			}
+#else
+			::new (static_cast<void*>(n->object())) T(std::forward<Args>(args)...);
+#endif
+			n->refs.store(1, std::memory_order_relaxed);
+			n->pool = this;
+			return pointer(n);
+		}
+
+		// Called by the last pointer, which can't throw: a block refused by the kernel is a corruption of the pool
+		void release(node* n) noexcept
+		{
+			n->object()->~T();
+			bool freed = Base::try_deallocate(n);
+			assert(freed);
+			(void)freed;
+		}
+	};
+
+#ifdef CMSIS_STATIC_STORAGE
+	// Shared memory pool of N objects, with the control block and the blocks embedded in the object.
+	// It can't be moved.
+	template <class T, size_t N>
+	class static_shared_memory_pool
+		: private internal::static_storage<
+			  CMSIS_MEMORY_POOL_CB_SIZE,
+			  CMSIS_MEMORY_POOL_MEM_SIZE(N, shared_memory_pool<T>::block_size())>,
+		  public shared_memory_pool<T>
+	{
+	public:
+		static_shared_memory_pool() :
+			shared_memory_pool<T>(N, this->cb_mem, sizeof(this->cb_mem), this->mem, sizeof(this->mem))
+		{}
+
+		static_shared_memory_pool(const static_shared_memory_pool&) = delete;
+		static_shared_memory_pool& operator=(const static_shared_memory_pool&) = delete;
+	};
+#endif // CMSIS_STATIC_STORAGE
+} // namespace cmsis
+
+namespace sys
+{
+	template <class T> using shared_memory_pool = cmsis::shared_memory_pool<T>;
+	template <class T> using shared_pool_ptr = cmsis::shared_pool_ptr<T>;
+#ifdef CMSIS_STATIC_STORAGE
+	template <class T, size_t N> using static_shared_memory_pool = cmsis::static_shared_memory_pool<T, N>;
+#endif
+} // namespace sys
+
+#endif // CMSIS_SHARED_MEMORY_POOL_H_
@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CMSIS_SHARED_MUTEX_H_
+#define CMSIS_SHARED_MUTEX_H_
+
+#include "Mutex.h"
+#include "Timeout.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <shared_mutex>
+
+namespace cmsis
+{
+	/// Who goes first when a writer waits for the readers to leave.
+	enum class rw_preference
+	{
+		writers, // new readers wait for the writer: no writer starvation
+		readers  // new readers still come in: the writer waits for a time without any reader
+	};
+
+	namespace internal
+	{
+		// Reader-writer lock. The readers only touch a counter: when no writer is there, lock_shared() and
+		// unlock_shared() are a single atomic operation. The writers are serialized by a priority inheritance mutex,
+		// which also blocks the readers while a writer is there; the writer waits for the readers to leave on a
+		// thread flag reserved by the library. Can't be used from an ISR.
+		class base_shared_mutex
+		{
+		protected:
+			typedef cmsis::timed_mutex::native_handle_type native_handle_type;
+
+			base_shared_mutex(rw_preference pref, const char* name);
+			~base_shared_mutex() = default;
+
+			void lock();
+			void unlock();
+			bool try_lock();
+
+			void lock_shared()
+			{
+				if (m_state.fetch_add(1, std::memory_order_acquire) & m_blocking)
+					lock_shared_slow();
+			}
+
+			void unlock_shared()
+			{
+				// The last reader wakes up the waiting writer
+				if (m_state.fetch_sub(1, std::memory_order_acq_rel) - 1 == writer_waiting)
+					wake();
+			}
+
+			bool try_lock_shared() noexcept
+			{
+				uint32_t state = m_state.load(std::memory_order_relaxed);
+				while (!(state & m_blocking))
+				{
+					if (m_state.compare_exchange_weak(
+							state, state + 1, std::memory_order_acquire, std::memory_order_relaxed))
+						return true;
+				}
+				return false;
+			}
+
+			template <class Rep, class Period> bool try_lock_for(const std::chrono::duration<Rep, Period>& rel_time)
+			{
+				return try_lock_for_usec(to_usec(rel_time));
+			}
+
+			template <class Clock, class Duration>
+			bool try_lock_until(const std::chrono::time_point<Clock, Duration>& abs_time)
+			{
+				auto rel_time = abs_time - Clock::now();
+				if (rel_time < std::chrono::microseconds::zero())
+					return false;
+
+				return try_lock_for(rel_time);
+			}
+
+			template <class Rep, class Period>
+			bool try_lock_shared_for(const std::chrono::duration<Rep, Period>& rel_time)
+			{
+				return try_lock_shared() || try_lock_shared_for_usec(to_usec(rel_time));
+			}
+
+			template <class Clock, class Duration>
+			bool try_lock_shared_until(const std::chrono::time_point<Clock, Duration>& abs_time)
+			{
+				auto rel_time = abs_time - Clock::now();
+				if (rel_time < std::chrono::microseconds::zero())
+					return try_lock_shared();
+
+				return try_lock_shared_for(rel_time);
+			}
+
+			/// Handle of the kernel mutex that serializes the writers.
+			native_handle_type native_handle() noexcept { return m_writers.native_handle(); }
+
+			base_shared_mutex(const base_shared_mutex&) = delete;
+			base_shared_mutex& operator=(const base_shared_mutex&) = delete;
+
+		private:
+			// The low bits of the state count the readers
+			enum state_bits : uint32_t
+			{
+				writer_waiting = 0x80000000, // a writer waits for the readers to leave
+				writer_active = 0x40000000   // a writer owns the lock
+			};
+
+			void lock_shared_slow();
+			bool try_lock_for_usec(std::chrono::microseconds usec);
+			bool try_lock_shared_for_usec(std::chrono::microseconds usec);
+			bool wait_readers(uint32_t timeout);
+			void wake() noexcept;
+
+		private:
+			std::atomic<uint32_t> m_state;
+			std::atomic<void*> m_writer; // thread waiting for the readers to leave
+			const uint32_t m_blocking;   // bits that send a new reader to the slow path
+			cmsis::timed_mutex m_writers;
+		};
+	} // namespace internal
+
+	// STL like implementation, usable with std::unique_lock and std::shared_lock
+	class shared_mutex : private internal::base_shared_mutex
+	{
+	public:
+		typedef internal::base_shared_mutex::native_handle_type native_handle_type;
+
+		shared_mutex() :
+			internal::base_shared_mutex(rw_preference::writers, "shared_mutex")
+		{}
+		explicit shared_mutex(rw_preference pref, const char* name = "shared_mutex") :
+			internal::base_shared_mutex(pref, name)
+		{}
+		~shared_mutex() = default;
+
+		void lock() { internal::base_shared_mutex::lock(); }
+		void unlock() { internal::base_shared_mutex::unlock(); }
+		bool try_lock() { return internal::base_shared_mutex::try_lock(); }
+
+		void lock_shared() { internal::base_shared_mutex::lock_shared(); }
+		void unlock_shared() { internal::base_shared_mutex::unlock_shared(); }
+		bool try_lock_shared() noexcept { return internal::base_shared_mutex::try_lock_shared(); }
+
+		native_handle_type native_handle() noexcept { return internal::base_shared_mutex::native_handle(); }
+
+		shared_mutex(const shared_mutex&) = delete;
+		shared_mutex& operator=(const shared_mutex&) = delete;
+	};
+
+	class shared_timed_mutex : private internal::base_shared_mutex
+	{
+	public:
+		typedef internal::base_shared_mutex::native_handle_type native_handle_type;
+
+		shared_timed_mutex() :
+			internal::base_shared_mutex(rw_preference::writers, "shared_timed_mutex")
+		{}
+		explicit shared_timed_mutex(rw_preference pref, const char* name = "shared_timed_mutex") :
+			internal::base_shared_mutex(pref, name)
+		{}
+		~shared_timed_mutex() = default;
+
+		void lock() { internal::base_shared_mutex::lock(); }
+		void unlock() { internal::base_shared_mutex::unlock(); }
+		bool try_lock() { return internal::base_shared_mutex::try_lock(); }
+
+		template <class Rep, class Period> bool try_lock_for(const std::chrono::duration<Rep, Period>& rel_time)
+		{
+			return internal::base_shared_mutex::try_lock_for(rel_time);
+		}
+
+		template <class Clock, class Duration>
+		bool try_lock_until(const std::chrono::time_point<Clock, Duration>& abs_time)
+		{
+			return internal::base_shared_mutex::try_lock_until(abs_time);
+		}
+
+		void lock_shared() { internal::base_shared_mutex::lock_shared(); }
+		void unlock_shared() { internal::base_shared_mutex::unlock_shared(); }
+		bool try_lock_shared() noexcept { return internal::base_shared_mutex::try_lock_shared(); }
+
+		template <class Rep, class Period>
+		bool try_lock_shared_for(const std::chrono::duration<Rep, Period>& rel_time)
+		{
+			return internal::base_shared_mutex::try_lock_shared_for(rel_time);
+		}
+
+		template <class Clock, class Duration>
+		bool try_lock_shared_until(const std::chrono::time_point<Clock, Duration>& abs_time)
+		{
+			return internal::base_shared_mutex::try_lock_shared_until(abs_time);
+		}
+
+		native_handle_type native_handle() noexcept { return internal::base_shared_mutex::native_handle(); }
+
+		shared_timed_mutex(const shared_timed_mutex&) = delete;
+		shared_timed_mutex& operator=(const shared_timed_mutex&) = delete;
+	};
+} // namespace cmsis
+
+namespace sys
+{
+	using rw_preference = cmsis::rw_preference;
+	using shared_mutex = cmsis::shared_mutex;
+	using shared_timed_mutex = cmsis::shared_timed_mutex;
+} // namespace sys
+
+#if !defined(GLIBCXX_HAS_GTHREADS) && !defined(_GLIBCXX_HAS_GTHREADS)
+namespace std
+{
+	using shared_mutex = cmsis::shared_mutex;
+	using shared_timed_mutex = cmsis::shared_timed_mutex;
+} // namespace std
+#endif
+
+#endif // CMSIS_SHARED_MUTEX_H_
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CMSIS_SLAB_H_
+#define CMSIS_SLAB_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cmsis
+{
+	/// Statistics of a size class of the slab allocator. The last entry counts the blocks of the heap.
+	struct slab_stats
+	{
+		size_t block_size;    // 0 for the heap
+		size_t capacity;      // number of blocks, 0 for the heap
+		size_t in_use;        // allocated blocks
+		size_t peak;          // highest in_use
+		uint32_t allocations; // successful allocations
+		uint32_t overflows;   // requests of this class that found it full
+	};
+
+	// Allocator of small blocks in size classes. Each class is a memory pool of fixed-size blocks in a static arena,
+	// a request goes to the smallest class that fits, or to the next ones when it is full. Larger requests, and
+	// those made before osKernelInitialize, go to the heap: the RTX global memory, or malloc on the host.
+	// The global operators new and delete use it when the library is built with the CMSIS_CPP_GLOBAL_NEW option.
+	namespace slab
+	{
+		/// Allocate size bytes, aligned for any type. Returns nullptr when there is no memory left.
+		void* allocate(size_t size) noexcept;
+
+		/// Free a block of allocate(), nullptr is ignored. A block of a size class can be freed from an ISR.
+		void deallocate(void* p) noexcept;
+
+		/// Copy the statistics of the size classes, then of the heap, into stats. Returns the number of entries,
+		/// which can be more than max.
+		size_t collect(slab_stats* stats, size_t max) noexcept;
+	} // namespace slab
+} // namespace cmsis
+
+#endif // CMSIS_SLAB_H_
@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CPP_CMSIS_SPSC_CHANNEL_H_
+#define CPP_CMSIS_SPSC_CHANNEL_H_
+
+#include "MessageQueue.h"
+#include "OSException.h"
+#include "ThreadFlag.h"
+#include "Timeout.h"
+#include "cmsis_os2.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+/// Size of the cache line: the producer and consumer indexes never share one.
+#ifndef CMSIS_CACHE_LINE_SIZE
+#define CMSIS_CACHE_LINE_SIZE 64
+#endif
+
+namespace cmsis
+{
+	namespace internal
+	{
+		/// Convert a wait time to kernel ticks, a negative wait time is an error.
+		inline uint32_t spsc_ticks(std::chrono::microseconds usec)
+		{
+			if (usec < std::chrono::microseconds::zero())
+#ifdef __cpp_exceptions
+				throw std::system_error(osErrorParameter, os_category(), "spsc_channel: negative timer");
+#else
+				std::terminate();
+#endif
+
+			return to_ticks(usec);
+		}
+
+		/// Block the calling thread until ready() returns true, or the timeout expires.
+		/// The thread publishes itself in waiter, the other side wakes it with spsc_notify.
+		template <class Ready> bool spsc_wait(std::atomic<osThreadId_t>& waiter, uint32_t timeout, Ready ready)
+		{
+			uint32_t start = osKernelGetTickCount();
+			for (;;)
+			{
+				waiter.store(osThreadGetId(), std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (ready())
+				{
+					waiter.store(nullptr, std::memory_order_relaxed);
+					return true;
+				}
+
+				uint32_t remaining = osWaitForever;
+				if (timeout != osWaitForever)
+				{
+					uint32_t elapsed = osKernelGetTickCount() - start;
+					if (elapsed >= timeout)
+					{
+						waiter.store(nullptr, std::memory_order_relaxed);
+						return false;
+					}
+					remaining = timeout - elapsed;
+				}
+
+				// A flag left by an earlier notification only causes one more turn of the loop
+				osThreadFlagsWait(spsc_channel_flag, osFlagsWaitAny, remaining);
+			}
+		}
+
+		/// Wake up the thread blocked on the other side, if any. Callable from an ISR.
+		inline void spsc_notify(std::atomic<osThreadId_t>& waiter) noexcept
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (waiter.load(std::memory_order_relaxed) == nullptr)
+				return;
+
+			osThreadId_t thread = waiter.exchange(nullptr, std::memory_order_relaxed);
+			if (thread)
+				osThreadFlagsSet(thread, spsc_channel_flag);
+		}
+	} // namespace internal
+
+	/// Lock-free bounded channel between exactly one producer and one consumer.
+	/// The producer may be an ISR (try_put, or put with a zero wait time). Neither side enters the kernel while
+	/// the ring is neither empty nor full: the consumer blocks on a thread flag only when the ring is empty,
+	/// the producer only when it is full. Messages are delivered in FIFO order.
+	template <class T, size_t N> class spsc_channel
+	{
+		static_assert(N > 0 && (N & (N - 1)) == 0, "The capacity must be a power of two");
+		static_assert(std::is_nothrow_move_constructible<T>::value, "Only support nothrow move constructible types");
+
+	public:
+		typedef T element_type;
+
+		spsc_channel() noexcept :
+			m_tail(0),
+			m_head_cache(0),
+			m_head(0),
+			m_tail_cache(0),
+			m_get_waiter(nullptr),
+			m_put_waiter(nullptr)
+		{}
+		spsc_channel(const spsc_channel&) = delete;
+		~spsc_channel() { clear(); }
+
+		spsc_channel& operator=(const spsc_channel&) = delete;
+
+		//  ==== Producer side ====
+
+		/// Push a message if the ring is not full. Never blocks, callable from an ISR.
+		/// If the construction of the message throws, the ring is left unchanged.
+		template <class U> bool try_put(U&& data) noexcept(std::is_nothrow_constructible<T, U&&>::value)
+		{
+			size_t tail = m_tail.load(std::memory_order_relaxed);
+			if (tail - m_head_cache == N)
+			{
+				m_head_cache = m_head.load(std::memory_order_acquire);
+				if (tail - m_head_cache == N)
+					return false;
+			}
+
+			::new (slot(tail)) T(std::forward<U>(data));
+			m_tail.store(tail + 1, std::memory_order_release);
+			internal::spsc_notify(m_get_waiter);
+			return true;
+		}
+
+		void put(const element_type& data, uint8_t priority = 0) { put_value(data, priority); }
+		void put(element_type&& data, uint8_t priority = 0) { put_value(std::move(data), priority); }
+
+		template <class Rep, class Period>
+		mq_status put(const element_type& data, uint8_t priority, const std::chrono::duration<Rep, Period>& wait_time)
+		{
+			return put_value(data, priority, wait_time);
+		}
+
+		template <class Rep, class Period>
+		mq_status put(element_type&& data, uint8_t priority, const std::chrono::duration<Rep, Period>& wait_time)
+		{
+			return put_value(std::move(data), priority, wait_time);
+		}
+
+		template <class Rep, class Period>
+		mq_status put(const element_type& data, const std::chrono::duration<Rep, Period>& wait_time)
+		{
+			return put_value(data, 0, wait_time);
+		}
+
+		template <class Rep, class Period>
+		mq_status put(element_type&& data, const std::chrono::duration<Rep, Period>& wait_time)
+		{
+			return put_value(std::move(data), 0, wait_time);
+		}
+
+		//  ==== Consumer side ====
+
+		/// Pop a message if the ring is not empty. Never blocks.
+		/// If the move assignment throws, the message stays in the ring.
+		bool try_get(element_type& data) noexcept(
+			std::is_nothrow_move_assignable<T>::value && std::is_nothrow_destructible<T>::value)
+		{
+			size_t head = m_head.load(std::memory_order_relaxed);
+			if (head == m_tail_cache)
+			{
+				m_tail_cache = m_tail.load(std::memory_order_acquire);
+				if (head == m_tail_cache)
+					return false;
+			}
+
+			T* p = slot(head);
+			data = std::move(*p);
+			p->~T();
+			m_head.store(head + 1, std::memory_order_release);
+			internal::spsc_notify(m_put_waiter);
+			return true;
+		}
+
+		element_type get()
+		{
+			element_type data;
+			get(data);
+			return data;
+		}
+
+		void get(element_type& data)
+		{
+			while (!try_get(data))
+				internal::spsc_wait(m_get_waiter, osWaitForever, [this]() { return !empty(); });
+		}
+
+		template <class Rep, class Period>
+		mq_status get(element_type& data, const std::chrono::duration<Rep, Period>& wait_time)
+		{
+			if (try_get(data))
+				return mq_status::no_timeout;
+
+			uint32_t timeout = internal::spsc_ticks(internal::to_usec(wait_time));
+			if (timeout == 0)
+				return mq_status::empty;
+
+			if (!internal::spsc_wait(m_get_waiter, timeout, [this]() { return !empty(); }))
+				return mq_status::timeout;
+
+			try_get(data);
+			return mq_status::no_timeout;
+		}
+
+		/// Drop all the messages. Consumer side only.
+		void clear() noexcept
+		{
+			size_t head = m_head.load(std::memory_order_relaxed);
+			size_t tail = m_tail.load(std::memory_order_acquire);
+			for (; head != tail; ++head)
+				slot(head)->~T();
+
+			m_head.store(head, std::memory_order_release);
+			internal::spsc_notify(m_put_waiter);
+		}
+
+		//  ==== Both sides ====
+
+		bool empty() const noexcept { return size() == 0; }
+		bool full() const noexcept { return size() == N; }
+		size_t size() const noexcept
+		{
+			return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+		}
+		static constexpr size_t capacity() noexcept { return N; }
+
+	private:
+		T* slot(size_t index) noexcept { return reinterpret_cast<T*>(&m_buffer[index & (N - 1)]); }
+
+		/// The priority is accepted for source compatibility with message_queue: a channel is FIFO.
+		template <class U> void put_value(U&& data, uint8_t)
+		{
+			// try_put only consumes the data when it succeeds
+			while (!try_put(std::forward<U>(data)))
+				internal::spsc_wait(m_put_waiter, osWaitForever, [this]() { return !full(); });
+		}
+
+		template <class U, class Rep, class Period>
+		mq_status put_value(U&& data, uint8_t, const std::chrono::duration<Rep, Period>& wait_time)
+		{
+			if (try_put(std::forward<U>(data)))
+				return mq_status::no_timeout;
+
+			uint32_t timeout = internal::spsc_ticks(internal::to_usec(wait_time));
+			if (timeout == 0)
+				return mq_status::full;
+
+			if (!internal::spsc_wait(m_put_waiter, timeout, [this]() { return !full(); }))
+				return mq_status::timeout;
+
+			try_put(std::forward<U>(data));
+			return mq_status::no_timeout;
+		}
+
+	private:
+		// Producer line: the write index, and the last read index seen by the producer
+		alignas(CMSIS_CACHE_LINE_SIZE) std::atomic<size_t> m_tail;
+		size_t m_head_cache;
+
+		// Consumer line: the read index, and the last write index seen by the consumer
+		alignas(CMSIS_CACHE_LINE_SIZE) std::atomic<size_t> m_head;
+		size_t m_tail_cache;
+
+		// Blocked threads, written by their own side only
+		alignas(CMSIS_CACHE_LINE_SIZE) std::atomic<osThreadId_t> m_get_waiter;
+		std::atomic<osThreadId_t> m_put_waiter;
+
+		alignas(CMSIS_CACHE_LINE_SIZE) typename std::aligned_storage<sizeof(T), alignof(T)>::type m_buffer[N];
+	};
+} // namespace cmsis
+
+namespace sys
+{
+	template <class T, size_t N> using spsc_channel = cmsis::spsc_channel<T, N>;
+}
+
+#endif // CPP_CMSIS_SPSC_CHANNEL_H_
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CMSIS_STATIC_STORAGE_H_
+#define CMSIS_STATIC_STORAGE_H_
+
+#include <cstddef>
+
+// Control block and data sizes of the kernel objects, for the static variants of the classes.
+// They are given by the RTOS implementation. For another RTOS, define all the CMSIS_xxx_SIZE macros.
+#if defined(RTE_CMSIS_RTOS2_RTX5)
+#include "rtx_os.h"
+
+#define CMSIS_THREAD_CB_SIZE        osRtxThreadCbSize
+#define CMSIS_EVENT_FLAGS_CB_SIZE   osRtxEventFlagsCbSize
+#define CMSIS_MUTEX_CB_SIZE         osRtxMutexCbSize
+#define CMSIS_SEMAPHORE_CB_SIZE     osRtxSemaphoreCbSize
+#define CMSIS_MEMORY_POOL_CB_SIZE   osRtxMemoryPoolCbSize
+#define CMSIS_MESSAGE_QUEUE_CB_SIZE osRtxMessageQueueCbSize
+
+#define CMSIS_MEMORY_POOL_MEM_SIZE(block_count, block_size)  osRtxMemoryPoolMemSize(block_count, block_size)
+#define CMSIS_MESSAGE_QUEUE_MEM_SIZE(msg_count, msg_size)    osRtxMessageQueueMemSize(msg_count, msg_size)
+#elif defined(CMSIS_OS2_HOST)
+#include "host_os.h"
+
+#define CMSIS_THREAD_CB_SIZE        osHostThreadCbSize
+#define CMSIS_EVENT_FLAGS_CB_SIZE   osHostEventFlagsCbSize
+#define CMSIS_MUTEX_CB_SIZE         osHostMutexCbSize
+#define CMSIS_SEMAPHORE_CB_SIZE     osHostSemaphoreCbSize
+#define CMSIS_MEMORY_POOL_CB_SIZE   osHostMemoryPoolCbSize
+#define CMSIS_MESSAGE_QUEUE_CB_SIZE osHostMessageQueueCbSize
+
+#define CMSIS_MEMORY_POOL_MEM_SIZE(block_count, block_size)  osHostMemoryPoolMemSize(block_count, block_size)
+#define CMSIS_MESSAGE_QUEUE_MEM_SIZE(msg_count, msg_size)    osHostMessageQueueMemSize(msg_count, msg_size)
+#endif
+
+#if defined(CMSIS_THREAD_CB_SIZE)
+#define CMSIS_STATIC_STORAGE 1 // static variants are available
+#endif
+
+namespace cmsis
+{
+	namespace internal
+	{
+		/// Memory of a kernel object embedded in a C++ object: control block, and data (queue, pool or stack).
+		/// It is inherited first, so that it is built before and destroyed after the kernel object.
+		template <size_t CbSize, size_t MemSize = 0> struct static_storage
+		{
+			alignas(std::max_align_t) unsigned char cb_mem[CbSize];
+			alignas(std::max_align_t) unsigned char mem[MemSize];
+		};
+
+		template <size_t CbSize> struct static_storage<CbSize, 0>
+		{
+			alignas(std::max_align_t) unsigned char cb_mem[CbSize];
+		};
+	} // namespace internal
+} // namespace cmsis
+
+#endif // CMSIS_STATIC_STORAGE_H_
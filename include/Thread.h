@@ -28,9 +28,14 @@
 #ifndef CPP_CMSIS_THREAD_H_
 #define CPP_CMSIS_THREAD_H_
 
+#include "StaticStorage.h"
+#include "Timeout.h"
 #include <chrono>
+#include <cstddef>
+#include <exception>
 #include <functional>
 #include <memory>
+#include <new>
 
 namespace cmsis
 {
@@ -74,6 +79,8 @@ namespace cmsis
 			size_t stack_size; // size of stack (0 as the default is no memory provided)
 			size_t priority;   // initial thread priority (default: osPriorityNormal)
 			const char* name;  // name of the thread
+			void* cb_mem;      // memory for the control block (NULL to allocate it from a fixed-size memory)
+			size_t cb_size;    // size of the control block memory
 		};
 
 		thread() noexcept;
@@ -82,8 +89,10 @@ namespace cmsis
 
 		template <typename _Callable, typename... _Args>
 		thread(const attributes& attr, _Callable&& __f, _Args&&... __args) :
-			thread(attr, make_routine(std::bind(std::forward<_Callable>(__f), std::forward<_Args>(__args)...)))
-		{}
+			m_pThread(nullptr)
+		{
+			create(attr, std::bind(std::forward<_Callable>(__f), std::forward<_Args>(__args)...));
+		}
 
 		~thread();
 
@@ -118,34 +127,43 @@ namespace cmsis
 		size_t stack_size() const noexcept;
 		size_t stack_space() const noexcept;
 
-		// Simple base type that the templatized, derived class containing an arbitrary functor can be converted to and
-		// called.
-		struct CallableBase
+	private:
+		friend class thread_impl;
+
+		// Type erased operations on the routine, which is built in place in the storage of the control block
+		struct routine_ops
 		{
-			virtual ~CallableBase() = default;
-			virtual void run() = 0;
+			void (*run)(void*);
+			void (*destroy)(void*);
 		};
 
-	private:
-		template <typename _Callable> struct CallableImpl : public CallableBase
+		template <typename _Routine> static void run_routine(void* __p) { (*static_cast<_Routine*>(__p))(); }
+		template <typename _Routine> static void destroy_routine(void* __p)
 		{
-			explicit CallableImpl(_Callable&& __f) :
-				m_func(std::forward<_Callable>(__f))
-			{}
-			virtual void run() override { m_func(); }
-			_Callable m_func;
-		};
+			static_cast<_Routine*>(__p)->~_Routine();
+		}
 
-		template <typename _Callable> std::unique_ptr<CallableBase> make_routine(_Callable&& __f)
+		template <typename _Routine> void create(const attributes& attr, _Routine&& __r)
 		{
-			// Create and allocate full data structure, not base.
-			return std::unique_ptr<CallableBase>(new CallableImpl<_Callable>(std::forward<_Callable>(__f)));
+			typedef typename std::decay<_Routine>::type routine_type;
+			static_assert(alignof(routine_type) <= alignof(std::max_align_t), "over-aligned thread routine");
+			static const routine_ops ops = {&run_routine<routine_type>, &destroy_routine<routine_type>};
+
+			// If the routine construction or the thread creation fails, m_pThread gives back the control block
+			::new (reserve(sizeof(routine_type))) routine_type(std::forward<_Routine>(__r));
+			start(attr, &ops);
 		}
 
-		thread(const attributes& attr, std::unique_ptr<CallableBase> base);
+		void* reserve(size_t size);
+		void start(const attributes& attr, const routine_ops* ops);
+
+		struct impl_release
+		{
+			void operator()(thread_impl* impl) const noexcept;
+		};
 
 	private:
-		std::unique_ptr<thread_impl> m_pThread;
+		std::unique_ptr<thread_impl, impl_release> m_pThread;
 	};
 
 	inline void swap(thread& __x, thread& __y) noexcept
@@ -153,6 +171,73 @@ namespace cmsis
 		__x.swap(__y);
 	}
 
+#ifdef CMSIS_STATIC_STORAGE
+	// Thread with the control block and the stack embedded in the object. The thread must be joined before the
+	// destruction of the object: it can't be detached, nor moved.
+	template <size_t StackSize> class static_thread : private internal::static_storage<CMSIS_THREAD_CB_SIZE, StackSize>,
+													  private thread
+	{
+		static_assert(StackSize != 0 && StackSize % 8 == 0, "the stack size must be a multiple of 8 bytes");
+
+	public:
+		using thread::attributes;
+		using thread::id;
+		using thread::native_handle_type;
+
+		static_thread() noexcept = default;
+		static_thread(const static_thread&) = delete;
+
+		template <typename _Callable, typename... _Args>
+		static_thread(const attributes& attr, _Callable&& __f, _Args&&... __args) :
+			thread(
+				storage_attributes(attr, this->cb_mem, sizeof(this->cb_mem), this->mem, sizeof(this->mem)),
+				std::forward<_Callable>(__f),
+				std::forward<_Args>(__args)...)
+		{}
+
+		~static_thread() = default;
+
+		static_thread& operator=(const static_thread&) = delete;
+
+		/// Start a thread in the storage of a default constructed or joined object.
+		template <typename _Callable, typename... _Args>
+		void start(const attributes& attr, _Callable&& __f, _Args&&... __args)
+		{
+			if (joinable())
+				std::terminate();
+
+			thread::operator=(thread(
+				storage_attributes(attr, this->cb_mem, sizeof(this->cb_mem), this->mem, sizeof(this->mem)),
+				std::forward<_Callable>(__f),
+				std::forward<_Args>(__args)...));
+		}
+
+		using thread::get_id;
+		using thread::join;
+		using thread::joinable;
+		using thread::native_handle;
+
+		using thread::is_blocked;
+		using thread::name;
+		using thread::priority;
+		using thread::resume;
+		using thread::stack_size;
+		using thread::stack_space;
+		using thread::suspend;
+
+	private:
+		static attributes
+		storage_attributes(attributes attr, void* cb_mem, size_t cb_size, void* stack_mem, size_t stack_size) noexcept
+		{
+			attr.cb_mem = cb_mem;
+			attr.cb_size = cb_size;
+			attr.stack_mem = stack_mem;
+			attr.stack_size = stack_size;
+			return attr;
+		}
+	};
+#endif // CMSIS_STATIC_STORAGE
+
 	inline bool operator!=(thread::id __x, thread::id __y) noexcept
 	{
 		return !(__x == __y);
@@ -195,10 +280,18 @@ namespace cmsis
 		/// Returns the id of the current thread.
 		thread::id get_id();
 
-		/// sleep_for
+		/// sleep_for: the sleep is rounded up to the kernel ticks, it is never shorter than sleep_duration.
 		template <class Rep, class Period> void sleep_for(const std::chrono::duration<Rep, Period>& sleep_duration)
 		{
-			internal::sleep_for_usec(std::chrono::duration_cast<std::chrono::microseconds>(sleep_duration));
+			internal::sleep_for_usec(cmsis::internal::to_usec(sleep_duration));
+		}
+
+		/// Sleep with a sub-tick precision. The kernel sleeps for the whole ticks but the last one, then the thread
+		/// spins on the system timer: it keeps the core busy for up to two ticks.
+		template <class Rep, class Period>
+		void precise_sleep_for(const std::chrono::duration<Rep, Period>& sleep_duration)
+		{
+			cmsis::internal::precise_sleep_for(cmsis::internal::to_nsec(sleep_duration));
 		}
 
 		/// sleep_until
@@ -219,12 +312,29 @@ namespace cmsis
 				now = Clock::now();
 			}
 		}
+
+		/// sleep_until with a sub-tick precision, see precise_sleep_for.
+		template <class Clock, class Duration>
+		void precise_sleep_until(const std::chrono::time_point<Clock, Duration>& sleep_time)
+		{
+			auto now = Clock::now();
+			while (now < sleep_time)
+			{
+				precise_sleep_for(sleep_time - now);
+				if (Clock::is_steady)
+					return;
+				now = Clock::now();
+			}
+		}
 	} // namespace this_thread
 } // namespace cmsis
 
 namespace sys
 {
 	using thread = cmsis::thread;
+#ifdef CMSIS_STATIC_STORAGE
+	template <size_t StackSize> using static_thread = cmsis::static_thread<StackSize>;
+#endif
 	namespace this_thread = cmsis::this_thread;
 } // namespace sys
 
@@ -29,10 +29,30 @@
 #define CPP_CMSIS_THREADFLAG_H_
 
 #include "Thread.h"
+#include "Timeout.h"
 #include "WaitFlag.h"
 
 namespace cmsis
 {
+	namespace internal
+	{
+		/// Thread flags reserved by the library to wake up its own waiters. The application must not use them.
+		enum reserved_thread_flags : uint32_t
+		{
+			condition_variable_flag = 0x40000000,
+			spsc_channel_flag = 0x20000000,
+			adaptive_mutex_flag = 0x10000000,
+			timer_wheel_flag = 0x08000000,
+			call_once_flag = 0x04000000,
+			shared_mutex_flag = 0x02000000,
+			future_flag = 0x01000000,
+			thread_pool_flag = 0x00800000
+		};
+
+		/// All the reserved thread flags: this_thread::flags::get() and clear() leave them out.
+		constexpr uint32_t reserved_thread_flags_mask = 0x7F800000;
+	} // namespace internal
+
 	struct thread_flags
 	{
 		typedef uint32_t mask_type;
@@ -56,7 +76,10 @@ namespace cmsis
 			static mask_type set(mask_type mask);
 			static mask_type get();
 
-			static mask_type clear(mask_type mask = static_cast<mask_type>(0x7FFFFFFF));
+			/// The flags which the application can use.
+			static constexpr mask_type user_mask = 0x7FFFFFFF & ~cmsis::internal::reserved_thread_flags_mask;
+
+			static mask_type clear(mask_type mask = user_mask);
 			static mask_type wait(mask_type mask, wait_flag flg = wait_flag::any);
 
 			template <class Rep, class Period>
@@ -66,7 +89,7 @@ namespace cmsis
 				const std::chrono::duration<Rep, Period>& rel_time,
 				mask_type& flagValue)
 			{
-				return wait_for_usec(mask, flg, rel_time, flagValue);
+				return wait_for_usec(mask, flg, cmsis::internal::to_usec(rel_time), flagValue);
 			}
 
 			template <class Rep, class Period>
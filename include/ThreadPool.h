@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CMSIS_THREAD_POOL_H_
+#define CMSIS_THREAD_POOL_H_
+
+#include "Memory.h"
+#include "MessageQueue.h"
+#include "Thread.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/// Default number of jobs that can be submitted and not finished yet.
+#ifndef CMSIS_THREAD_POOL_JOBS
+#define CMSIS_THREAD_POOL_JOBS 64
+#endif
+
+/// Size of a callable built in place in a job. A larger callable is copied on the heap.
+#ifndef CMSIS_THREAD_POOL_JOB_SIZE
+#define CMSIS_THREAD_POOL_JOB_SIZE 48
+#endif
+
+/// Capacity of the deque of each worker, a power of two. A worker that submits to a full deque falls back to the
+/// shared queue.
+#ifndef CMSIS_THREAD_POOL_DEQUE_SIZE
+#define CMSIS_THREAD_POOL_DEQUE_SIZE 64
+#endif
+
+namespace cmsis
+{
+	namespace internal
+	{
+		// Block of the job pool: the callable, and the function that runs then destroys it. The blocks of a kernel
+		// memory pool are only aligned for a pointer.
+		struct pool_job
+		{
+			void (*execute)(void*);
+			void* storage[(CMSIS_THREAD_POOL_JOB_SIZE + sizeof(void*) - 1) / sizeof(void*)];
+		};
+	} // namespace internal
+
+	// Fixed set of worker threads running the submitted jobs. Each worker has its own deque (Chase-Lev): a job
+	// submitted by a worker goes to its own deque, a job submitted by another thread to a shared queue, and a worker
+	// without work steals the oldest jobs of the others. Idle workers park on a thread flag reserved by the library.
+	// The jobs come from a fixed pool: submit() doesn't allocate when the callable fits in a job. The destructor runs
+	// the jobs already submitted, then stops the workers. A job must not throw, and can't wait for another job on a
+	// pool with a single worker.
+	class thread_pool
+	{
+	public:
+		/// Start workers threads with the attributes attr (without any stack or control block memory: each worker
+		/// gets its own), for at most jobs pending jobs.
+		explicit thread_pool(
+			size_t workers,
+			const thread::attributes& attr = thread::attributes(),
+			size_t jobs = CMSIS_THREAD_POOL_JOBS);
+		~thread_pool();
+
+		/// Queue a call of f(), waits for a free job when they are all pending.
+		template <class F> void submit(F&& f) { enqueue(build(m_jobs.allocate(), std::forward<F>(f))); }
+
+		/// Queue a call of f(), returns false when all the jobs are pending.
+		template <class F> bool try_submit(F&& f)
+		{
+			internal::pool_job* job = m_jobs.try_allocate();
+			if (job == nullptr)
+				return false;
+
+			enqueue(build(job, std::forward<F>(f)));
+			return true;
+		}
+
+		/// Number of worker threads.
+		size_t size() const noexcept { return m_count; }
+
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+
+	private:
+		struct worker;
+
+		template <class F> static void execute_in_place(void* p)
+		{
+			F& f = *static_cast<F*>(p);
+			f();
+			f.~F();
+		}
+
+		template <class F> static void execute_on_heap(void* p)
+		{
+			std::unique_ptr<F> f(*static_cast<F**>(p));
+			(*f)();
+		}
+
+		template <class F> internal::pool_job* build(internal::pool_job* job, F&& f)
+		{
+			typedef typename std::decay<F>::type callable_type;
+			constexpr bool in_place = sizeof(callable_type) <= sizeof(internal::pool_job::storage) &&
+									  alignof(callable_type) <= alignof(void*);
+#ifdef __cpp_exceptions
+			try
+			{
+				construct(job, std::forward<F>(f), std::integral_constant<bool, in_place>());
+			}
+			catch (...)
+			{
+				m_jobs.deallocate(job, 1);
+				throw;
+			}
+#else
+			construct(job, std::forward<F>(f), std::integral_constant<bool, in_place>());
+#endif
+			return job;
+		}
+
+		template <class F> static void construct(internal::pool_job* job, F&& f, std::true_type)
+		{
+			typedef typename std::decay<F>::type callable_type;
+			::new (static_cast<void*>(job->storage)) callable_type(std::forward<F>(f));
+			job->execute = &execute_in_place<callable_type>;
+		}
+
+		template <class F> static void construct(internal::pool_job* job, F&& f, std::false_type)
+		{
+			typedef typename std::decay<F>::type callable_type;
+			*reinterpret_cast<callable_type**>(job->storage) = new callable_type(std::forward<F>(f));
+			job->execute = &execute_on_heap<callable_type>;
+		}
+
+		void stop() noexcept;
+		void enqueue(internal::pool_job* job);
+		void run_worker(size_t index);
+		internal::pool_job* find_job(size_t index);
+		void park(worker& self);
+		bool has_work() const;
+		void wake_one() noexcept;
+
+	private:
+		memory_pool<internal::pool_job> m_jobs;
+		message_queue<internal::pool_job*> m_shared; // jobs submitted by the other threads
+		std::unique_ptr<worker[]> m_workers;
+		const size_t m_count;
+		std::atomic<uint32_t> m_idle; // parked workers
+		std::atomic<bool> m_stop;
+	};
+} // namespace cmsis
+
+namespace sys
+{
+	using thread_pool = cmsis::thread_pool;
+}
+
+#endif // CMSIS_THREAD_POOL_H_
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CMSIS_TIMEOUT_H_
+#define CMSIS_TIMEOUT_H_
+
+#include <chrono>
+#include <cstdint>
+
+/// Ticks added to a non-zero timeout. A kernel with a periodic tick counts a timeout from the next tick, which may
+/// come right after the call: the extra tick makes sure that a wait is never shorter than requested. The host port
+/// counts its timeouts from the call.
+#ifndef CMSIS_TIMEOUT_EXTRA_TICKS
+#ifdef CMSIS_OS2_HOST
+#define CMSIS_TIMEOUT_EXTRA_TICKS 0
+#else
+#define CMSIS_TIMEOUT_EXTRA_TICKS 1
+#endif
+#endif
+
+namespace cmsis
+{
+	namespace internal
+	{
+		/// Convert a duration to microseconds, rounded up: a sub-microsecond wait doesn't become a poll.
+		template <class Rep, class Period>
+		std::chrono::microseconds to_usec(const std::chrono::duration<Rep, Period>& rel_time)
+		{
+			auto usec = std::chrono::duration_cast<std::chrono::microseconds>(rel_time);
+			if (usec < rel_time)
+				++usec;
+			return usec;
+		}
+
+		/// Convert a duration to nanoseconds, rounded up.
+		template <class Rep, class Period>
+		std::chrono::nanoseconds to_nsec(const std::chrono::duration<Rep, Period>& rel_time)
+		{
+			auto nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(rel_time);
+			if (nsec < rel_time)
+				++nsec;
+			return nsec;
+		}
+
+		/// Convert a timeout to kernel ticks, rounded up to the next tick plus CMSIS_TIMEOUT_EXTRA_TICKS.
+		/// A null or negative timeout is a poll (0), a timeout too long for the kernel is osWaitForever.
+		uint32_t to_ticks(std::chrono::microseconds rel_time) noexcept;
+
+		/// Convert a timer period to kernel ticks, rounded up, and between 1 and the longest finite timeout.
+		uint32_t to_period_ticks(std::chrono::microseconds period) noexcept;
+
+		/// Convert a duration to system timer counts, rounded up. A negative duration is 0, an overflow UINT64_MAX.
+		uint64_t to_timer_counts(std::chrono::nanoseconds rel_time) noexcept;
+
+		/// Sleep with a sub-tick precision: the kernel sleeps for the whole ticks but the last one, then the thread
+		/// spins on the system timer until the end.
+		void precise_sleep_for(std::chrono::nanoseconds rel_time);
+	} // namespace internal
+} // namespace cmsis
+
+#endif // CMSIS_TIMEOUT_H_
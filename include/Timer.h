@@ -29,11 +29,88 @@
 #define CPP_CMSIS_TIMER_H_INCLUDED
 
 #include <chrono>
+#include <cstddef>
 #include <functional>
 #include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/// Size of the storage of the callback in a static_timer object: a larger callable doesn't compile.
+#ifndef CMSIS_TIMER_CALLBACK_SIZE
+#define CMSIS_TIMER_CALLBACK_SIZE (8 * sizeof(void*))
+#endif
 
 namespace cmsis
 {
+	namespace internal
+	{
+		[[noreturn]] void missing_timer_callback();
+
+		// Kernel timer which calls func(arg). The object given as argument must not move while the timer exists.
+		class base_timer
+		{
+		public:
+			base_timer(std::chrono::microseconds usec, void (*func)(void*), void* arg, bool periodic);
+			~base_timer() noexcept(false);
+
+			void start();
+			void stop();
+			bool running() const;
+
+			/// Called by the callback which returns false: stops a periodic timer, without throwing.
+			void expire() noexcept;
+			bool periodic() const noexcept { return m_periodic; }
+
+			base_timer(const base_timer&) = delete;
+			base_timer& operator=(const base_timer&) = delete;
+
+		private:
+			void* m_id; ///< timer identifier
+			std::chrono::microseconds m_usec;
+			bool m_periodic;
+		};
+
+		// Callable built in place, in CMSIS_TIMER_CALLBACK_SIZE bytes
+		class timer_callback
+		{
+		public:
+			template <typename _Callable> explicit timer_callback(_Callable&& __f)
+			{
+				typedef typename std::decay<_Callable>::type callable_type;
+				static_assert(
+					sizeof(callable_type) <= sizeof(m_storage), "timer callback larger than CMSIS_TIMER_CALLBACK_SIZE");
+				static_assert(alignof(callable_type) <= alignof(std::max_align_t), "over-aligned timer callback");
+
+				if (is_null(__f))
+					missing_timer_callback();
+
+				::new (static_cast<void*>(m_storage)) callable_type(std::forward<_Callable>(__f));
+				m_destroy = &destroy<callable_type>;
+			}
+			~timer_callback() { m_destroy(m_storage); }
+
+			template <typename _Callable> bool call() { return (*reinterpret_cast<_Callable*>(m_storage))(); }
+
+			timer_callback(const timer_callback&) = delete;
+			timer_callback& operator=(const timer_callback&) = delete;
+
+		private:
+			template <typename _Callable> static void destroy(void* __p) { static_cast<_Callable*>(__p)->~_Callable(); }
+
+			template <typename _Callable> static bool is_null(const _Callable&) noexcept { return false; }
+			template <typename _Callable> static bool is_null(_Callable* __f) noexcept { return __f == nullptr; }
+			template <typename _Signature> static bool is_null(const std::function<_Signature>& __f) noexcept
+			{
+				return !__f;
+			}
+
+		private:
+			void (*m_destroy)(void*);
+			alignas(std::max_align_t) unsigned char m_storage[CMSIS_TIMER_CALLBACK_SIZE];
+		};
+	} // namespace internal
+
 	class cmsis_timer;
 
 	class timer
@@ -69,11 +146,49 @@ namespace cmsis
 	{
 		__x.swap(__y);
 	}
+
+	// Timer with the callback built in the object, in CMSIS_TIMER_CALLBACK_SIZE bytes (a larger callable doesn't
+	// compile): the creation doesn't allocate, and the timer thread calls the callable directly. The object is the
+	// argument of the kernel timer, so it can't be moved. The callback returns false to stop a periodic timer.
+	class static_timer
+	{
+	public:
+		typedef timer::timer_type_t timer_type_t;
+
+		template <typename _Callable>
+		static_timer(std::chrono::microseconds usec, _Callable&& function, timer_type_t type = timer_type_t::periodic) :
+			m_callback(std::forward<_Callable>(function)),
+			m_timer(usec, &handler<typename std::decay<_Callable>::type>, this, type == timer_type_t::periodic)
+		{}
+		~static_timer() = default;
+
+		static_timer(const static_timer&) = delete;
+		static_timer& operator=(const static_timer&) = delete;
+
+		void start() { m_timer.start(); }
+		void stop() { m_timer.stop(); }
+		bool running() const { return m_timer.running(); }
+
+	private:
+		/// Function of the kernel timer.
+		template <typename _Callable> static void handler(void* argument)
+		{
+			static_timer* pTimer = static_cast<static_timer*>(argument);
+			if (!pTimer->m_callback.template call<_Callable>() && pTimer->m_timer.periodic())
+				pTimer->m_timer.expire();
+		}
+
+	private:
+		// The kernel timer is deleted before the callable is destroyed
+		internal::timer_callback m_callback;
+		internal::base_timer m_timer;
+	};
 } // namespace cmsis
 
 namespace sys
 {
 	using timer = cmsis::timer;
-}
+	using static_timer = cmsis::static_timer;
+} // namespace sys
 
 #endif // CPP_CMSIS_TIMER_H_INCLUDED
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CPP_CMSIS_TIMER_WHEEL_H_
+#define CPP_CMSIS_TIMER_WHEEL_H_
+
+#include "Mutex.h"
+#include "Thread.h"
+#include "Timeout.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace cmsis
+{
+	class timer_wheel;
+
+	// One-shot timer of a timer_wheel. The handle holds the links of the timer in the wheel: starting or stopping it
+	// costs O(1) and doesn't allocate. A handle can't be moved, and must be destroyed before its wheel.
+	class wheel_timer
+	{
+	public:
+		typedef void (*callback_t)(void* arg);
+
+		wheel_timer(timer_wheel& wheel, callback_t function, void* arg = nullptr);
+		/// Stop the timer, and wait for the end of its callback if it is running in the service thread.
+		~wheel_timer();
+
+		wheel_timer(const wheel_timer&) = delete;
+		wheel_timer& operator=(const wheel_timer&) = delete;
+
+		/// Start or restart the timer: the callback is called once, not before delay. Can be called from the callback.
+		template <class Rep, class Period> void start(const std::chrono::duration<Rep, Period>& delay)
+		{
+			start_nsec(internal::to_nsec(delay));
+		}
+
+		/// Stop the timer. The callback may already be running in the service thread.
+		void stop();
+
+		/// Returns true from the start of the timer until the call of its callback.
+		bool running() const;
+
+	private:
+		friend class timer_wheel;
+
+		void start_nsec(std::chrono::nanoseconds delay);
+
+	private:
+		wheel_timer* m_next;
+		wheel_timer** m_pprev; // link to this timer, nullptr when the timer isn't running
+		uint64_t m_expiry;     // in units of the wheel resolution
+		timer_wheel& m_wheel;
+		callback_t m_function;
+		void* m_arg;
+	};
+
+	// Hierarchical timer wheel: many one-shot timers share a single service thread, which sleeps until the next expiry
+	// and calls the expired callbacks in a batch. Time is measured with the system timer, the source of
+	// sys::chrono::high_resolution_clock, in units of the resolution of the wheel. A resolution under the kernel tick
+	// makes the service thread spin for the end of the waits. Timers can't be started nor stopped from an ISR.
+	class timer_wheel
+	{
+	public:
+		explicit timer_wheel(
+			std::chrono::nanoseconds resolution = std::chrono::milliseconds(1),
+			const thread::attributes& attr = thread::attributes());
+		/// Stop the service thread. Pending timers are never called.
+		~timer_wheel();
+
+		timer_wheel(const timer_wheel&) = delete;
+		timer_wheel& operator=(const timer_wheel&) = delete;
+
+		/// Number of running timers.
+		size_t pending() const;
+
+	private:
+		friend class wheel_timer;
+
+		static constexpr unsigned slot_bits = 6;
+		static constexpr unsigned slot_count = 1U << slot_bits;
+		static constexpr uint64_t slot_mask = slot_count - 1;
+		static constexpr unsigned level_count = 4;
+
+		void start(wheel_timer* t, std::chrono::nanoseconds delay);
+		void stop(wheel_timer* t, bool wait);
+
+		void run();
+		void sleep(uint64_t counts);
+		uint64_t now_counts() noexcept;
+		void insert(wheel_timer* t) noexcept;
+		void cascade(unsigned level, uint64_t index) noexcept;
+		void advance(uint64_t now) noexcept;
+		uint64_t next_event() const noexcept;
+
+		static void link(wheel_timer** head, wheel_timer* t) noexcept;
+		static void unlink(wheel_timer* t) noexcept;
+
+	private:
+		mutable mutex m_mutex;
+		wheel_timer* m_slots[level_count][slot_count];
+		wheel_timer* m_expired; // batch of the service thread
+		wheel_timer* m_current; // timer whose callback is running
+		uint64_t m_next;        // next unit to process
+		uint64_t m_wake;        // unit the service thread sleeps until, 0 while it is awake
+		uint64_t m_counts;      // 64-bit extension of the system timer
+		uint32_t m_last;
+		uint32_t m_resolution; // system timer counts per unit
+		uint32_t m_tick;       // system timer counts per kernel tick
+		size_t m_pending;
+		bool m_quit;
+		thread m_thread; // last member: the service thread starts once the wheel is built
+	};
+} // namespace cmsis
+
+namespace sys
+{
+	using timer_wheel = cmsis::timer_wheel;
+	using wheel_timer = cmsis::wheel_timer;
+} // namespace sys
+
+#endif // CPP_CMSIS_TIMER_WHEEL_H_
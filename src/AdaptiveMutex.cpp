@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AdaptiveMutex.h"
+#include "OSException.h"
+#include "ThreadFlag.h"
+#include "cmsis_os2.h"
+
+namespace cmsis
+{
+	adaptive_mutex::adaptive_mutex(uint32_t spin) :
+		m_state(unlocked),
+		m_waiter(nullptr),
+		m_slow_owner(false),
+		m_spin(spin),
+		m_fast(0),
+		m_spun(0),
+		m_slow(0)
+	{}
+
+	void adaptive_mutex::lock_contended()
+	{
+		for (uint32_t i = 0; i < m_spin; ++i)
+		{
+			internal::cpu_relax();
+
+			uint32_t expected = unlocked;
+			if (m_state.load(std::memory_order_relaxed) == unlocked &&
+				m_state.compare_exchange_weak(expected, locked, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				count(m_spun);
+				return;
+			}
+		}
+
+		// Only the owner of m_mutex waits on the lock word, the others wait on m_mutex
+		m_mutex.lock();
+		m_waiter.store(osThreadGetId(), std::memory_order_relaxed);
+		while (m_state.exchange(contended, std::memory_order_acq_rel) != unlocked)
+		{
+			uint32_t flags = osThreadFlagsWait(internal::adaptive_mutex_flag, osFlagsWaitAny, osWaitForever);
+			if (flags & osFlagsError)
+			{
+				m_waiter.store(nullptr, std::memory_order_relaxed);
+				m_mutex.unlock();
+#ifdef __cpp_exceptions
+				throw std::system_error(flags, flags_category(), "adaptive_mutex::lock");
+#else
+				std::terminate();
+#endif
+			}
+		}
+
+		// A wake-up may still be sent to this thread, it is ignored by its next wait
+		m_waiter.store(nullptr, std::memory_order_relaxed);
+		m_slow_owner = true;
+		count(m_slow);
+	}
+
+	void adaptive_mutex::unlock_slow()
+	{
+		// No other thread can wait on the lock word while m_mutex is held
+		m_slow_owner = false;
+		m_state.store(unlocked, std::memory_order_release);
+		m_mutex.unlock();
+	}
+
+	void adaptive_mutex::wake() noexcept
+	{
+		void* waiter = m_waiter.load(std::memory_order_acquire);
+		if (waiter)
+			osThreadFlagsSet(waiter, internal::adaptive_mutex_flag);
+	}
+} // namespace cmsis
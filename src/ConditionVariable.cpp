@@ -27,59 +27,108 @@
 
 #include "ConditionVariable.h"
 #include "OSException.h"
-#include "Semaphore.h"
+#include "ThreadFlag.h"
+#include "Timeout.h"
 #include "cmsis_os2.h"
 
 namespace cmsis
 {
+	// A waiter is woken up by the reserved condition_variable_flag of its thread:
+	// neither wait nor notify allocates memory or creates a kernel object.
+	struct condition_variable::waiter
+	{
+		waiter* next;
+		waiter* prev;
+		osThreadId_t thread;
+		bool notified; // protected by m_mutex
+	};
+
+	void condition_variable::unlink(waiter* w) noexcept
+	{
+		if (w->prev)
+			w->prev->next = w->next;
+		else
+			m_head = w->next;
+		if (w->next)
+			w->next->prev = w->prev;
+		else
+			m_tail = w->prev;
+	}
+
 	void condition_variable::notify_one() noexcept
 	{
 		std::lock_guard<cmsis::mutex> lg(m_mutex);
-		if (!m_wait.empty())
+		waiter* w = m_head;
+		if (w)
 		{
-			m_wait.front()->release();
-			m_wait.pop_front();
+			unlink(w);
+			w->notified = true;
+			osThreadFlagsSet(w->thread, internal::condition_variable_flag);
 		}
 	}
 
 	void condition_variable::notify_all() noexcept
 	{
 		std::lock_guard<cmsis::mutex> lg(m_mutex);
-		for (auto psema : m_wait)
-			psema->release();
-
-		m_wait.clear();
+		while (m_head)
+		{
+			waiter* w = m_head;
+			unlink(w);
+			w->notified = true;
+			osThreadFlagsSet(w->thread, internal::condition_variable_flag);
+		}
 	}
 
 	void condition_variable::wait(std::unique_lock<cmsis::mutex>& lock)
 	{
-		wait_for(lock, std::chrono::microseconds::max());
+		wait_ticks(lock, osWaitForever);
 	}
 
 	cmsis::cv_status
 	condition_variable::wait_for_usec(std::unique_lock<cmsis::mutex>& lock, std::chrono::microseconds usec)
+	{
+		return wait_ticks(lock, internal::to_ticks(usec));
+	}
+
+	cmsis::cv_status condition_variable::wait_ticks(std::unique_lock<cmsis::mutex>& lock, uint32_t timeout)
 	{
 		if (!lock.owns_lock())
 			std::terminate();
 
-		cmsis::binary_semaphore sema(0);
-		std::list<cmsis::binary_semaphore*>::iterator it;
+		waiter w;
+		w.next = nullptr;
+		w.thread = osThreadGetId();
+		w.notified = false;
 		{
-			std::lock_guard<std::mutex> lg(m_mutex);
-			it = m_wait.insert(m_wait.end(), &sema);
+			std::lock_guard<cmsis::mutex> lg(m_mutex);
+			w.prev = m_tail;
+			if (m_tail)
+				m_tail->next = &w;
+			else
+				m_head = &w;
+			m_tail = &w;
 		}
 
 		lock.unlock();
-		bool st = sema.try_acquire_for(usec);
-		lock.lock();
+		uint32_t flags = osThreadFlagsWait(internal::condition_variable_flag, osFlagsWaitAny, timeout);
 
-		if (!st)
+		cmsis::cv_status status = cmsis::cv_status::no_timeout;
+		if (flags & osFlagsError)
 		{
-			std::lock_guard<std::mutex> lg(m_mutex);
-			m_wait.erase(it);
-			return cmsis::cv_status::timeout;
+			std::lock_guard<cmsis::mutex> lg(m_mutex);
+			if (w.notified)
+			{
+				// Notified between the timeout and the lock: consume the flag, it must not wake a later wait
+				osThreadFlagsClear(internal::condition_variable_flag);
+			}
+			else
+			{
+				unlink(&w);
+				status = cmsis::cv_status::timeout;
+			}
 		}
 
-		return cmsis::cv_status::no_timeout;
+		lock.lock();
+		return status;
 	}
 } // namespace cmsis
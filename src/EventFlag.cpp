@@ -27,6 +27,7 @@
 
 #include "EventFlag.h"
 #include "OSException.h"
+#include "Timeout.h"
 #include "cmsis_os2.h"
 
 namespace cmsis
@@ -36,9 +37,14 @@ namespace cmsis
 	 * @throw std::system_error if an error occurs
 	 */
 	event::event(mask_type mask) :
+		event(mask, nullptr, 0)
+	{}
+
+	event::event(mask_type mask, void* cb_mem, size_t cb_size) :
 		m_id(0)
 	{
-		m_id = osEventFlagsNew(NULL);
+		osEventFlagsAttr_t attr = {NULL, 0, cb_mem, static_cast<uint32_t>(cb_size)};
+		m_id = osEventFlagsNew(cb_mem ? &attr : NULL);
 		if (m_id == 0)
 #ifdef __cpp_exceptions
 			throw std::system_error(osError, os_category(), "osEventFlagsNew");
@@ -174,11 +180,7 @@ namespace cmsis
 			std::terminate();
 #endif
 
-		uint32_t timeout = static_cast<uint32_t>(
-			(usec.count() * osKernelGetTickFreq() * std::chrono::microseconds::period::num) /
-			std::chrono::microseconds::period::den);
-		if (timeout > std::numeric_limits<uint32_t>::max())
-			timeout = osWaitForever;
+		uint32_t timeout = internal::to_ticks(usec);
 
 		uint32_t option = ((flg & wait_flag::all) == wait_flag::all) ? osFlagsWaitAll : osFlagsWaitAny;
 		if ((flg & wait_flag::no_clear) == wait_flag::no_clear)
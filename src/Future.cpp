@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Future.h"
+#include "OSException.h"
+#include "ThreadFlag.h"
+#include "Timeout.h"
+#include "cmsis_os2.h"
+
+namespace cmsis
+{
+	namespace internal
+	{
+		void throw_future_error(std::future_errc errc)
+		{
+#ifdef __cpp_exceptions
+			throw std::future_error(errc);
+#else
+			(void)errc;
+			std::terminate();
+#endif
+		}
+
+		base_future_state::base_future_state(void (*destroy)(base_future_state*), void* pool) noexcept :
+			m_refs(1),
+			m_status(0),
+			m_waiters(),
+			m_destroy(destroy),
+			m_pool(pool)
+		{}
+
+		void base_future_state::retrieve()
+		{
+			if (m_status.fetch_or(retrieved, std::memory_order_relaxed) & retrieved)
+				throw_future_error(std::future_errc::future_already_retrieved);
+		}
+
+		void base_future_state::claim()
+		{
+			if (m_status.fetch_or(claimed, std::memory_order_relaxed) & claimed)
+				throw_future_error(std::future_errc::promise_already_satisfied);
+		}
+
+#ifdef __cpp_exceptions
+		void base_future_state::set_exception(std::exception_ptr e)
+		{
+			claim();
+			m_exception = e;
+			make_ready();
+		}
+#endif
+
+		void base_future_state::abandon() noexcept
+		{
+			if (m_status.fetch_or(claimed, std::memory_order_relaxed) & claimed)
+				return;
+
+#ifdef __cpp_exceptions
+			m_exception = std::make_exception_ptr(std::future_error(std::future_errc::broken_promise));
+#endif
+			m_status.fetch_or(broken, std::memory_order_relaxed);
+			make_ready();
+		}
+
+		void base_future_state::make_ready() noexcept
+		{
+			kernel_lock lock;
+			m_status.fetch_or(ready, std::memory_order_release);
+			m_waiters.notify_all(future_flag);
+		}
+
+		void base_future_state::check_result() const
+		{
+#ifdef __cpp_exceptions
+			if (m_exception)
+				std::rethrow_exception(m_exception);
+#else
+			if (m_status.load(std::memory_order_relaxed) & broken)
+				std::terminate();
+#endif
+		}
+
+		void base_future_state::wait() const
+		{
+			wait_ready(osWaitForever);
+		}
+
+		std::future_status base_future_state::wait_for_usec(std::chrono::microseconds usec) const
+		{
+			if (usec < std::chrono::microseconds::zero())
+#ifdef __cpp_exceptions
+				throw std::system_error(osErrorParameter, os_category(), "future: negative timer");
+#else
+				std::terminate();
+#endif
+
+			return wait_ready(to_ticks(usec)) ? std::future_status::ready : std::future_status::timeout;
+		}
+
+		bool base_future_state::wait_ready(uint32_t timeout) const
+		{
+			if (is_ready())
+				return true;
+
+			if (timeout == 0)
+				return false;
+
+			list_waiter self = {nullptr, osThreadGetId(), false};
+			{
+				kernel_lock lock;
+				if (is_ready())
+					return true;
+
+				m_waiters.push(self);
+			}
+
+			return m_waiters.wait(self, future_flag, timeout, "future::wait");
+		}
+	} // namespace internal
+} // namespace cmsis
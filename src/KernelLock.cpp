@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "KernelLock.h"
+#include "OSException.h"
+#include "cmsis_os2.h"
+
+namespace cmsis
+{
+	namespace internal
+	{
+		kernel_lock::kernel_lock() noexcept :
+			m_lock(osKernelLock())
+		{}
+
+		kernel_lock::~kernel_lock()
+		{
+			if (m_lock >= 0)
+				osKernelRestoreLock(m_lock);
+		}
+
+		void wait_list::push(list_waiter& self) noexcept
+		{
+			self.next = m_head;
+			m_head = &self;
+		}
+
+		void wait_list::notify_all(uint32_t flag) noexcept
+		{
+			// The waiters don't leave the list before the end of the lock
+			for (list_waiter* w = m_head; w; w = w->next)
+			{
+				w->woken = true;
+				osThreadFlagsSet(w->thread, flag);
+			}
+			m_head = nullptr;
+		}
+
+		void wait_list::remove(list_waiter& self) noexcept
+		{
+			list_waiter** w = &m_head;
+			while (*w != &self)
+				w = &(*w)->next;
+			*w = self.next;
+		}
+
+		bool wait_list::wait(list_waiter& self, uint32_t flag, uint32_t timeout, const char* what)
+		{
+			uint32_t start = osKernelGetTickCount();
+			uint32_t flags = 0;
+			for (;;)
+			{
+				uint32_t remaining = timeout;
+				if (timeout != osWaitForever)
+				{
+					uint32_t elapsed = osKernelGetTickCount() - start;
+					remaining = elapsed < timeout ? timeout - elapsed : 0;
+				}
+
+				flags = remaining ? osThreadFlagsWait(flag, osFlagsWaitAny, remaining)
+								  : static_cast<uint32_t>(osFlagsErrorTimeout);
+
+				kernel_lock lock;
+				if (self.woken)
+					return true;
+
+				if (flags & osFlagsError)
+				{
+					remove(self);
+					break;
+				}
+			}
+
+			if (flags == osFlagsErrorTimeout || flags == osFlagsErrorResource)
+				return false;
+
+#ifdef __cpp_exceptions
+			throw std::system_error(flags, flags_category(), what);
+#else
+			(void)what;
+			std::terminate();
+#endif
+		}
+	} // namespace internal
+} // namespace cmsis
@@ -26,17 +26,33 @@
  */
 
 #include "Memory.h"
+#include "KernelLock.h"
 #include "OSException.h"
+#include "Timeout.h"
 #include "cmsis_os2.h"
 
 namespace cmsis
 {
 	namespace internal
 	{
-		base_memory_pool::base_memory_pool(size_t count, size_t n) :
+		namespace
+		{
+			base_pool_cache* s_caches = nullptr; // all the caches, under the kernel lock
+		} // namespace
+
+		base_memory_pool::base_memory_pool(
+			size_t count,
+			size_t n,
+			void* cb_mem,
+			size_t cb_size,
+			void* mp_mem,
+			size_t mp_size) :
 			m_id(0)
 		{
-			m_id = osMemoryPoolNew(static_cast<uint32_t>(count), static_cast<uint32_t>(n), NULL);
+			osMemoryPoolAttr_t attr = {
+				NULL, 0, cb_mem, static_cast<uint32_t>(cb_size), mp_mem, static_cast<uint32_t>(mp_size)};
+			m_id = osMemoryPoolNew(
+				static_cast<uint32_t>(count), static_cast<uint32_t>(n), (cb_mem || mp_mem) ? &attr : NULL);
 			if (!m_id)
 #ifdef __cpp_exceptions
 				throw std::system_error(osError, os_category(), "osMemoryPoolNew");
@@ -105,6 +121,33 @@ namespace cmsis
 			return p;
 		}
 
+		void* base_memory_pool::try_allocate() noexcept
+		{
+			return osMemoryPoolAlloc(m_id, 0);
+		}
+
+		size_t base_memory_pool::try_allocate(void** blocks, size_t n) noexcept
+		{
+			kernel_lock lock;
+			size_t count = 0;
+			while (count < n && (blocks[count] = osMemoryPoolAlloc(m_id, 0)) != nullptr)
+				++count;
+
+			return count;
+		}
+
+		void* base_memory_pool::allocate_for_usec(std::chrono::microseconds usec)
+		{
+			if (usec < std::chrono::microseconds::zero())
+#ifdef __cpp_exceptions
+				throw std::system_error(osErrorParameter, os_category(), "memory_pool: negative timer");
+#else
+				std::terminate();
+#endif
+
+			return osMemoryPoolAlloc(m_id, internal::to_ticks(usec));
+		}
+
 		void base_memory_pool::deallocate(void* p)
 		{
 			osStatus_t sta = osMemoryPoolFree(m_id, p);
@@ -116,6 +159,11 @@ namespace cmsis
 #endif
 		}
 
+		bool base_memory_pool::try_deallocate(void* p) noexcept
+		{
+			return osMemoryPoolFree(m_id, p) == osOK;
+		}
+
 		size_t base_memory_pool::max_size() const noexcept
 		{
 			return osMemoryPoolGetCapacity(m_id);
@@ -125,5 +173,57 @@ namespace cmsis
 		{
 			return osMemoryPoolGetCount(m_id);
 		}
+
+		base_pool_cache::base_pool_cache(const void* pool, void** blocks, size_t capacity) noexcept :
+			m_blocks(blocks),
+			m_count(0),
+			m_pool(pool),
+			m_capacity(capacity),
+			m_next(nullptr),
+			m_busy(false)
+		{
+			kernel_lock lock;
+			m_next = s_caches;
+			s_caches = this;
+		}
+
+		base_pool_cache::~base_pool_cache()
+		{
+			kernel_lock lock;
+			base_pool_cache** link = &s_caches;
+			while (*link != this)
+				link = &(*link)->m_next;
+			*link = m_next;
+		}
+
+		void base_pool_cache::lock() const noexcept
+		{
+			// The blocks are taken under the kernel lock: on a single core, the owner never finds its cache busy
+			while (m_busy.exchange(true, std::memory_order_acquire))
+				osThreadYield();
+		}
+
+		size_t base_pool_cache::steal() noexcept
+		{
+			kernel_lock lock;
+			for (base_pool_cache* other = s_caches; other; other = other->m_next)
+			{
+				// A cache in use by its owner is skipped, its owner may be preempted in the middle of an operation
+				if (other == this || other->m_pool != m_pool || other->m_busy.exchange(true, std::memory_order_acquire))
+					continue;
+
+				size_t n = (other->m_count + 1) / 2;
+				if (n > m_capacity - m_count)
+					n = m_capacity - m_count;
+				for (size_t i = 0; i < n; ++i)
+					m_blocks[m_count++] = other->m_blocks[--other->m_count];
+				other->m_busy.store(false, std::memory_order_release);
+
+				if (n)
+					return n;
+			}
+
+			return 0;
+		}
 	} // namespace internal
 } // namespace cmsis
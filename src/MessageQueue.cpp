@@ -26,6 +26,7 @@
  */
 
 #include "OSException.h"
+#include "Timeout.h"
 #include "cmsis_os2.h"
 #include <MessageQueue.h>
 
@@ -33,10 +34,18 @@ namespace cmsis
 {
 	namespace internal
 	{
-		message_queue_impl::message_queue_impl(size_t max_len, size_t ele_len) :
+		message_queue_impl::message_queue_impl(
+			size_t max_len,
+			size_t ele_len,
+			void* cb_mem,
+			size_t cb_size,
+			void* mq_mem,
+			size_t mq_size) :
 			m_id(0)
 		{
-			m_id = osMessageQueueNew(max_len, ele_len, NULL);
+			osMessageQueueAttr_t attr = {
+				NULL, 0, cb_mem, static_cast<uint32_t>(cb_size), mq_mem, static_cast<uint32_t>(mq_size)};
+			m_id = osMessageQueueNew(max_len, ele_len, (cb_mem || mq_mem) ? &attr : NULL);
 			if (m_id == 0)
 			{
 #ifdef __cpp_exceptions
@@ -103,11 +112,7 @@ namespace cmsis
 #endif
 			}
 
-			uint32_t timeout = static_cast<uint32_t>(
-				(usec.count() * osKernelGetTickFreq() * std::chrono::microseconds::period::num) /
-				std::chrono::microseconds::period::den);
-			if (timeout > std::numeric_limits<uint32_t>::max())
-				timeout = osWaitForever;
+			uint32_t timeout = internal::to_ticks(usec);
 
 			osStatus_t sta = osMessageQueuePut(m_id, data, priority, timeout);
 			if (timeout == 0 && sta == osErrorResource)
@@ -125,9 +130,9 @@ namespace cmsis
 			return (sta == osOK) ? mq_status::no_timeout : mq_status::timeout;
 		}
 
-		void message_queue_impl::get(void* data)
+		void message_queue_impl::get(void* data, uint8_t* priority)
 		{
-			osStatus_t sta = osMessageQueueGet(m_id, data, 0, osWaitForever); // wait for message
+			osStatus_t sta = osMessageQueueGet(m_id, data, priority, osWaitForever); // wait for message
 			if (sta != osOK)
 			{
 #ifdef __cpp_exceptions
@@ -138,7 +143,7 @@ namespace cmsis
 			}
 		}
 
-		mq_status message_queue_impl::get(void* data, std::chrono::microseconds usec)
+		mq_status message_queue_impl::get(void* data, std::chrono::microseconds usec, uint8_t* priority)
 		{
 			if (usec < std::chrono::microseconds::zero())
 			{
@@ -149,13 +154,9 @@ namespace cmsis
 #endif
 			}
 
-			uint32_t timeout = static_cast<uint32_t>(
-				(usec.count() * osKernelGetTickFreq() * std::chrono::microseconds::period::num) /
-				std::chrono::microseconds::period::den);
-			if (timeout > std::numeric_limits<uint32_t>::max())
-				timeout = osWaitForever;
+			uint32_t timeout = internal::to_ticks(usec);
 
-			osStatus_t sta = osMessageQueueGet(m_id, data, 0, timeout); // wait for message
+			osStatus_t sta = osMessageQueueGet(m_id, data, priority, timeout); // wait for message
 			if (timeout == 0 && sta == osErrorResource)
 				return mq_status::empty;
 
@@ -171,6 +172,102 @@ namespace cmsis
 			return (sta == osOK) ? mq_status::no_timeout : mq_status::timeout;
 		}
 
+		bool message_queue_impl::try_put(const void* data, uint8_t priority)
+		{
+			osStatus_t sta = osMessageQueuePut(m_id, data, priority, 0);
+			if (sta == osErrorResource)
+				return false;
+
+			if (sta != osOK)
+			{
+#ifdef __cpp_exceptions
+				throw std::system_error(sta, os_category(), internal::str_error("osMessageQueuePut", m_id));
+#else
+				std::terminate();
+#endif
+			}
+
+			return true;
+		}
+
+		bool message_queue_impl::try_get(void* data, uint8_t* priority)
+		{
+			osStatus_t sta = osMessageQueueGet(m_id, data, priority, 0);
+			if (sta == osErrorResource)
+				return false;
+
+			if (sta != osOK)
+			{
+#ifdef __cpp_exceptions
+				throw std::system_error(sta, os_category(), internal::str_error("osMessageQueueGet", m_id));
+#else
+				std::terminate();
+#endif
+			}
+
+			return true;
+		}
+
+		size_t message_queue_impl::put_available(const void* data, size_t ele_len, size_t count, uint8_t priority)
+		{
+			// CMSIS-RTOS2 has no multi-message call: stop at the first full queue, without waiting
+			const uint8_t* p = static_cast<const uint8_t*>(data);
+			size_t n = 0;
+			while (n < count && try_put(p + n * ele_len, priority))
+				++n;
+
+			return n;
+		}
+
+		size_t message_queue_impl::get_available(void* data, size_t ele_len, size_t count)
+		{
+			uint8_t* p = static_cast<uint8_t*>(data);
+			size_t n = 0;
+			while (n < count && try_get(p + n * ele_len))
+				++n;
+
+			return n;
+		}
+
+		size_t message_queue_impl::put_n(const void* data, size_t ele_len, size_t count, uint8_t priority)
+		{
+			if (count == 0)
+				return 0;
+
+			put(data, priority);
+			return 1 + put_available(static_cast<const uint8_t*>(data) + ele_len, ele_len, count - 1, priority);
+		}
+
+		size_t message_queue_impl::put_n(
+			const void* data,
+			size_t ele_len,
+			size_t count,
+			uint8_t priority,
+			std::chrono::microseconds usec)
+		{
+			if (count == 0 || put(data, priority, usec) != mq_status::no_timeout)
+				return 0;
+
+			return 1 + put_available(static_cast<const uint8_t*>(data) + ele_len, ele_len, count - 1, priority);
+		}
+
+		size_t message_queue_impl::get_n(void* data, size_t ele_len, size_t count)
+		{
+			if (count == 0)
+				return 0;
+
+			get(data);
+			return 1 + get_available(static_cast<uint8_t*>(data) + ele_len, ele_len, count - 1);
+		}
+
+		size_t message_queue_impl::get_n(void* data, size_t ele_len, size_t count, std::chrono::microseconds usec)
+		{
+			if (count == 0 || get(data, usec) != mq_status::no_timeout)
+				return 0;
+
+			return 1 + get_available(static_cast<uint8_t*>(data) + ele_len, ele_len, count - 1);
+		}
+
 		size_t message_queue_impl::size() const
 		{
 			return osMessageQueueGetCount(m_id);
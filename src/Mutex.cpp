@@ -27,16 +27,34 @@
 
 #include "Mutex.h"
 #include "OSException.h"
+#include "ThreadFlag.h"
+#include "Timeout.h"
 #include "cmsis_os2.h"
+#ifdef CMSIS_MUTEX_PROFILING
+#include <cinttypes>
+#include <cstdio>
+#endif
 
 namespace cmsis
 {
+#ifdef CMSIS_MUTEX_PROFILING
+	namespace
+	{
+		internal::base_timed_mutex* s_mutexes = nullptr; // live mutexes
+
+		uint64_t ticks_to_ns(uint64_t ticks, uint32_t freq) noexcept
+		{
+			return (ticks / freq) * 1000000000U + ((ticks % freq) * 1000000000U) / freq;
+		}
+	} // namespace
+#endif // CMSIS_MUTEX_PROFILING
+
 	namespace internal
 	{
-		base_timed_mutex::base_timed_mutex(const char* name, bool recursive) :
+		base_timed_mutex::base_timed_mutex(const char* name, bool recursive, void* cb_mem, size_t cb_size) :
 			m_id(0)
 		{
-			osMutexAttr_t Mutex_attr = {name, osMutexPrioInherit, NULL, 0};
+			osMutexAttr_t Mutex_attr = {name, osMutexPrioInherit, cb_mem, static_cast<uint32_t>(cb_size)};
 			if (recursive)
 				Mutex_attr.attr_bits |= osMutexRecursive;
 
@@ -47,10 +65,33 @@ namespace cmsis
 #else
 				std::terminate();
 #endif
+
+#ifdef CMSIS_MUTEX_PROFILING
+			m_profile = profile();
+			m_profile.name = name;
+
+			internal::kernel_lock lock;
+			m_profile.next = s_mutexes;
+			if (s_mutexes)
+				s_mutexes->m_profile.prev = this;
+			s_mutexes = this;
+#endif
 		}
 
 		base_timed_mutex::~base_timed_mutex() noexcept(false)
 		{
+#ifdef CMSIS_MUTEX_PROFILING
+			{
+				internal::kernel_lock lock;
+				if (m_profile.prev)
+					m_profile.prev->m_profile.next = m_profile.next;
+				else
+					s_mutexes = m_profile.next;
+				if (m_profile.next)
+					m_profile.next->m_profile.prev = m_profile.prev;
+			}
+#endif
+
 			osStatus_t sta = osMutexDelete(m_id);
 			if (sta != osOK)
 #ifdef __cpp_exceptions
@@ -60,9 +101,32 @@ namespace cmsis
 #endif
 		}
 
+		int32_t base_timed_mutex::acquire(uint32_t timeout)
+		{
+#ifdef CMSIS_MUTEX_PROFILING
+			osStatus_t sta = osMutexAcquire(m_id, 0);
+			if (sta == osOK)
+			{
+				profile_acquired(0, false);
+				return sta;
+			}
+
+			if (timeout == 0 || (sta != osErrorResource && sta != osErrorTimeout))
+				return sta;
+
+			uint32_t wait_start = osKernelGetSysTimerCount();
+			sta = osMutexAcquire(m_id, timeout);
+			if (sta == osOK)
+				profile_acquired(wait_start, true);
+			return sta;
+#else
+			return osMutexAcquire(m_id, timeout);
+#endif
+		}
+
 		void base_timed_mutex::lock()
 		{
-			osStatus_t sta = osMutexAcquire(m_id, osWaitForever);
+			osStatus_t sta = static_cast<osStatus_t>(acquire(osWaitForever));
 			if (sta != osOK)
 #ifdef __cpp_exceptions
 				throw std::system_error(sta, os_category(), internal::str_error("osMutexAcquire", m_id));
@@ -73,6 +137,10 @@ namespace cmsis
 
 		void base_timed_mutex::unlock()
 		{
+#ifdef CMSIS_MUTEX_PROFILING
+			profile_release();
+#endif
+
 			osStatus_t sta = osMutexRelease(m_id);
 			if (sta != osOK)
 #ifdef __cpp_exceptions
@@ -84,15 +152,18 @@ namespace cmsis
 
 		bool base_timed_mutex::try_lock()
 		{
-			osStatus_t sta = osMutexAcquire(m_id, 0);
-			if (sta != osOK && sta != osErrorTimeout)
+			osStatus_t sta = static_cast<osStatus_t>(acquire(0));
+			if (sta == osErrorResource || sta == osErrorTimeout)
+				return false;
+
+			if (sta != osOK)
 #ifdef __cpp_exceptions
 				throw std::system_error(sta, os_category(), internal::str_error("osMutexAcquire", m_id));
 #else
 				std::terminate();
 #endif
 
-			return (sta != osErrorTimeout);
+			return true;
 		}
 
 		bool base_timed_mutex::try_lock_for_usec(std::chrono::microseconds usec)
@@ -104,13 +175,9 @@ namespace cmsis
 				std::terminate();
 #endif
 
-			uint32_t timeout = static_cast<uint32_t>(
-				(usec.count() * osKernelGetTickFreq() * std::chrono::microseconds::period::num) /
-				std::chrono::microseconds::period::den);
-			if (timeout > std::numeric_limits<uint32_t>::max())
-				timeout = osWaitForever;
+			uint32_t timeout = internal::to_ticks(usec);
 
-			osStatus_t sta = osMutexAcquire(m_id, timeout);
+			osStatus_t sta = static_cast<osStatus_t>(acquire(timeout));
 			if (timeout == 0 && sta == osErrorResource)
 				return false;
 
@@ -123,5 +190,223 @@ namespace cmsis
 
 			return (sta != osErrorTimeout);
 		}
+
+#ifdef CMSIS_MUTEX_PROFILING
+		void base_timed_mutex::profile_acquired(uint32_t wait_start, bool contended) noexcept
+		{
+			uint32_t now = osKernelGetSysTimerCount();
+			++m_profile.acquires;
+			if (contended)
+			{
+				uint32_t wait = now - wait_start;
+				++m_profile.contentions;
+				m_profile.total_wait += wait;
+				if (wait > m_profile.max_wait)
+					m_profile.max_wait = wait;
+			}
+
+			if (m_profile.depth++ == 0)
+				m_profile.hold_start = now;
+		}
+
+		void base_timed_mutex::profile_release() noexcept
+		{
+			// The statistics belong to the owner
+			if (m_profile.depth == 0 || osMutexGetOwner(m_id) != osThreadGetId())
+				return;
+
+			if (--m_profile.depth == 0)
+			{
+				uint32_t hold = osKernelGetSysTimerCount() - m_profile.hold_start;
+				if (hold > m_profile.max_hold)
+					m_profile.max_hold = hold;
+			}
+		}
+#endif // CMSIS_MUTEX_PROFILING
+	} // namespace internal
+
+	namespace internal
+	{
+		namespace
+		{
+			/// Set the state of the flag, and wake up its waiters.
+			void finish_once(std::atomic<uint32_t>& state, uint32_t value, wait_list& waiters) noexcept
+			{
+				kernel_lock lock;
+				state.store(value, std::memory_order_release);
+				waiters.notify_all(call_once_flag);
+			}
+		} // namespace
+
+		void call_once_slow(once_flag& flag, void (*routine)(void*), void* context)
+		{
+			for (;;)
+			{
+				uint32_t state = once_flag::init;
+				if (flag.m_state.compare_exchange_strong(
+						state, once_flag::running, std::memory_order_acquire, std::memory_order_acquire))
+				{
+#ifdef __cpp_exceptions
+					try
+					{
+						routine(context);
+					}
+					catch (...)
+					{
+						// Another thread, or the next call, tries again
+						finish_once(flag.m_state, once_flag::init, flag.m_waiters);
+						throw;
+					}
+#else
+					routine(context);
+#endif
+					finish_once(flag.m_state, once_flag::done, flag.m_waiters);
+					return;
+				}
+
+				if (state == once_flag::done)
+					return;
+
+				// Wait for the end of the routine, then check the state again
+				list_waiter self = {nullptr, osThreadGetId(), false};
+				{
+					kernel_lock lock;
+					if (flag.m_state.load(std::memory_order_relaxed) != once_flag::running)
+						continue;
+
+					flag.m_waiters.push(self);
+				}
+
+				flag.m_waiters.wait(self, call_once_flag, osWaitForever, "call_once");
+			}
+		}
 	} // namespace internal
+
+#ifdef CMSIS_MUTEX_PROFILING
+	namespace internal
+	{
+		struct mutex_registry
+		{
+			/// Copy the statistics of the live mutexes [first, first + max). Returns the number of live mutexes.
+			static size_t snapshot(size_t first, mutex_stats* stats, size_t max) noexcept
+			{
+				size_t count = 0;
+				size_t copied = 0;
+				{
+					// Statistics are copied as they are: an update in progress on another core may be partially seen
+					internal::kernel_lock lock;
+					for (base_timed_mutex* m = s_mutexes; m; m = m->m_profile.next, ++count)
+					{
+						if (count < first || copied >= max)
+							continue;
+
+						const base_timed_mutex::profile& p = m->m_profile;
+						mutex_stats& st = stats[copied++];
+						st.name = p.name;
+						st.handle = m->m_id;
+						st.owner = osMutexGetOwner(m->m_id);
+						st.acquires = p.acquires;
+						st.contentions = p.contentions;
+						st.total_wait = p.total_wait;
+						st.max_wait = p.max_wait;
+						st.max_hold = p.max_hold;
+					}
+				}
+
+				uint32_t freq = osKernelGetSysTimerFreq();
+				for (size_t i = 0; i < copied; ++i)
+				{
+					stats[i].total_wait = ticks_to_ns(stats[i].total_wait, freq);
+					stats[i].max_wait = ticks_to_ns(stats[i].max_wait, freq);
+					stats[i].max_hold = ticks_to_ns(stats[i].max_hold, freq);
+				}
+
+				return count;
+			}
+
+			static void reset() noexcept
+			{
+				internal::kernel_lock lock;
+				for (base_timed_mutex* m = s_mutexes; m; m = m->m_profile.next)
+				{
+					base_timed_mutex::profile& p = m->m_profile;
+					p.acquires = 0;
+					p.contentions = 0;
+					p.total_wait = 0;
+					p.max_wait = 0;
+					p.max_hold = 0;
+				}
+			}
+		};
+	} // namespace internal
+
+	namespace mutex_profiler
+	{
+		size_t collect(mutex_stats* stats, size_t max) noexcept
+		{
+			return internal::mutex_registry::snapshot(0, stats, max);
+		}
+
+		size_t dump(char* buffer, size_t size) noexcept
+		{
+			size_t len = 0;
+			auto append = [&](int n) {
+				if (n > 0)
+					len += static_cast<size_t>(n);
+			};
+
+			append(std::snprintf(
+				buffer,
+				size,
+				"%-24s %-18s %-18s %10s %10s %14s %12s %12s\n",
+				"name",
+				"handle",
+				"owner",
+				"acquires",
+				"contended",
+				"total_wait_ns",
+				"max_wait_ns",
+				"max_hold_ns"));
+
+			// The statistics are formatted out of the kernel lock, a few mutexes at a time
+			const size_t chunk = 8;
+			mutex_stats stats[chunk];
+			size_t first = 0;
+			size_t count = 0;
+			do
+			{
+				count = internal::mutex_registry::snapshot(first, stats, chunk);
+				size_t n = (count > first) ? count - first : 0;
+				if (n > chunk)
+					n = chunk;
+
+				for (size_t i = 0; i < n; ++i)
+				{
+					const mutex_stats& st = stats[i];
+					append(std::snprintf(
+						len < size ? buffer + len : nullptr,
+						len < size ? size - len : 0,
+						"%-24s %-18p %-18p %10" PRIu32 " %10" PRIu32 " %14" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n",
+						st.name ? st.name : "-",
+						st.handle,
+						st.owner,
+						st.acquires,
+						st.contentions,
+						st.total_wait,
+						st.max_wait,
+						st.max_hold));
+				}
+
+				first += n;
+			} while (first < count);
+
+			return len;
+		}
+
+		void reset() noexcept
+		{
+			internal::mutex_registry::reset();
+		}
+	} // namespace mutex_profiler
+#endif // CMSIS_MUTEX_PROFILING
 } // namespace cmsis
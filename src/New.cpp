@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Global operators new and delete on the slab allocator, built with the CMSIS_CPP_GLOBAL_NEW option
+
+#include "Slab.h"
+#include <exception>
+#include <new>
+
+namespace
+{
+	void* allocate(std::size_t size)
+	{
+		if (size == 0)
+			size = 1;
+
+		for (;;)
+		{
+			void* p = cmsis::slab::allocate(size);
+			if (p)
+				return p;
+
+			std::new_handler handler = std::get_new_handler();
+			if (handler == nullptr)
+#ifdef __cpp_exceptions
+				throw std::bad_alloc();
+#else
+				std::terminate();
+#endif
+			handler();
+		}
+	}
+
+	void* allocate(std::size_t size, const std::nothrow_t&) noexcept
+	{
+#ifdef __cpp_exceptions
+		try
+		{
+			return allocate(size);
+		}
+		catch (...)
+		{
+			return nullptr;
+		}
+#else
+		return cmsis::slab::allocate(size ? size : 1);
+#endif
+	}
+} // namespace
+
+void* operator new(std::size_t size)
+{
+	return allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+	return allocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t& tag) noexcept
+{
+	return allocate(size, tag);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+	return allocate(size, tag);
+}
+
+void operator delete(void* p) noexcept
+{
+	cmsis::slab::deallocate(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	cmsis::slab::deallocate(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	cmsis::slab::deallocate(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	cmsis::slab::deallocate(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	cmsis::slab::deallocate(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	cmsis::slab::deallocate(p);
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "PoolAllocator.h"
+#include "KernelLock.h"
+#include <cstring>
+
+namespace cmsis
+{
+	namespace
+	{
+		/// Set or clear the bits [first, first + n) of the bitmap.
+		void mark(uint32_t* bitmap, size_t first, size_t n, bool used) noexcept
+		{
+			while (n)
+			{
+				size_t bit = first % 32;
+				size_t len = (n < 32 - bit) ? n : 32 - bit;
+				uint32_t mask = (len == 32) ? 0xFFFFFFFFU : ((1U << len) - 1) << bit;
+				if (used)
+					bitmap[first / 32] |= mask;
+				else
+					bitmap[first / 32] &= ~mask;
+				first += len;
+				n -= len;
+			}
+		}
+	} // namespace
+
+	block_arena::block_arena(size_t count, size_t block_size) :
+		block_arena(count, block_size, nullptr, nullptr)
+	{
+		// One allocation: the bitmap, then the blocks
+		size_t bitmap_bytes = aligned_block_size(bitmap_size(count) * sizeof(uint32_t));
+		m_heap = ::operator new(bitmap_bytes + count * m_block_size);
+		m_bitmap = static_cast<uint32_t*>(m_heap);
+		m_mem = static_cast<unsigned char*>(m_heap) + bitmap_bytes;
+		std::memset(m_bitmap, 0, bitmap_size(count) * sizeof(uint32_t));
+	}
+
+	block_arena::block_arena(size_t count, size_t block_size, void* mem, uint32_t* bitmap) noexcept :
+		m_mem(static_cast<unsigned char*>(mem)),
+		m_bitmap(bitmap),
+		m_count(count),
+		m_block_size(aligned_block_size(block_size ? block_size : 1)),
+		m_used(0),
+		m_epoch(0),
+		m_freed(0),
+		m_heap(nullptr)
+	{
+		if (m_bitmap)
+			std::memset(m_bitmap, 0, bitmap_size(count) * sizeof(uint32_t));
+	}
+
+	block_arena::~block_arena()
+	{
+		::operator delete(m_heap);
+	}
+
+	void* block_arena::allocate(size_t size) noexcept
+	{
+		if (size > m_count * m_block_size)
+			return nullptr;
+
+		const size_t n = blocks(size);
+		size_t first = 0;
+		size_t run = 0; // free blocks from first
+		size_t i = 0;
+		uint32_t epoch = 0;
+		uint32_t freed = 0;
+
+		// The kernel lock is released every CMSIS_POOL_ALLOCATOR_SCAN_WORDS words of the bitmap. An allocation in
+		// between may take blocks of the current run: it is scanned again. A deallocation may free blocks behind the
+		// scan: a scan which fails starts again from the first block.
+		for (;;)
+		{
+			internal::kernel_lock lock;
+
+			if (n > m_count - m_used)
+				return nullptr;
+
+			if (i == 0)
+				freed = m_freed;
+
+			if (epoch != m_epoch)
+			{
+				if (run)
+					i = first;
+				run = 0;
+				epoch = m_epoch;
+			}
+
+			const size_t end = i + CMSIS_POOL_ALLOCATOR_SCAN_WORDS * 32;
+			while (i < m_count && i < end && run < n)
+			{
+				uint32_t word = m_bitmap[i / 32];
+				if (i % 32 == 0 && i + 32 <= m_count && (word == 0 || word == 0xFFFFFFFFU))
+				{
+					// Whole word, free or used
+					if (word != 0)
+						run = 0;
+					else
+					{
+						if (run == 0)
+							first = i;
+						run += 32;
+					}
+					i += 32;
+					continue;
+				}
+
+				if (word & (1U << (i % 32)))
+					run = 0;
+				else
+				{
+					if (run == 0)
+						first = i;
+					++run;
+				}
+				++i;
+			}
+
+			if (run >= n)
+			{
+				mark(m_bitmap, first, n, true);
+				m_used += n;
+				++m_epoch;
+				return m_mem + first * m_block_size;
+			}
+
+			if (i >= m_count)
+			{
+				if (freed == m_freed)
+					return nullptr;
+
+				i = 0;
+				run = 0;
+			}
+		}
+	}
+
+	void block_arena::deallocate(void* p, size_t size) noexcept
+	{
+		if (p == nullptr)
+			return;
+
+		const size_t n = blocks(size);
+		size_t first = static_cast<size_t>(static_cast<unsigned char*>(p) - m_mem) / m_block_size;
+
+		internal::kernel_lock lock;
+		mark(m_bitmap, first, n, false);
+		m_used -= n;
+		++m_freed;
+	}
+
+	size_t block_arena::size() const noexcept
+	{
+		internal::kernel_lock lock;
+		return m_used;
+	}
+} // namespace cmsis
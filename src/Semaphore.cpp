@@ -27,16 +27,35 @@
 
 #include "Semaphore.h"
 #include "OSException.h"
+#include "Timeout.h"
 #include "cmsis_os2.h"
 
 namespace cmsis
 {
 	namespace internal
 	{
-		base_semaphore::base_semaphore(std::ptrdiff_t max, std::ptrdiff_t desired) :
-			m_id(0)
+		namespace
 		{
-			m_id = osSemaphoreNew(static_cast<uint32_t>(max), static_cast<uint32_t>(desired), NULL);
+			// Wake-up tokens never exceed the number of waiting threads, and RTX limits a semaphore to 65535 tokens
+			constexpr uint32_t wake_tokens_max = 0xFFFFU;
+		} // namespace
+
+		base_semaphore::base_semaphore(std::ptrdiff_t max, std::ptrdiff_t desired, void* cb_mem, size_t cb_size) :
+			m_id(0),
+			m_count(0),
+			m_max(max > INT32_MAX ? INT32_MAX : static_cast<int32_t>(max))
+		{
+			if (desired < 0 || desired > m_max)
+			{
+#ifdef __cpp_exceptions
+				throw std::system_error(osErrorParameter, os_category(), "semaphore: invalid count");
+#else
+				std::terminate();
+#endif
+			}
+
+			osSemaphoreAttr_t attr = {NULL, 0, cb_mem, static_cast<uint32_t>(cb_size)};
+			m_id = osSemaphoreNew(wake_tokens_max, 0, cb_mem ? &attr : NULL);
 			if (m_id == 0)
 			{
 #ifdef __cpp_exceptions
@@ -45,6 +64,8 @@ namespace cmsis
 				std::terminate();
 #endif
 			}
+
+			m_count.store(static_cast<int32_t>(desired), std::memory_order_relaxed);
 		}
 
 		base_semaphore::~base_semaphore() noexcept(false)
@@ -60,9 +81,18 @@ namespace cmsis
 			}
 		}
 
-		void base_semaphore::release(std::ptrdiff_t update)
+		void base_semaphore::release_error()
+		{
+#ifdef __cpp_exceptions
+			throw std::system_error(osErrorResource, os_category(), internal::str_error("semaphore::release", m_id));
+#else
+			std::terminate();
+#endif
+		}
+
+		void base_semaphore::wake(int32_t count)
 		{
-			while (update--)
+			while (count--)
 			{
 				osStatus_t sta = osSemaphoreRelease(m_id);
 				if (sta != osOK)
@@ -76,7 +106,7 @@ namespace cmsis
 			}
 		}
 
-		void base_semaphore::acquire()
+		void base_semaphore::wait()
 		{
 			osStatus_t sta = osSemaphoreAcquire(m_id, osWaitForever);
 			if (sta != osOK)
@@ -89,11 +119,6 @@ namespace cmsis
 			}
 		}
 
-		bool base_semaphore::try_acquire() noexcept
-		{
-			return (osSemaphoreAcquire(m_id, 0) == osOK);
-		}
-
 		bool base_semaphore::try_acquire_for_usec(std::chrono::microseconds usec)
 		{
 			if (usec < std::chrono::microseconds::zero())
@@ -105,17 +130,19 @@ namespace cmsis
 #endif
 			}
 
-			uint32_t timeout = static_cast<uint32_t>(
-				(usec.count() * osKernelGetTickFreq() * std::chrono::microseconds::period::num) /
-				std::chrono::microseconds::period::den);
-			if (timeout > std::numeric_limits<uint32_t>::max())
-				timeout = osWaitForever;
+			uint32_t timeout = internal::to_ticks(usec);
+
+			if (timeout == 0)
+				return try_acquire();
+
+			if (m_count.fetch_sub(1, std::memory_order_acquire) > 0)
+				return true;
 
 			osStatus_t sta = osSemaphoreAcquire(m_id, timeout);
-			if (timeout == 0 && sta == osErrorResource)
-				return false;
+			if (sta == osOK)
+				return true;
 
-			if (sta != osOK && sta != osErrorTimeout)
+			if (sta != osErrorTimeout)
 			{
 #ifdef __cpp_exceptions
 				throw std::system_error(sta, os_category(), internal::str_error("osSemaphoreAcquire", m_id));
@@ -124,7 +151,16 @@ namespace cmsis
 #endif
 			}
 
-			return (sta == osOK);
+			// Withdraw from the waiters, unless a release has already counted this thread: its token is then taken
+			int32_t count = m_count.load(std::memory_order_relaxed);
+			while (count < 0)
+			{
+				if (m_count.compare_exchange_weak(count, count + 1, std::memory_order_relaxed))
+					return false;
+			}
+
+			wait();
+			return true;
 		}
 	} // namespace internal
 } // namespace cmsis
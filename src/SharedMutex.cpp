@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "SharedMutex.h"
+#include "OSException.h"
+#include "ThreadFlag.h"
+#include "Timeout.h"
+#include "cmsis_os2.h"
+
+namespace cmsis
+{
+	namespace internal
+	{
+		base_shared_mutex::base_shared_mutex(rw_preference pref, const char* name) :
+			m_state(0),
+			m_writer(nullptr),
+			m_blocking(pref == rw_preference::writers ? writer_waiting | writer_active : writer_active),
+			m_writers(name)
+		{}
+
+		void base_shared_mutex::lock()
+		{
+			m_writers.lock();
+			wait_readers(osWaitForever);
+		}
+
+		void base_shared_mutex::unlock()
+		{
+			// The readers blocked on the writers mutex come in after the bit has been cleared
+			m_state.fetch_and(~static_cast<uint32_t>(writer_active), std::memory_order_release);
+			m_writers.unlock();
+		}
+
+		bool base_shared_mutex::try_lock()
+		{
+			if (!m_writers.try_lock())
+				return false;
+
+			uint32_t expected = 0;
+			if (m_state.compare_exchange_strong(
+					expected, writer_active, std::memory_order_acquire, std::memory_order_relaxed))
+				return true;
+
+			m_writers.unlock();
+			return false;
+		}
+
+		void base_shared_mutex::lock_shared_slow()
+		{
+			// Step back, then wait for the writer on its mutex: while the mutex is held here, no writer is there
+			unlock_shared();
+			m_writers.lock();
+			m_state.fetch_add(1, std::memory_order_acquire);
+			m_writers.unlock();
+		}
+
+		bool base_shared_mutex::try_lock_for_usec(std::chrono::microseconds usec)
+		{
+			uint32_t start = osKernelGetTickCount();
+			if (!m_writers.try_lock_for(usec))
+				return false;
+
+			uint32_t timeout = to_ticks(usec);
+			uint32_t elapsed = osKernelGetTickCount() - start;
+			if (wait_readers(elapsed < timeout ? timeout - elapsed : 0))
+				return true;
+
+			m_writers.unlock();
+			return false;
+		}
+
+		bool base_shared_mutex::try_lock_shared_for_usec(std::chrono::microseconds usec)
+		{
+			if (!m_writers.try_lock_for(usec))
+				return false;
+
+			m_state.fetch_add(1, std::memory_order_acquire);
+			m_writers.unlock();
+			return true;
+		}
+
+		bool base_shared_mutex::wait_readers(uint32_t timeout)
+		{
+			// The readers see the waiting writer with the bit
+			m_writer.store(osThreadGetId(), std::memory_order_relaxed);
+			m_state.fetch_or(writer_waiting, std::memory_order_acq_rel);
+
+			uint32_t start = osKernelGetTickCount();
+			for (;;)
+			{
+				uint32_t expected = writer_waiting;
+				if (m_state.compare_exchange_strong(
+						expected, writer_active, std::memory_order_acquire, std::memory_order_relaxed))
+					return true;
+
+				// A flag left by a previous wake-up only costs another check
+				uint32_t wait = timeout;
+				if (timeout != osWaitForever)
+				{
+					uint32_t elapsed = osKernelGetTickCount() - start;
+					wait = elapsed < timeout ? timeout - elapsed : 0;
+				}
+
+				uint32_t flags = wait ? osThreadFlagsWait(shared_mutex_flag, osFlagsWaitAny, wait)
+									  : static_cast<uint32_t>(osFlagsErrorTimeout);
+				if (flags & osFlagsError)
+				{
+					if (flags == osFlagsErrorTimeout || flags == osFlagsErrorResource)
+					{
+						// Last chance, the readers may have left since the check
+						expected = writer_waiting;
+						if (m_state.compare_exchange_strong(
+								expected, writer_active, std::memory_order_acquire, std::memory_order_relaxed))
+							return true;
+
+						m_state.fetch_and(~static_cast<uint32_t>(writer_waiting), std::memory_order_release);
+						return false;
+					}
+
+					m_state.fetch_and(~static_cast<uint32_t>(writer_waiting), std::memory_order_release);
+					m_writers.unlock();
+#ifdef __cpp_exceptions
+					throw std::system_error(flags, flags_category(), "shared_mutex::lock");
+#else
+					std::terminate();
+#endif
+				}
+			}
+		}
+
+		void base_shared_mutex::wake() noexcept
+		{
+			void* writer = m_writer.load(std::memory_order_relaxed);
+			if (writer)
+				osThreadFlagsSet(writer, shared_mutex_flag);
+		}
+	} // namespace internal
+} // namespace cmsis
@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Slab.h"
+#include "KernelLock.h"
+#include "Memory.h"
+#include "StaticStorage.h"
+#include "cmsis_os2.h"
+#include <atomic>
+#include <cassert>
+#include <new>
+#if defined(RTE_CMSIS_RTOS2_RTX5)
+#include "rtx_os.h"
+#else
+#include <cstdlib>
+#endif
+
+/// Number of blocks of each size class.
+#ifndef CMSIS_SLAB_BLOCKS_16
+#define CMSIS_SLAB_BLOCKS_16 64
+#endif
+#ifndef CMSIS_SLAB_BLOCKS_32
+#define CMSIS_SLAB_BLOCKS_32 64
+#endif
+#ifndef CMSIS_SLAB_BLOCKS_64
+#define CMSIS_SLAB_BLOCKS_64 32
+#endif
+#ifndef CMSIS_SLAB_BLOCKS_128
+#define CMSIS_SLAB_BLOCKS_128 16
+#endif
+#ifndef CMSIS_SLAB_BLOCKS_256
+#define CMSIS_SLAB_BLOCKS_256 8
+#endif
+
+namespace cmsis
+{
+	namespace
+	{
+		struct counters
+		{
+			std::atomic<size_t> in_use;
+			std::atomic<size_t> peak;
+			std::atomic<uint32_t> allocations;
+			std::atomic<uint32_t> overflows;
+		};
+
+		void count_allocation(counters& c) noexcept
+		{
+			c.allocations.fetch_add(1, std::memory_order_relaxed);
+			size_t in_use = c.in_use.fetch_add(1, std::memory_order_relaxed) + 1;
+			size_t peak = c.peak.load(std::memory_order_relaxed);
+			while (in_use > peak && !c.peak.compare_exchange_weak(peak, in_use, std::memory_order_relaxed))
+			{
+			}
+		}
+
+		void count_free(counters& c) noexcept
+		{
+			c.in_use.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		counters s_heap;
+
+		void* heap_allocate(size_t size) noexcept
+		{
+#if defined(RTE_CMSIS_RTOS2_RTX5)
+			// The RTX memory functions aren't reentrant
+			void* p;
+			{
+				internal::kernel_lock lock;
+				p = osRtxMemoryAlloc(osRtxInfo.mem.common, static_cast<uint32_t>(size), 0);
+			}
+#else
+			void* p = std::malloc(size);
+#endif
+			if (p)
+				count_allocation(s_heap);
+			return p;
+		}
+
+		void heap_free(void* p) noexcept
+		{
+			count_free(s_heap);
+#if defined(RTE_CMSIS_RTOS2_RTX5)
+			internal::kernel_lock lock;
+			osRtxMemoryFree(osRtxInfo.mem.common, p);
+#else
+			std::free(p);
+#endif
+		}
+
+#ifdef CMSIS_STATIC_STORAGE
+		constexpr size_t class_count = 5;
+		constexpr size_t class_sizes[class_count] = {16, 32, 64, 128, 256};
+		constexpr size_t class_blocks[class_count] = {
+			CMSIS_SLAB_BLOCKS_16,
+			CMSIS_SLAB_BLOCKS_32,
+			CMSIS_SLAB_BLOCKS_64,
+			CMSIS_SLAB_BLOCKS_128,
+			CMSIS_SLAB_BLOCKS_256};
+
+		constexpr size_t class_mem_size(size_t i)
+		{
+			return CMSIS_MEMORY_POOL_MEM_SIZE(class_blocks[i], class_sizes[i]);
+		}
+
+		/// The memory of the classes follows each other in the arena: class i starts at class_offset(i).
+		constexpr size_t class_offset(size_t i)
+		{
+			return (i == 0) ? 0 : class_offset(i - 1) + class_mem_size(i - 1);
+		}
+
+		class size_class : private internal::base_memory_pool
+		{
+		public:
+			size_class(size_t i, void* cb_mem, size_t cb_size, void* mem) :
+				internal::base_memory_pool(class_blocks[i], class_sizes[i], cb_mem, cb_size, mem, class_mem_size(i))
+			{}
+
+			using internal::base_memory_pool::try_allocate;
+			using internal::base_memory_pool::try_deallocate;
+		};
+
+		// Never destroyed: blocks can be freed until the end of the program
+		struct arena
+		{
+			alignas(std::max_align_t) unsigned char mem[class_offset(class_count)];
+			internal::static_storage<CMSIS_MEMORY_POOL_CB_SIZE> cb[class_count];
+			alignas(size_class) unsigned char pools[class_count][sizeof(size_class)];
+		};
+
+		arena s_arena;
+		counters s_classes[class_count];
+
+		enum : int
+		{
+			slab_uninitialized,
+			slab_initializing,
+			slab_ready,
+			slab_failed
+		};
+		std::atomic<int> s_state(slab_uninitialized);
+
+		size_class& pool(size_t i) noexcept
+		{
+			return *reinterpret_cast<size_class*>(s_arena.pools[i]);
+		}
+
+		/// The pools are built by the first allocation after osKernelInitialize. Meanwhile, the heap is used.
+		bool ready() noexcept
+		{
+			int state = s_state.load(std::memory_order_acquire);
+			if (state != slab_uninitialized)
+				return state == slab_ready;
+
+			osKernelState_t kernel = osKernelGetState();
+			if (kernel == osKernelInactive || kernel == osKernelError)
+				return false;
+
+			if (!s_state.compare_exchange_strong(state, slab_initializing, std::memory_order_acquire))
+				return false;
+
+			state = slab_ready;
+#ifdef __cpp_exceptions
+			try
+			{
+#endif
+				for (size_t i = 0; i < class_count; ++i)
+				{
+					internal::static_storage<CMSIS_MEMORY_POOL_CB_SIZE>& cb = s_arena.cb[i];
+					::new (s_arena.pools[i]) size_class(i, cb.cb_mem, sizeof(cb.cb_mem), s_arena.mem + class_offset(i));
+				}
+#ifdef __cpp_exceptions
+			}
+			catch (...)
+			{
+				state = slab_failed;
+			}
+#endif
+
+			s_state.store(state, std::memory_order_release);
+			return state == slab_ready;
+		}
+
+		/// Size class of a block, or class_count when it comes from the heap.
+		size_t class_of(const void* p) noexcept
+		{
+			const unsigned char* block = static_cast<const unsigned char*>(p);
+			if (block < s_arena.mem || block >= s_arena.mem + sizeof(s_arena.mem))
+				return class_count;
+
+			size_t offset = static_cast<size_t>(block - s_arena.mem);
+			size_t i = 0;
+			while (offset >= class_offset(i + 1))
+				++i;
+			return i;
+		}
+#else
+		constexpr size_t class_count = 0;
+#endif // CMSIS_STATIC_STORAGE
+	} // namespace
+
+	namespace slab
+	{
+		void* allocate(size_t size) noexcept
+		{
+#ifdef CMSIS_STATIC_STORAGE
+			if (size <= class_sizes[class_count - 1] && ready())
+			{
+				size_t i = 0;
+				while (size > class_sizes[i])
+					++i;
+
+				for (size_t first = i; i < class_count; ++i)
+				{
+					void* p = pool(i).try_allocate();
+					if (p)
+					{
+						count_allocation(s_classes[i]);
+						return p;
+					}
+
+					s_classes[first].overflows.fetch_add(1, std::memory_order_relaxed);
+					first = i + 1;
+				}
+			}
+#endif
+			return heap_allocate(size);
+		}
+
+		void deallocate(void* p) noexcept
+		{
+			if (p == nullptr)
+				return;
+
+#ifdef CMSIS_STATIC_STORAGE
+			size_t i = class_of(p);
+			if (i < class_count)
+			{
+				count_free(s_classes[i]);
+				bool freed = pool(i).try_deallocate(p);
+				assert(freed);
+				(void)freed;
+				return;
+			}
+#endif
+			heap_free(p);
+		}
+
+		size_t collect(slab_stats* stats, size_t max) noexcept
+		{
+			size_t n = 0;
+			auto copy = [&](size_t block_size, size_t capacity, const counters& c) {
+				if (n < max)
+				{
+					slab_stats& st = stats[n];
+					st.block_size = block_size;
+					st.capacity = capacity;
+					st.in_use = c.in_use.load(std::memory_order_relaxed);
+					st.peak = c.peak.load(std::memory_order_relaxed);
+					st.allocations = c.allocations.load(std::memory_order_relaxed);
+					st.overflows = c.overflows.load(std::memory_order_relaxed);
+				}
+				++n;
+			};
+
+#ifdef CMSIS_STATIC_STORAGE
+			for (size_t i = 0; i < class_count; ++i)
+				copy(class_sizes[i], class_blocks[i], s_classes[i]);
+#endif
+			copy(0, 0, s_heap);
+			return n;
+		}
+	} // namespace slab
+} // namespace cmsis
@@ -27,47 +27,92 @@
 
 #include "Thread.h"
 #include "OSException.h"
+#include "Timeout.h"
 #include "cmsis_os2.h"
 #include <atomic>
+#include <cstddef>
 #ifdef __GNUC__
 #include <cxxabi.h>
 #endif
 
+#ifndef CMSIS_THREAD_POOL_SIZE
+#define CMSIS_THREAD_POOL_SIZE 16 // number of statically allocated thread control blocks
+#endif
+
+#ifndef CMSIS_THREAD_ROUTINE_SIZE
+#define CMSIS_THREAD_ROUTINE_SIZE 64 // in place storage for the callable and its arguments
+#endif
+
 namespace cmsis
 {
+	// The control block is shared by the thread object and the running thread, the last one gives it back.
+	// Control blocks come from a static pool, and the routine is built in their storage: creating a thread doesn't
+	// allocate memory, unless the pool is exhausted or the routine is larger than CMSIS_THREAD_ROUTINE_SIZE.
 	class thread_impl
 	{
 	public:
-		thread_impl(const thread::attributes& attr, std::unique_ptr<thread::CallableBase> targetfunc) :
+		explicit thread_impl(bool pooled) noexcept :
 			m_id(0),
-			m_function(std::move(targetfunc)),
-			m_detached(false)
+			m_ops(nullptr),
+			m_routine(nullptr),
+			m_refs(1),
+			m_detached(false),
+			m_started(false),
+			m_pooled(pooled)
+		{}
+
+		thread_impl(const thread_impl&) = delete;
+		thread_impl& operator=(const thread_impl&) = delete;
+
+		static thread_impl* allocate();
+		static void release(thread_impl* impl) noexcept;
+
+		void* reserve(size_t size)
 		{
+			m_routine = (size <= sizeof(m_storage)) ? m_storage : ::operator new(size);
+			return m_routine;
+		}
+
+		void start(const thread::attributes& attr, const thread::routine_ops* ops)
+		{
+			m_ops = ops;
+
 			osThreadAttr_t osAttr = {};
 			osAttr.attr_bits = osThreadJoinable;
 			osAttr.name = attr.name;
 			osAttr.stack_mem = attr.stack_mem;
 			osAttr.stack_size = attr.stack_size;
+			osAttr.cb_mem = attr.cb_mem;
+			osAttr.cb_size = attr.cb_size;
 			osAttr.priority = static_cast<osPriority_t>(attr.priority);
 
 			if (osAttr.priority == osPriorityNone)
 				osAttr.priority = osPriorityNormal;
 
+			// Reference of the running thread
+			m_refs.fetch_add(1, std::memory_order_relaxed);
 			m_id = osThreadNew(runnableMethodStatic, this, &osAttr);
 			if (m_id == 0)
 			{
+				m_refs.fetch_sub(1, std::memory_order_relaxed);
 #ifdef __cpp_exceptions
 				throw std::system_error(osError, os_category(), "osThreadNew");
 #else
 				std::terminate();
 #endif
 			}
-		}
 
-		thread_impl(const thread_impl&) = delete;
-		thread_impl& operator=(const thread_impl&) = delete;
+			m_started = true;
+		}
 
-		~thread_impl() { osThreadTerminate(m_id); }
+		/// Drop the reference of the thread object.
+		void abandon() noexcept
+		{
+			// A routine that never ran is destroyed here, otherwise by the running thread
+			if (!m_started && m_ops)
+				m_ops->destroy(m_routine);
+			release(this);
+		}
 
 		void join()
 		{
@@ -81,6 +126,8 @@ namespace cmsis
 #endif
 			}
 
+			// The control block has been released by the join
+			m_id = 0;
 			m_detached.store(true);
 		}
 
@@ -104,49 +151,126 @@ namespace cmsis
 		osThreadId_t get_id() const noexcept { return m_id; }
 
 	private:
+		// Reference of the running thread, also dropped when it is unwound by osThreadExit
+		struct running_ref
+		{
+			thread_impl* impl;
+			~running_ref()
+			{
+				impl->m_ops->destroy(impl->m_routine);
+				release(impl);
+			}
+		};
+
 		static void runnableMethodStatic(void* pVThread)
 		{
-#ifdef __cpp_exceptions
-			try
 			{
+				running_ref ref = {reinterpret_cast<thread_impl*>(pVThread)};
+#ifdef __cpp_exceptions
+				try
+				{
 #endif // __cpp_exceptions
-				thread_impl* pThreadImpl = reinterpret_cast<thread_impl*>(pVThread);
-				pThreadImpl->m_function->run();
+					ref.impl->m_ops->run(ref.impl->m_routine);
 #ifdef __cpp_exceptions
-			}
+				}
 #ifdef __GNUC__
-			catch (const abi::__forced_unwind&)
-			{
-				throw;
-			}
+				catch (const abi::__forced_unwind&)
+				{
+					throw;
+				}
 #endif // __GNUC__
-			catch (...)
-			{
-				std::terminate();
-			}
+				catch (...)
+				{
+					std::terminate();
+				}
 #endif // __cpp_exceptions
+			}
 
+			// The control block may have been reused from here
 			osThreadExit();
 		}
 
 	private:
 		osThreadId_t m_id; // task identifier
-		std::unique_ptr<thread::CallableBase> m_function;
+		const thread::routine_ops* m_ops;
+		void* m_routine;
+		std::atomic<uint32_t> m_refs;
 		std::atomic_bool m_detached;
+		bool m_started;
+		bool m_pooled;
+		alignas(std::max_align_t) unsigned char m_storage[CMSIS_THREAD_ROUTINE_SIZE];
 	};
 
+	namespace
+	{
+		struct impl_pool
+		{
+			static constexpr size_t size = CMSIS_THREAD_POOL_SIZE;
+
+			alignas(thread_impl) unsigned char blocks[size][sizeof(thread_impl)];
+			std::atomic<uint32_t> used[(size + 31) / 32];
+		};
+
+		impl_pool s_impl_pool;
+	} // namespace
+
+	thread_impl* thread_impl::allocate()
+	{
+		// Lock-free, the first free block is taken
+		for (size_t i = 0; i < impl_pool::size; ++i)
+		{
+			uint32_t mask = 1U << (i % 32);
+			if ((s_impl_pool.used[i / 32].fetch_or(mask, std::memory_order_acquire) & mask) == 0)
+				return ::new (s_impl_pool.blocks[i]) thread_impl(true);
+		}
+
+		return new thread_impl(false);
+	}
+
+	void thread_impl::release(thread_impl* impl) noexcept
+	{
+		if (impl->m_refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+			return;
+
+		if (impl->m_routine && impl->m_routine != impl->m_storage)
+			::operator delete(impl->m_routine);
+
+		if (!impl->m_pooled)
+		{
+			delete impl;
+			return;
+		}
+
+		size_t i = static_cast<size_t>(reinterpret_cast<unsigned char*>(impl) - s_impl_pool.blocks[0]) /
+			sizeof(thread_impl);
+		impl->~thread_impl();
+		s_impl_pool.used[i / 32].fetch_and(~(1U << (i % 32)), std::memory_order_release);
+	}
+
+	void thread::impl_release::operator()(thread_impl* impl) const noexcept
+	{
+		impl->abandon();
+	}
+
 	thread::thread() noexcept :
 		m_pThread(nullptr)
 	{}
 
-	thread::thread(const attributes& attr, std::unique_ptr<thread::CallableBase> base) :
-		m_pThread(std::make_unique<thread_impl>(attr, std::move(base)))
-	{}
-
 	thread::thread(thread&& __t) noexcept :
 		m_pThread(std::move(__t.m_pThread))
 	{}
 
+	void* thread::reserve(size_t size)
+	{
+		m_pThread.reset(thread_impl::allocate());
+		return m_pThread->reserve(size);
+	}
+
+	void thread::start(const attributes& attr, const routine_ops* ops)
+	{
+		m_pThread->start(attr, ops);
+	}
+
 	thread::~thread()
 	{
 		if (joinable())
@@ -343,13 +467,7 @@ namespace cmsis
 			{
 				if (usec > std::chrono::microseconds::zero())
 				{
-					uint32_t ticks = static_cast<uint32_t>(
-						(usec.count() * osKernelGetTickFreq() * std::chrono::microseconds::period::num) /
-						std::chrono::microseconds::period::den);
-					if (ticks > std::numeric_limits<uint32_t>::max())
-						ticks = osWaitForever;
-
-					osStatus_t sta = osDelay(ticks);
+					osStatus_t sta = osDelay(cmsis::internal::to_ticks(usec));
 					if (sta != osOK)
 					{
 #ifdef __cpp_exceptions
@@ -368,7 +486,7 @@ namespace cmsis
 
 extern "C" int _getpid(void)
 {
-	return reinterpret_cast<int>(osThreadGetId());
+	return static_cast<int>(reinterpret_cast<intptr_t>(osThreadGetId()));
 }
 
 #endif // !OS_USE_SEMIHOSTING
@@ -27,6 +27,7 @@
 
 #include "ThreadFlag.h"
 #include "OSException.h"
+#include "Timeout.h"
 #include "cmsis_os2.h"
 
 namespace cmsis
@@ -50,6 +51,8 @@ namespace cmsis
 
 	namespace this_thread
 	{
+		constexpr flags::mask_type flags::user_mask;
+
 		flags::mask_type flags::set(mask_type mask)
 		{
 			osThreadId_t tid = osThreadGetId();
@@ -81,18 +84,18 @@ namespace cmsis
 				std::terminate();
 #endif
 
-			return flags;
+			return static_cast<mask_type>(flags) & user_mask;
 		}
 
 		/**
-		 * Clears a thread flag.
+		 * Clears a thread flag. The flags reserved by the library are never cleared.
 		 * @param mask
-		 * @return the thread flag value
+		 * @return the thread flag value, without the reserved flags
 		 * @throw std::system_error if an error occurs
 		 */
 		flags::mask_type flags::clear(mask_type mask)
 		{
-			int32_t flags = osThreadFlagsClear(mask);
+			int32_t flags = osThreadFlagsClear(mask & user_mask);
 			if (flags < 0)
 #ifdef __cpp_exceptions
 				throw std::system_error(flags, flags_category(), "osThreadFlagsClear");
@@ -100,7 +103,7 @@ namespace cmsis
 				std::terminate();
 #endif
 
-			return flags;
+			return static_cast<mask_type>(flags) & user_mask;
 		}
 
 		/**
@@ -142,11 +145,7 @@ namespace cmsis
 				std::terminate();
 #endif
 
-			uint32_t timeout = static_cast<uint32_t>(
-				(usec.count() * osKernelGetTickFreq() * std::chrono::microseconds::period::num) /
-				std::chrono::microseconds::period::den);
-			if (timeout > std::numeric_limits<uint32_t>::max())
-				timeout = osWaitForever;
+			uint32_t timeout = cmsis::internal::to_ticks(usec);
 
 			uint32_t option = ((flg & wait_flag::all) == wait_flag::all) ? osFlagsWaitAll : osFlagsWaitAny;
 			if ((flg & wait_flag::no_clear) == wait_flag::no_clear)
@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ThreadPool.h"
+#include "OSException.h"
+#include "ThreadFlag.h"
+#include "cmsis_os2.h"
+
+namespace cmsis
+{
+	namespace
+	{
+		static_assert(
+			CMSIS_THREAD_POOL_DEQUE_SIZE != 0 &&
+				(CMSIS_THREAD_POOL_DEQUE_SIZE & (CMSIS_THREAD_POOL_DEQUE_SIZE - 1)) == 0,
+			"the deque size must be a power of two");
+
+		// Chase-Lev deque of fixed capacity: the owner pushes and pops at the bottom, the thieves steal at the top.
+		// The indexes wrap, their difference is the size.
+		class job_deque
+		{
+		public:
+			static constexpr uint32_t capacity = CMSIS_THREAD_POOL_DEQUE_SIZE;
+
+			job_deque() noexcept :
+				m_top(0),
+				m_bottom(0)
+			{}
+
+			/// Owner only, false when the deque is full.
+			bool push(internal::pool_job* job) noexcept
+			{
+				uint32_t b = m_bottom.load(std::memory_order_relaxed);
+				uint32_t t = m_top.load(std::memory_order_acquire);
+				if (b - t >= capacity)
+					return false;
+
+				m_jobs[b % capacity].store(job, std::memory_order_relaxed);
+				m_bottom.store(b + 1, std::memory_order_release);
+				return true;
+			}
+
+			/// Owner only, the newest job.
+			internal::pool_job* pop() noexcept
+			{
+				uint32_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+				m_bottom.store(b, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				uint32_t t = m_top.load(std::memory_order_relaxed);
+
+				if (static_cast<int32_t>(b - t) < 0)
+				{
+					m_bottom.store(b + 1, std::memory_order_relaxed);
+					return nullptr;
+				}
+
+				internal::pool_job* job = m_jobs[b % capacity].load(std::memory_order_relaxed);
+				if (b == t)
+				{
+					// Last job: race with the thieves
+					if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+						job = nullptr;
+					m_bottom.store(b + 1, std::memory_order_relaxed);
+				}
+				return job;
+			}
+
+			/// Any thread, the oldest job. nullptr when the deque is empty, or when another thread took the job.
+			internal::pool_job* steal() noexcept
+			{
+				uint32_t t = m_top.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				uint32_t b = m_bottom.load(std::memory_order_acquire);
+				if (static_cast<int32_t>(b - t) <= 0)
+					return nullptr;
+
+				internal::pool_job* job = m_jobs[t % capacity].load(std::memory_order_relaxed);
+				if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					return nullptr;
+				return job;
+			}
+
+			bool empty() const noexcept
+			{
+				uint32_t t = m_top.load(std::memory_order_relaxed);
+				uint32_t b = m_bottom.load(std::memory_order_relaxed);
+				return static_cast<int32_t>(b - t) <= 0;
+			}
+
+		private:
+			std::atomic<uint32_t> m_top;
+			std::atomic<uint32_t> m_bottom;
+			std::atomic<internal::pool_job*> m_jobs[capacity];
+		};
+	} // namespace
+
+	struct thread_pool::worker
+	{
+		job_deque jobs;
+		std::atomic<osThreadId_t> id;
+		std::atomic<bool> parked; // waits for the thread flag, cleared by the thread that wakes it up
+		cmsis::thread thread;
+
+		worker() noexcept :
+			id(nullptr),
+			parked(false)
+		{}
+	};
+
+	thread_pool::thread_pool(size_t workers, const thread::attributes& attr, size_t jobs) :
+		m_jobs(jobs),
+		m_shared(jobs),
+		m_workers(new worker[workers]),
+		m_count(workers),
+		m_idle(0),
+		m_stop(false)
+	{
+		if (workers == 0 || attr.stack_mem || attr.cb_mem)
+#ifdef __cpp_exceptions
+			throw std::system_error(osErrorParameter, os_category(), "thread_pool: invalid attributes");
+#else
+			std::terminate();
+#endif
+
+		thread::attributes worker_attr = attr;
+		if (worker_attr.name == nullptr)
+			worker_attr.name = "thread_pool";
+
+		// The workers see all the deques from the start, those of the workers not started yet are empty
+#ifdef __cpp_exceptions
+		try
+		{
+			for (size_t i = 0; i < workers; ++i)
+				m_workers[i].thread = thread(worker_attr, &thread_pool::run_worker, this, i);
+		}
+		catch (...)
+		{
+			stop();
+			throw;
+		}
+#else
+		for (size_t i = 0; i < workers; ++i)
+			m_workers[i].thread = thread(worker_attr, &thread_pool::run_worker, this, i);
+#endif
+	}
+
+	thread_pool::~thread_pool()
+	{
+		stop();
+	}
+
+	void thread_pool::stop() noexcept
+	{
+		// The workers run the pending jobs before leaving
+		m_stop.store(true, std::memory_order_seq_cst);
+		for (size_t i = 0; i < m_count; ++i)
+		{
+			worker& w = m_workers[i];
+			if (w.parked.exchange(false, std::memory_order_acq_rel))
+			{
+				m_idle.fetch_sub(1, std::memory_order_relaxed);
+				osThreadFlagsSet(w.id.load(std::memory_order_acquire), internal::thread_pool_flag);
+			}
+		}
+
+		for (size_t i = 0; i < m_count; ++i)
+		{
+			if (m_workers[i].thread.joinable())
+				m_workers[i].thread.join();
+		}
+	}
+
+	void thread_pool::enqueue(internal::pool_job* job)
+	{
+		// A worker keeps its own jobs, the other threads go through the shared queue
+		osThreadId_t self = osThreadGetId();
+		bool queued = false;
+		for (size_t i = 0; i < m_count && !queued; ++i)
+		{
+			if (m_workers[i].id.load(std::memory_order_relaxed) == self)
+				queued = m_workers[i].jobs.push(job);
+		}
+		if (!queued)
+			m_shared.put(job);
+
+		// Seen by a worker that is about to park, or the worker sees the job
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_idle.load(std::memory_order_relaxed) != 0)
+			wake_one();
+	}
+
+	void thread_pool::run_worker(size_t index)
+	{
+		worker& self = m_workers[index];
+		// Published before the worker can be seen as parked: the thread that clears parked sees it
+		self.id.store(osThreadGetId(), std::memory_order_release);
+
+		for (;;)
+		{
+			internal::pool_job* job = find_job(index);
+			if (job)
+			{
+				// Share the jobs left in the deque with a parked worker
+				if (m_idle.load(std::memory_order_relaxed) != 0 && !self.jobs.empty())
+					wake_one();
+
+				job->execute(job->storage);
+				m_jobs.deallocate(job, 1);
+				continue;
+			}
+
+			if (m_stop.load(std::memory_order_acquire))
+				return;
+
+			park(self);
+		}
+	}
+
+	internal::pool_job* thread_pool::find_job(size_t index)
+	{
+		internal::pool_job* job = m_workers[index].jobs.pop();
+		if (job)
+			return job;
+
+		if (m_shared.get(job, std::chrono::microseconds::zero()) == mq_status::no_timeout)
+			return job;
+
+		// Steal from the next workers first, so that the thieves spread out
+		for (size_t i = 1; i < m_count; ++i)
+		{
+			job = m_workers[(index + i) % m_count].jobs.steal();
+			if (job)
+				return job;
+		}
+		return nullptr;
+	}
+
+	void thread_pool::park(worker& self)
+	{
+		self.parked.store(true, std::memory_order_release);
+		m_idle.fetch_add(1, std::memory_order_seq_cst);
+
+		// Paired with the fence of enqueue(): a job queued before the increment is seen here, a job queued after
+		// sees the increment and wakes up a worker
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (has_work() || m_stop.load(std::memory_order_seq_cst))
+		{
+			if (self.parked.exchange(false, std::memory_order_acq_rel))
+				m_idle.fetch_sub(1, std::memory_order_relaxed);
+			return;
+		}
+
+		// The worker is woken up once parked is cleared, by the thread that took it out of m_idle. A flag left by a
+		// wake-up that raced with the early return above doesn't count: the worker would stay counted as idle.
+		while (self.parked.load(std::memory_order_acquire))
+		{
+			uint32_t flags = osThreadFlagsWait(internal::thread_pool_flag, osFlagsWaitAny, osWaitForever);
+			if ((flags & osFlagsError) && self.parked.exchange(false, std::memory_order_acq_rel))
+			{
+				m_idle.fetch_sub(1, std::memory_order_relaxed);
+#ifdef __cpp_exceptions
+				throw std::system_error(flags, flags_category(), "thread_pool");
+#else
+				std::terminate();
+#endif
+			}
+		}
+	}
+
+	bool thread_pool::has_work() const
+	{
+		if (!m_shared.empty())
+			return true;
+
+		for (size_t i = 0; i < m_count; ++i)
+		{
+			if (!m_workers[i].jobs.empty())
+				return true;
+		}
+		return false;
+	}
+
+	void thread_pool::wake_one() noexcept
+	{
+		for (size_t i = 0; i < m_count; ++i)
+		{
+			worker& w = m_workers[i];
+			if (w.parked.load(std::memory_order_relaxed) && w.parked.exchange(false, std::memory_order_acq_rel))
+			{
+				m_idle.fetch_sub(1, std::memory_order_relaxed);
+				osThreadFlagsSet(w.id.load(std::memory_order_acquire), internal::thread_pool_flag);
+				return;
+			}
+		}
+	}
+} // namespace cmsis
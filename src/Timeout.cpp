@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Timeout.h"
+#include "OS.h"
+#include "OSException.h"
+#include "cmsis_os2.h"
+
+namespace cmsis
+{
+	namespace internal
+	{
+		namespace
+		{
+			constexpr uint64_t usec_per_sec = 1000000U;
+			constexpr uint64_t nsec_per_sec = 1000000000U;
+
+			/// Kernel ticks in usec, rounded up, or UINT64_MAX on overflow.
+			uint64_t ceil_ticks(uint64_t usec) noexcept
+			{
+				uint64_t freq = osKernelGetTickFreq();
+				if (usec > (UINT64_MAX - (usec_per_sec - 1)) / freq)
+					return UINT64_MAX;
+
+				return (usec * freq + (usec_per_sec - 1)) / usec_per_sec;
+			}
+		} // namespace
+
+		uint32_t to_ticks(std::chrono::microseconds rel_time) noexcept
+		{
+			if (rel_time <= std::chrono::microseconds::zero())
+				return 0;
+
+			uint64_t ticks = ceil_ticks(static_cast<uint64_t>(rel_time.count()));
+			if (ticks >= osWaitForever - CMSIS_TIMEOUT_EXTRA_TICKS)
+				return osWaitForever;
+
+			return static_cast<uint32_t>(ticks + CMSIS_TIMEOUT_EXTRA_TICKS);
+		}
+
+		uint32_t to_period_ticks(std::chrono::microseconds period) noexcept
+		{
+			if (period <= std::chrono::microseconds::zero())
+				return 1;
+
+			uint64_t ticks = ceil_ticks(static_cast<uint64_t>(period.count()));
+			return (ticks >= osWaitForever) ? osWaitForever - 1 : static_cast<uint32_t>(ticks);
+		}
+
+		uint64_t to_timer_counts(std::chrono::nanoseconds rel_time) noexcept
+		{
+			if (rel_time <= std::chrono::nanoseconds::zero())
+				return 0;
+
+			uint64_t freq = osKernelGetSysTimerFreq();
+			uint64_t ns = static_cast<uint64_t>(rel_time.count());
+			if (ns / nsec_per_sec > (UINT64_MAX - freq) / freq)
+				return UINT64_MAX;
+
+			return (ns / nsec_per_sec) * freq + ((ns % nsec_per_sec) * freq + nsec_per_sec - 1) / nsec_per_sec;
+		}
+
+		void precise_sleep_for(std::chrono::nanoseconds rel_time)
+		{
+			if (rel_time <= std::chrono::nanoseconds::zero())
+				return;
+
+			uint64_t freq = osKernelGetSysTimerFreq();
+			uint64_t per_tick = freq / osKernelGetTickFreq();
+			if (per_tick == 0)
+				per_tick = 1;
+
+			// A sleep is measured with the 32-bit system timer: it must end before the counter wraps around
+			uint64_t max_sleep = (UINT64_C(1) << 31) / per_tick;
+			if (max_sleep == 0)
+				max_sleep = 1;
+
+			uint64_t remaining = to_timer_counts(rel_time);
+			uint32_t last = osKernelGetSysTimerCount();
+			for (;;)
+			{
+				uint32_t now = osKernelGetSysTimerCount();
+				uint32_t elapsed = now - last;
+				last = now;
+				if (elapsed >= remaining)
+					return;
+				remaining -= elapsed;
+
+				// A sleep of n ticks ends after at most n ticks: sleeping one tick less than the remaining time keeps
+				// a tick for the wake-up latency, which is then spent spinning
+				uint64_t ticks = remaining / per_tick;
+				if (ticks < 2)
+				{
+					cpu_relax();
+					continue;
+				}
+
+				osStatus_t sta = osDelay(static_cast<uint32_t>(ticks - 1 < max_sleep ? ticks - 1 : max_sleep));
+				if (sta != osOK)
+				{
+#ifdef __cpp_exceptions
+					throw std::system_error(sta, os_category(), "osDelay");
+#else
+					std::terminate();
+#endif
+				}
+			}
+		}
+	} // namespace internal
+} // namespace cmsis
@@ -27,39 +27,37 @@
 
 #include "Timer.h"
 #include "OSException.h"
+#include "Timeout.h"
 #include "cmsis_os2.h"
 
 namespace cmsis
 {
-	class cmsis_timer
+	namespace internal
 	{
-	public:
-		typedef std::function<bool()> callback_t;
-
-		cmsis_timer(std::chrono::microseconds usec, callback_t&& function, bool bOnce) :
-			m_Callback(std::move(function)),
-			m_id(0),
-			m_usec(usec)
+		void missing_timer_callback()
 		{
-			if (!m_Callback)
-			{
 #ifdef __cpp_exceptions
-				throw std::system_error(osErrorParameter, os_category(), "timer: missing callback");
+			throw std::system_error(osErrorParameter, os_category(), "timer: missing callback");
 #else
-				std::terminate();
+			std::terminate();
 #endif
-			}
+		}
 
+		base_timer::base_timer(std::chrono::microseconds usec, void (*func)(void*), void* arg, bool periodic) :
+			m_id(0),
+			m_usec(usec),
+			m_periodic(periodic)
+		{
 			if (m_usec < std::chrono::microseconds::zero())
 			{
 #ifdef __cpp_exceptions
-				throw std::system_error(osErrorParameter, os_category(), "base_timed_mutex: negative timer");
+				throw std::system_error(osErrorParameter, os_category(), "timer: negative timer");
 #else
 				std::terminate();
 #endif
 			}
 
-			m_id = osTimerNew(handler, bOnce ? osTimerOnce : osTimerPeriodic, this, NULL);
+			m_id = osTimerNew(func, periodic ? osTimerPeriodic : osTimerOnce, arg, NULL);
 			if (m_id == 0)
 			{
 #ifdef __cpp_exceptions
@@ -70,7 +68,7 @@ namespace cmsis
 			}
 		}
 
-		~cmsis_timer() noexcept(false)
+		base_timer::~base_timer() noexcept(false)
 		{
 			osStatus_t sta = osTimerDelete(m_id);
 			if (sta != osOK)
@@ -83,15 +81,9 @@ namespace cmsis
 			}
 		}
 
-		void start()
+		void base_timer::start()
 		{
-			uint32_t ticks = static_cast<uint32_t>(
-				(m_usec.count() * osKernelGetTickFreq() * std::chrono::microseconds::period::num) /
-				std::chrono::microseconds::period::den);
-			if (ticks > std::numeric_limits<uint32_t>::max())
-				ticks = osWaitForever;
-
-			osStatus_t sta = osTimerStart(m_id, ticks);
+			osStatus_t sta = osTimerStart(m_id, internal::to_period_ticks(m_usec));
 			if (sta != osOK)
 			{
 #ifdef __cpp_exceptions
@@ -102,7 +94,7 @@ namespace cmsis
 			}
 		}
 
-		void stop()
+		void base_timer::stop()
 		{
 			osStatus_t sta = osTimerStop(m_id);
 			if (sta != osOK)
@@ -115,7 +107,31 @@ namespace cmsis
 			}
 		}
 
-		bool running() const { return osTimerIsRunning(m_id) != 0; }
+		bool base_timer::running() const
+		{
+			return osTimerIsRunning(m_id) != 0;
+		}
+
+		void base_timer::expire() noexcept
+		{
+			// The timer may have been stopped while the callback was running
+			osTimerStop(m_id);
+		}
+	} // namespace internal
+
+	class cmsis_timer
+	{
+	public:
+		typedef std::function<bool()> callback_t;
+
+		cmsis_timer(std::chrono::microseconds usec, callback_t&& function, bool periodic) :
+			m_Callback(std::move(function)),
+			m_timer(usec, handler, this, periodic)
+		{}
+
+		void start() { m_timer.start(); }
+		void stop() { m_timer.stop(); }
+		bool running() const { return m_timer.running(); }
 
 		cmsis_timer(const cmsis_timer&) = delete;
 		cmsis_timer& operator=(const cmsis_timer&) = delete;
@@ -123,19 +139,15 @@ namespace cmsis
 	private:
 		static void handler(void* argument)
 		{
+			// An expired once timer isn't running anymore in its callback: only a periodic timer is stopped
 			cmsis_timer* pTimer = static_cast<cmsis_timer*>(argument);
-
-			if (!pTimer->running())
-				return;
-
-			if (!pTimer->m_Callback())
-				pTimer->stop();
+			if (!pTimer->m_Callback() && pTimer->m_timer.periodic())
+				pTimer->m_timer.expire();
 		}
 
 	private:
 		callback_t m_Callback;
-		osTimerId_t m_id;
-		std::chrono::microseconds m_usec;
+		internal::base_timer m_timer; // deleted before the callback is destroyed
 	};
 
 	timer::timer() :
@@ -143,8 +155,13 @@ namespace cmsis
 	{}
 
 	timer::timer(std::chrono::microseconds usec, callback_t&& function, timer_type_t type) :
-		m_pImplTimer(std::make_unique<cmsis_timer>(usec, std::move(function), type == timer_type_t::once))
-	{}
+		m_pImplTimer()
+	{
+		if (!function)
+			internal::missing_timer_callback();
+
+		m_pImplTimer = std::make_unique<cmsis_timer>(usec, std::move(function), type == timer_type_t::periodic);
+	}
 
 	timer::timer(timer&& t) :
 		m_pImplTimer(std::move(t.m_pImplTimer))
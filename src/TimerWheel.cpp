@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2023, B. Leforestier
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the author nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "TimerWheel.h"
+#include "OS.h"
+#include "OSException.h"
+#include "ThreadFlag.h"
+#include "cmsis_os2.h"
+
+namespace cmsis
+{
+	namespace
+	{
+		uint32_t resolution_counts(std::chrono::nanoseconds resolution)
+		{
+			uint64_t counts = internal::to_timer_counts(resolution);
+			if (counts == 0 || counts > INT32_MAX)
+			{
+#ifdef __cpp_exceptions
+				throw std::system_error(osErrorParameter, os_category(), "timer_wheel: invalid resolution");
+#else
+				std::terminate();
+#endif
+			}
+
+			return static_cast<uint32_t>(counts);
+		}
+
+		uint32_t tick_counts() noexcept
+		{
+			uint32_t counts = osKernelGetSysTimerFreq() / osKernelGetTickFreq();
+			return counts ? counts : 1;
+		}
+
+		thread::attributes service_attributes(thread::attributes attr) noexcept
+		{
+			if (attr.name == nullptr)
+				attr.name = "timer_wheel";
+			return attr;
+		}
+	} // namespace
+
+	wheel_timer::wheel_timer(timer_wheel& wheel, callback_t function, void* arg) :
+		m_next(nullptr),
+		m_pprev(nullptr),
+		m_expiry(0),
+		m_wheel(wheel),
+		m_function(function),
+		m_arg(arg)
+	{
+		if (m_function == nullptr)
+		{
+#ifdef __cpp_exceptions
+			throw std::system_error(osErrorParameter, os_category(), "wheel_timer: missing callback");
+#else
+			std::terminate();
+#endif
+		}
+	}
+
+	wheel_timer::~wheel_timer()
+	{
+		m_wheel.stop(this, true);
+	}
+
+	void wheel_timer::start_nsec(std::chrono::nanoseconds delay)
+	{
+		if (delay < std::chrono::nanoseconds::zero())
+		{
+#ifdef __cpp_exceptions
+			throw std::system_error(osErrorParameter, os_category(), "wheel_timer: negative timer");
+#else
+			std::terminate();
+#endif
+		}
+
+		m_wheel.start(this, delay);
+	}
+
+	void wheel_timer::stop()
+	{
+		m_wheel.stop(this, false);
+	}
+
+	bool wheel_timer::running() const
+	{
+		std::lock_guard<mutex> lock(m_wheel.m_mutex);
+		return m_pprev != nullptr;
+	}
+
+	timer_wheel::timer_wheel(std::chrono::nanoseconds resolution, const thread::attributes& attr) :
+		m_mutex("timer_wheel"),
+		m_slots(),
+		m_expired(nullptr),
+		m_current(nullptr),
+		m_next(0),
+		m_wake(0),
+		m_counts(0),
+		m_last(osKernelGetSysTimerCount()),
+		m_resolution(resolution_counts(resolution)),
+		m_tick(tick_counts()),
+		m_pending(0),
+		m_quit(false),
+		m_thread(service_attributes(attr), &timer_wheel::run, this)
+	{}
+
+	timer_wheel::~timer_wheel()
+	{
+		{
+			std::lock_guard<mutex> lock(m_mutex);
+			m_quit = true;
+		}
+
+		osThreadFlagsSet(m_thread.native_handle(), internal::timer_wheel_flag);
+		m_thread.join();
+	}
+
+	size_t timer_wheel::pending() const
+	{
+		std::lock_guard<mutex> lock(m_mutex);
+		return m_pending;
+	}
+
+	void timer_wheel::start(wheel_timer* t, std::chrono::nanoseconds delay)
+	{
+		uint64_t counts = internal::to_timer_counts(delay);
+
+		std::lock_guard<mutex> lock(m_mutex);
+		uint64_t now = now_counts();
+		if (counts > UINT64_MAX - now - m_resolution)
+			counts = UINT64_MAX - now - m_resolution;
+
+		if (t->m_pprev)
+			unlink(t);
+		else if (m_pending++ == 0 && m_next < now / m_resolution)
+			m_next = now / m_resolution; // the wheel is empty: catch up with the time
+
+		// The timer expires at the first unit that starts after the delay
+		t->m_expiry = (now + counts + m_resolution - 1) / m_resolution;
+		insert(t);
+
+		if (t->m_expiry < m_wake)
+		{
+			m_wake = 0;
+			osThreadFlagsSet(m_thread.native_handle(), internal::timer_wheel_flag);
+		}
+	}
+
+	void timer_wheel::stop(wheel_timer* t, bool wait)
+	{
+		std::unique_lock<mutex> lock(m_mutex);
+		if (t->m_pprev)
+		{
+			unlink(t);
+			--m_pending;
+		}
+
+		if (!wait || m_current != t || osThreadGetId() == m_thread.native_handle())
+			return;
+
+		// The callback is running in the service thread
+		while (m_current == t)
+		{
+			lock.unlock();
+			osDelay(1);
+			lock.lock();
+		}
+	}
+
+	void timer_wheel::run()
+	{
+		std::unique_lock<mutex> lock(m_mutex);
+		while (!m_quit)
+		{
+			uint64_t now = now_counts();
+			advance(now / m_resolution);
+
+			// The expired timers are called out of the lock: they can be restarted or stopped meanwhile
+			if (m_expired)
+			{
+				wheel_timer* t = m_expired;
+				unlink(t);
+				--m_pending;
+
+				m_current = t;
+				lock.unlock();
+				t->m_function(t->m_arg);
+				lock.lock();
+				m_current = nullptr;
+				continue;
+			}
+
+			uint64_t next = next_event();
+			m_wake = next;
+			lock.unlock();
+			sleep(next == UINT64_MAX ? UINT64_MAX : next * m_resolution - now);
+			lock.lock();
+			m_wake = 0;
+		}
+	}
+
+	void timer_wheel::sleep(uint64_t counts)
+	{
+		uint64_t ticks = counts / m_tick;
+		if (ticks == 0)
+		{
+			if (m_resolution >= m_tick)
+				ticks = 1;
+			else
+			{
+				// The end of a wait shorter than a tick
+				uint32_t start = osKernelGetSysTimerCount();
+				while (osKernelGetSysTimerCount() - start < counts)
+					internal::cpu_relax();
+				return;
+			}
+		}
+
+		// Wake up at least twice per turn of the system timer, to keep its 64-bit extension
+		const uint64_t max_ticks = (UINT64_C(1) << 31) / m_tick;
+		osThreadFlagsWait(
+			internal::timer_wheel_flag,
+			osFlagsWaitAny,
+			static_cast<uint32_t>(ticks < max_ticks ? ticks : max_ticks));
+	}
+
+	uint64_t timer_wheel::now_counts() noexcept
+	{
+		uint32_t count = osKernelGetSysTimerCount();
+		m_counts += static_cast<uint32_t>(count - m_last);
+		m_last = count;
+		return m_counts;
+	}
+
+	void timer_wheel::insert(wheel_timer* t) noexcept
+	{
+		// An overdue timer goes in the next slot
+		uint64_t expiry = (t->m_expiry < m_next) ? m_next : t->m_expiry;
+		uint64_t delta = expiry - m_next;
+
+		unsigned level = 0;
+		while (level + 1 < level_count && delta >> (slot_bits * (level + 1)))
+			++level;
+
+		// Beyond the span of the wheel, the timer is inserted again when the last level cascades
+		if (delta >> (slot_bits * level_count))
+			expiry = m_next + (UINT64_C(1) << (slot_bits * level_count)) - 1;
+
+		link(&m_slots[level][(expiry >> (slot_bits * level)) & slot_mask], t);
+	}
+
+	void timer_wheel::cascade(unsigned level, uint64_t index) noexcept
+	{
+		wheel_timer* t = m_slots[level][index];
+		m_slots[level][index] = nullptr;
+		while (t)
+		{
+			wheel_timer* next = t->m_next;
+			insert(t);
+			t = next;
+		}
+	}
+
+	void timer_wheel::advance(uint64_t now) noexcept
+	{
+		while (m_next <= now)
+		{
+			// Skip the units without expiry nor cascade
+			uint64_t next = next_event();
+			if (next > now)
+			{
+				m_next = now + 1;
+				return;
+			}
+			m_next = next;
+
+			// At the start of a turn of a level, the next slot of the upper level is spread in the lower ones
+			for (unsigned level = 1; level < level_count; ++level)
+			{
+				if ((m_next >> (slot_bits * (level - 1))) & slot_mask)
+					break;
+				cascade(level, (m_next >> (slot_bits * level)) & slot_mask);
+			}
+
+			wheel_timer*& slot = m_slots[0][m_next & slot_mask];
+			while (slot)
+			{
+				wheel_timer* t = slot;
+				unlink(t);
+				link(&m_expired, t);
+			}
+			++m_next;
+		}
+	}
+
+	uint64_t timer_wheel::next_event() const noexcept
+	{
+		// First slot of each level: the expiry for the first level, the cascade of the slot for the upper ones
+		uint64_t next = UINT64_MAX;
+		for (unsigned level = 0; level < level_count; ++level)
+		{
+			unsigned shift = slot_bits * level;
+			uint64_t first = (m_next + (UINT64_C(1) << shift) - 1) >> shift;
+			for (uint64_t pos = first; pos < first + slot_count; ++pos)
+			{
+				if (m_slots[level][pos & slot_mask])
+				{
+					if ((pos << shift) < next)
+						next = pos << shift;
+					break;
+				}
+			}
+		}
+
+		return next;
+	}
+
+	void timer_wheel::link(wheel_timer** head, wheel_timer* t) noexcept
+	{
+		t->m_next = *head;
+		if (*head)
+			(*head)->m_pprev = &t->m_next;
+		*head = t;
+		t->m_pprev = head;
+	}
+
+	void timer_wheel::unlink(wheel_timer* t) noexcept
+	{
+		*t->m_pprev = t->m_next;
+		if (t->m_next)
+			t->m_next->m_pprev = t->m_pprev;
+		t->m_next = nullptr;
+		t->m_pprev = nullptr;
+	}
+} // namespace cmsis